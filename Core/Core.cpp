@@ -8,6 +8,9 @@
 
 #if !_WIN32
 #include <time.h>					// for Linux version of GetTickCount()
+#include <fcntl.h>					// for open()
+#include <unistd.h>					// for close()
+#include <sys/mman.h>				// for mmap()
 #endif
 
 #if VSTUDIO_INTEGRATION
@@ -217,6 +220,24 @@ bool CErrorContext::ShouldLogThisThread()
 	return ErrorThreadId == ThreadId;
 }
 
+bool CErrorContext::DetachThreadError(CErrorContext& Dst)
+{
+	if (ErrorThreadId != CThread::CurrentId()) return false;
+	ErrorHandlerType Handler = ErrorHandler;
+	Dst = *this;
+	Reset();
+	ErrorHandler = Handler;
+	return true;
+}
+
+void CErrorContext::AttachThreadError(const CErrorContext& Src)
+{
+	ErrorHandlerType Handler = ErrorHandler;
+	*this = Src;
+	ErrorHandler = Handler;
+	ErrorThreadId = CThread::CurrentId();
+}
+
 #endif // THREADING
 
 void CErrorContext::LogHistory(const char *part)
@@ -278,8 +299,9 @@ const char *va(const char *format, ...)
 {
 //	guardSlow(va);
 
-	static char buf[VA_BUFSIZE];
-	static int bufPos = 0;
+	// Separate buffer for each thread
+	static thread_local char buf[VA_BUFSIZE];
+	static thread_local int bufPos = 0;
 	// wrap buffer
 	if (bufPos >= VA_BUFSIZE - VA_GOODSIZE) bufPos = 0;
 
@@ -739,6 +761,43 @@ unsigned appGetFileType(const char *filename)
 
 #if !_WIN32
 
+// Windows version is in CoreWin32.cpp
+const byte* appMapFile(const char *filename, int64& outSize)
+{
+	guard(appMapFile);
+
+	outSize = 0;
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	const byte* data = NULL;
+	struct stat buf;
+	if (fstat(fd, &buf) == 0 && S_ISREG(buf.st_mode) && buf.st_size > 0 && (uint64)buf.st_size <= (size_t)-1)
+	{
+		void* ptr = mmap(NULL, buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (ptr != MAP_FAILED)
+		{
+			data = (const byte*)ptr;
+			outSize = buf.st_size;
+		}
+	}
+	// The mapping remains valid after closing the file descriptor
+	close(fd);
+	return data;
+
+	unguardf("%s", filename);
+}
+
+void appUnmapFile(const byte* data, int64 size)
+{
+	if (data) munmap(const_cast<byte*>(data), size);
+}
+
+#endif // !_WIN32
+
+#if !_WIN32
+
 // POSIX version of GetTickCount()
 unsigned long GetTickCount()
 {
@@ -336,6 +336,11 @@ void appParseResponseFile(const char* filename, int& outArgc, const char**& outA
 // and FS_DIR if this is a directory
 unsigned appGetFileType(const char *filename);
 
+// Map the whole file into memory for reading. Returns NULL if the file can't be opened or mapped (for example,
+// when it has zero size). Mapped data should be released with appUnmapFile().
+const byte* appMapFile(const char *filename, int64& outSize);
+void appUnmapFile(const byte* data, int64 size);
+
 
 // Memory management
 
@@ -535,6 +540,11 @@ public:
 #if THREADING
 	int ErrorThreadId;
 	bool ShouldLogThisThread();
+	// Move error information recorded by the current thread to 'Dst' and reset the context, so errors of
+	// other threads could be recorded. Returns false if the error was recorded by another thread.
+	bool DetachThreadError(CErrorContext& Dst);
+	// Make error saved with DetachThreadError() the error of the current thread
+	void AttachThreadError(const CErrorContext& Src);
 #endif
 
 	// Call stack
@@ -2,10 +2,11 @@
 
 #ifdef _WIN32
 
-#if WIN32_USE_SEH
 #define WIN32_LEAN_AND_MEAN			// exclude rarely-used services from windown headers
 #define _WIN32_WINDOWS 0x0500		// for IsDebuggerPresent()
 #include <windows.h>
+
+#if WIN32_USE_SEH
 #include <float.h>					// for _clearfp()
 #endif // WIN32_USE_SEH
 
@@ -527,6 +528,40 @@ void appCopyTextToClipboard(const char* text)
 }
 
 
+const byte* appMapFile(const char *filename, int64& outSize)
+{
+	guard(appMapFile);
+
+	outSize = 0;
+	HANDLE hFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	const byte* data = NULL;
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(hFile, &size) && size.QuadPart > 0 && (uint64)size.QuadPart <= (size_t)-1)
+	{
+		HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (hMapping)
+		{
+			data = (const byte*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+			if (data) outSize = size.QuadPart;
+			// The view holds a reference to the mapping object, so the handle is not needed anymore
+			CloseHandle(hMapping);
+		}
+	}
+	CloseHandle(hFile);
+	return data;
+
+	unguardf("%s", filename);
+}
+
+void appUnmapFile(const byte* data, int64 size)
+{
+	if (data) UnmapViewOfFile(data);
+}
+
+
 #if defined(OLDCRT) && (_MSC_VER  >= 1900)
 
 // Support OLDCRT with VC2015 or newer. VC2015 switched to another CRT model called "Universal CRT".
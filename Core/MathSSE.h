@@ -83,9 +83,20 @@ struct CVec4
 #endif
 	}
 
+	// Normalize XYZ part, W is not changed. Computes exactly the same value as CVec3::Normalize().
 	FORCEINLINE void Normalize()
 	{
+#if 1
+		__m128 sq  = _mm_mul_ps(mm, mm);
+		__m128 len = _mm_add_ss(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(1,1,1,1)));
+		len        = _mm_add_ss(len, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2,2,2,2)));
+		len        = _mm_sqrt_ss(len);
+		if (_mm_cvtss_f32(len) == 0) return;
+		float inv  = 1.0f / _mm_cvtss_f32(len);
+		mm = _mm_mul_ps(mm, _mm_set_ps(1.0f, inv, inv, inv));
+#else
 		ToVec3().Normalize();
+#endif
 	}
 };
 
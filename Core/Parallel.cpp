@@ -81,7 +81,7 @@ CSemaphore::CSemaphore()
 : tracy(&DummyStrLoc)
 #endif
 {
-	data = CreateSemaphore(NULL, 0, 32768, NULL);
+	data = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
 }
 
 CSemaphore::~CSemaphore()
@@ -303,264 +303,332 @@ void CThread::Start()
 namespace ThreadPool
 {
 
-#define MAX_POOL_THREADS 64
+#define MAX_POOL_THREADS		64
+// Maximal number of queued tasks per pool thread. When exceeded, producer waits for free space in queue,
+// this limits amount of memory held by queued tasks (for example, texture export tasks holds decompressed data).
+#define MAX_QUEUED_PER_THREAD	8
 
-// Task queue
-namespace Queue
-{
-
-struct CTask
+struct CPoolTask
 {
 	ThreadTask	task;
 	void*		data;
 	CSemaphore* fence;
+	CTaskGroup*	group;
 
 	void Exec()
 	{
-		guard(QueueTask::Exec);
+		guard(PoolTask::Exec);
 		task(data);
 		if (fence) fence->Signal();
+		if (group) group->TaskCompleted();
 		unguard;
 	}
 };
 
-
-CMutex Mutex;
-static CTask Queue[MAX_POOL_THREADS / 2];
-static int QueueSize = 0;
-
-// This function returns false if queue size wasn't enough for returning immediately
-bool PutToQueue(ThreadTask task, void* data, CSemaphore* fence)
+// Double-ended task queue. Owner thread puts and gets tasks at the back (the most recent task has the best
+// chance to have its data in cache), other threads are stealing from the front (the oldest tasks).
+class CTaskDeque
 {
-	guard(Queue::PutToQueue);
-
-	// Get size of queue
-	static int MaxQueueSize = -1;
-	if (MaxQueueSize < 0)
+public:
+	CTaskDeque()
+	: Tasks(NULL)
+	, Capacity(0)
+	, Head(0)
+	, Count(0)
+	{}
+
+	void Push(const CPoolTask& Task)
 	{
-		MaxQueueSize = CThread::GetLogicalCPUCount() * 2;
-		if (MaxQueueSize > ARRAY_COUNT(Queue))
-			MaxQueueSize = ARRAY_COUNT(Queue);
+		CMutex::ScopedLock Lock(Mutex);
+		if (Count == Capacity) Grow();
+		Tasks[(Head + Count) & (Capacity - 1)] = Task;
+		Count++;
 	}
 
-	CTask ToExec;
-
-	{ // Lock scope
+	bool PopBack(CPoolTask& Task)
+	{
+		if (!Count) return false; // quick check without locking
 		CMutex::ScopedLock Lock(Mutex);
-
-		if (QueueSize < MaxQueueSize)
-		{
-			// Just put task to queue and return
-			CTask& Item = Queue[QueueSize++];
-			Item.task = task;
-			Item.data = data;
-			Item.fence = fence;
-			return true;
-		}
-
-		// There's not enough space in queue, execute the first item and put new one to the queue's back
-
-		// Grab the first item from queue
-		ToExec = Queue[0];
-		memmove(&Queue[0], &Queue[1], sizeof(CTask) * (QueueSize - 1));
-
-		// Put new item
-		CTask& Item = Queue[QueueSize - 1];
-		Item.task = task;
-		Item.data = data;
-		Item.fence = fence;
+		if (!Count) return false;
+		Count--;
+		Task = Tasks[(Head + Count) & (Capacity - 1)];
+		return true;
 	}
 
-	// Execute the first item in current thread
-	ToExec.Exec();
-
-	// Indicate that we didn't put task to pool, but executed something
-	return false;
-
-	unguard;
-}
-
-bool GetFromQueue(CTask& item)
-{
-	CMutex::ScopedLock Lock(Mutex);
-
-	if (!QueueSize)
-		return false;
-
-	item = Queue[0];
-	if (--QueueSize)
+	bool PopFront(CPoolTask& Task)
 	{
-		memmove(&Queue[0], &Queue[1], sizeof(CTask) * QueueSize);
+		if (!Count) return false;
+		CMutex::ScopedLock Lock(Mutex);
+		if (!Count) return false;
+		Task = Tasks[Head];
+		Head = (Head + 1) & (Capacity - 1);
+		Count--;
+		return true;
 	}
 
-	return true;
-}
-
-} // namespace Queue
+protected:
+	void Grow()
+	{
+		int NewCapacity = Capacity ? Capacity * 2 : 64;
+		CPoolTask* NewTasks = (CPoolTask*)appMallocNoInit(sizeof(CPoolTask) * NewCapacity);
+		for (int i = 0; i < Count; i++)
+			NewTasks[i] = Tasks[(Head + i) & (Capacity - 1)];
+		if (Tasks) appFree(Tasks);
+		Tasks = NewTasks;
+		Capacity = NewCapacity;
+		Head = 0;
+	}
 
+	CMutex		Mutex;
+	CPoolTask*	Tasks;
+	int			Capacity;		// power of 2
+	int			Head;
+	volatile int Count;
+};
 
 // Thread for the pool
 class CPoolThread : public CThread
 {
 public:
-	// Flag showing if this thead is doing something or not
-	bool bBusy = false;
-	bool bShutdown = false;
+	CPoolThread(int InIndex)
+	: Index(InIndex)
+	, NumTasks(0)
+	, NumSteals(0)
+	, IdleTime(0)
+	{}
+
+	int			Index;
+	// Tasks queued by this thread
+	CTaskDeque	Deque;
+
+	// Statistics
+	int			NumTasks;
+	int			NumSteals;
+	int64		IdleTime;
+
+protected:
+	virtual void Run();
+};
 
-	void AssignTaskAndWake(ThreadTask inTask, void* inData, CSemaphore* inFence)
+static CPoolThread* Pool[MAX_POOL_THREADS];
+static int NumPoolThreads = -1;		// -1 = not initialized yet
+static CMutex PoolMutex;
+
+// Tasks queued by threads which are not in pool
+static CTaskDeque GlobalQueue;
+static int NumExternalTasks = 0;
+
+// Number of tasks in all queues
+static volatile int32 NumQueuedTasks = 0;
+// Number of queued and executing tasks
+static volatile int32 NumActiveTasks = 0;
+// Number of pool threads which are executing tasks
+static volatile int32 NumBusyThreads = 0;
+// Number of threads which has nothing to do, and waiting for WakeSignal
+static volatile int32 NumSleepingThreads = 0;
+static CSemaphore WakeSignal;
+// Number of non-pool threads which are waiting for QueueSpaceSignal to queue a task
+static volatile int32 NumWaitingProducers = 0;
+static CSemaphore QueueSpaceSignal;
+static volatile bool bShutdown = false;
+
+// Pool thread which is executing the current code, or NULL
+static thread_local CPoolThread* GCurrentThread = NULL;
+
+static void InitPool()
+{
+	if (NumPoolThreads >= 0) return;
+
+	CMutex::ScopedLock Lock(PoolMutex);
+	if (NumPoolThreads >= 0) return;
+
+	int MaxThreads = CThread::GetLogicalCPUCount();
+	MaxThreads = min(MaxThreads, MAX_POOL_THREADS);
+	--MaxThreads; // exclude main thread
+	if (!GEnableThreads) MaxThreads = 0;
+
+	for (int i = 0; i < MaxThreads; i++)
 	{
-		task = inTask;
-		taskData = inData;
-		fence = inFence;
-		sem.Signal();
+		CPoolThread* NewThread = new CPoolThread(i);
+		Pool[i] = NewThread;
 	}
-
-	void Shutdown()
+	// Publish the pool only when all threads are created, so other code could iterate over Pool[] without locking
+	NumPoolThreads = MaxThreads;
+	for (int i = 0; i < MaxThreads; i++)
 	{
-		bShutdown = true;
-		sem.Signal();
+		Pool[i]->Start();
 	}
 
-protected:
-	virtual void Run()
-	{
-		bBusy = false;
+	// Put Shutdown function to 'atexit' sequence
+	atexit(ThreadPool::Shutdown);
+}
 
-		while (true)
+void QueueTask(const CPoolTask& Task)
+{
+	InterlockedIncrement(&NumActiveTasks);
+	if (GCurrentThread)
+		GCurrentThread->Deque.Push(Task);
+	else
+		GlobalQueue.Push(Task);
+	InterlockedIncrement(&NumQueuedTasks);
+	// Wake up one thread. Sleeping thread increments NumSleepingThreads before checking NumQueuedTasks, so
+	// either it will see the new task, or we'll see it sleeping.
+	if (NumSleepingThreads > 0)
+		WakeSignal.Signal();
+}
+
+// Get a task for execution: the newest one from own queue, then the oldest one from other queues
+static bool GrabTask(CPoolTask& Task)
+{
+	if (NumQueuedTasks <= 0) return false;
+
+	CPoolThread* Self = GCurrentThread;
+	bool bFound = (Self && Self->Deque.PopBack(Task)) || GlobalQueue.PopFront(Task);
+	if (!bFound)
+	{
+		// Steal a task, start from the neighbour thread to distribute steals over the pool
+		int Start = Self ? Self->Index + 1 : 0;
+		for (int i = 0; i < NumPoolThreads && !bFound; i++)
 		{
-			// Wait for signal to start
-			sem.Wait();
-			if (bShutdown) break;
-
-			// Execute task
-			bBusy = true;
-			task(taskData);
-			if (fence) fence->Signal();
-
-			// See if there's something in the queue to execute
-			Queue::CTask task;
-			while (Queue::GetFromQueue(task))
+			CPoolThread* Victim = Pool[(Start + i) % NumPoolThreads];
+			if (Victim != Self && Victim->Deque.PopFront(Task))
 			{
-				task.Exec();
+				bFound = true;
+				if (Self) Self->NumSteals++;
 			}
-
-			// Return thread to pool
-			bBusy = false;
-			InterlockedDecrement(&NumWorkingThreads);
 		}
-		//todo: May be CThread should destroy itself when worker function completed? Just not using CThread anywhere else.
-		delete this;
 	}
+	if (bFound)
+	{
+		InterlockedDecrement(&NumQueuedTasks);
+		// Producer increments NumWaitingProducers before checking NumQueuedTasks, so either it will see
+		// the free space, or we'll see it waiting. Extra signals are harmless, the producer checks the queue again.
+		if (NumWaitingProducers > 0)
+			QueueSpaceSignal.Signal();
+	}
+	return bFound;
+}
 
-	// Executed code
-	ThreadTask task;
-	// Pointer to task context
-	void* taskData;
-	// Object used to signal execution end
-	CSemaphore* fence;
-	// Semaphore used to wake up the thread
-	CSemaphore sem;
-
-public:
-	// Statics
-	// Number of awake threads
-	static volatile int NumWorkingThreads;
-};
-
-volatile int CPoolThread::NumWorkingThreads = 0;
+// Block a non-pool thread until the queue has space for a new task
+static void WaitForQueueSpace()
+{
+	int MaxQueuedTasks = NumPoolThreads * MAX_QUEUED_PER_THREAD;
+	while (NumQueuedTasks >= MaxQueuedTasks)
+	{
+		InterlockedIncrement(&NumWaitingProducers);
+		if (NumQueuedTasks >= MaxQueuedTasks)
+			QueueSpaceSignal.Wait();
+		InterlockedDecrement(&NumWaitingProducers);
+	}
+}
 
-// Thread pool itself
-namespace Pool
+static void ExecuteTask(CPoolTask& Task)
 {
+	Task.Exec();
+	if (GCurrentThread)
+		GCurrentThread->NumTasks++;
+	else
+		InterlockedIncrement(&NumExternalTasks);
+	InterlockedDecrement(&NumActiveTasks);
+}
 
-static CPoolThread* Pool[MAX_POOL_THREADS];
-static int NumPoolThreads = 0;
-static CMutex Mutex;
+// Execute one queued task in the current thread
+static bool HelpWithTask()
+{
+	CPoolTask Task;
+	if (!GrabTask(Task)) return false;
+	ExecuteTask(Task);
+	return true;
+}
 
-CPoolThread* AllocateFreeThread()
+void CPoolThread::Run()
 {
-	CMutex::ScopedLock lock(Mutex);
+	GCurrentThread = this;
 
-	// Find idle thread
-	for (int i = 0; i < NumPoolThreads; i++)
+	while (true)
 	{
-		CPoolThread* Thread = Pool[i];
-		if (!Thread->bBusy)
+		CPoolTask Task;
+		if (GrabTask(Task))
 		{
-			Thread->bBusy = true;
-			InterlockedIncrement(&CPoolThread::NumWorkingThreads);
-			return Thread;
+			InterlockedIncrement(&NumBusyThreads);
+			ExecuteTask(Task);
+			InterlockedDecrement(&NumBusyThreads);
+			continue;
 		}
-	}
-
-	static int MaxThreads = -1;
-	if (MaxThreads < 0)
-	{
-		MaxThreads = CThread::GetLogicalCPUCount();
-		MaxThreads = min(MaxThreads, MAX_POOL_THREADS);
-		--MaxThreads; // exclude main thread
-		if (!GEnableThreads) MaxThreads = 0;
-
-		// Put Shutdown function to 'atexit' sequence
-		atexit(ThreadPool::Shutdown);
-	}
-
-	// Create new thread, if can
-	if (NumPoolThreads < MaxThreads)
-	{
-		CPoolThread* NewThread = new CPoolThread();
 
-		NewThread->bBusy = true;
-		Pool[NumPoolThreads++] = NewThread;
-		InterlockedIncrement(&CPoolThread::NumWorkingThreads);
+		// Nothing to do, go to sleep
+		InterlockedIncrement(&NumSleepingThreads);
+		if (NumQueuedTasks <= 0 && !bShutdown)
+		{
+			int64 IdleStart = appMilliseconds();
+			WakeSignal.Wait();
+			IdleTime += appMilliseconds() - IdleStart;
+		}
+		InterlockedDecrement(&NumSleepingThreads);
 
-		NewThread->Start();
-		return NewThread;
+		if (bShutdown) break;
 	}
-
-	// No free threads, and can't allocate a new one
-	return NULL;
+	//todo: May be CThread should destroy itself when worker function completed? Just not using CThread anywhere else.
+	delete this;
 }
 
-} // namespace Pool
-
 bool ExecuteInThread(ThreadTask task, void* taskData, CSemaphore* fence, bool allowQueue)
 {
-	CPoolThread* thread = Pool::AllocateFreeThread();
-	if (thread)
+	InitPool();
+
+	if (!NumPoolThreads)
 	{
-		thread->AssignTaskAndWake(task, taskData, fence);
+		if (!allowQueue) return false;
+		// Threads are disabled, execute immediately
+		task(taskData);
+		if (fence) fence->Signal();
 		return true;
 	}
-	else if (allowQueue)
+
+	if (!allowQueue)
 	{
-		Queue::PutToQueue(task, taskData, fence);
-		//todo: it is possible that after AllocateFreeThread() call buf before PutToQueue completion, one
-		//todo: of the worker threads will be returned to pool
-		return true;
+		// Accept the task only when there's a thread which will pick it up immediately
+		if (NumPoolThreads - NumBusyThreads - NumQueuedTasks <= 0)
+			return false;
 	}
-	else
+	else if (!GCurrentThread)
 	{
-		return false;
+		// Too many tasks in queue: wait until pool threads pick up some of them. The producer doesn't execute
+		// queued tasks itself, so it could continue preparing work as soon as there's space in queue.
+		WaitForQueueSpace();
 	}
+	else if (NumQueuedTasks >= NumPoolThreads * MAX_QUEUED_PER_THREAD)
+	{
+		// Pool thread is producing tasks: execute the oldest one, blocking a pool thread could deadlock the pool
+		HelpWithTask();
+	}
+
+	CPoolTask Task;
+	Task.task = task;
+	Task.data = taskData;
+	Task.fence = fence;
+	Task.group = NULL;
+	QueueTask(Task);
+	return true;
+}
+
+int GetNumThreads()
+{
+	InitPool();
+	return NumPoolThreads;
 }
 
 void WaitForCompletion()
 {
 	guard(ThreadPool::WaitForCompletion);
 
-	// Execute tasks from the queue if any
-	Queue::CTask task;
-	while (Queue::GetFromQueue(task))
+	// Execute queued tasks in current thread, then wait for threads which are still working
+	while (NumActiveTasks > 0)
 	{
-		task.Exec();
+		if (!HelpWithTask())
+			CThread::Sleep(1);
 	}
 
-	// Wait for all threads to go to the idle state
-	while (CPoolThread::NumWorkingThreads > 0)
-	{
-		CThread::Sleep(20);
-	}
 	unguard;
 }
 
@@ -574,14 +642,16 @@ void Shutdown()
 		return;
 	}
 
+	if (NumPoolThreads <= 0) return;
+
 	WaitForCompletion();
-	int NumThreadsAfterShutdown = CThread::NumThreads - Pool::NumPoolThreads;
+	int NumThreadsAfterShutdown = CThread::NumThreads - NumPoolThreads;
 
 	// Signal to all threads to shutdown
-	for (int i = 0; i < Pool::NumPoolThreads; i++)
+	bShutdown = true;
+	for (int i = 0; i < NumPoolThreads; i++)
 	{
-		CPoolThread* Thread = Pool::Pool[i];
-		Thread->Shutdown();
+		WakeSignal.Signal();
 	}
 
 	// Wait them to terminate
@@ -598,109 +668,203 @@ void Shutdown()
 	unguard;
 }
 
-} // namespace ThreadPool
+void PrintStats()
+{
+	if (NumPoolThreads <= 0) return;
 
+	appPrintf("Thread pool: %d threads, %d tasks executed by non-pool threads\n", NumPoolThreads, NumExternalTasks);
+	for (int i = 0; i < NumPoolThreads; i++)
+	{
+		const CPoolThread* Thread = Pool[i];
+		appPrintf("  %2d: %6d tasks, %5d steals, idle %.1f sec\n", i, Thread->NumTasks, Thread->NumSteals, Thread->IdleTime / 1000.0f);
+	}
+}
 
 /*-----------------------------------------------------------------------------
-	ParallelFor
+	CTaskGroup
 -----------------------------------------------------------------------------*/
 
-namespace ParallelForImpl
+CTaskGroup::CTaskGroup()
+: NumPending(1)
+{}
+
+CTaskGroup::~CTaskGroup()
 {
+	Wait();
+}
 
-ParallelForBase::ParallelForBase(int inCount)
-: numActiveThreads(0)
-, bAllSentToThreads(false)
-, currentIndex(0)
-, lastIndex(inCount)
-{}
+void CTaskGroup::Run(ThreadTask task, void* taskData)
+{
+	InitPool();
+
+	InterlockedIncrement(&NumPending);
 
-ParallelForBase::~ParallelForBase()
+	CPoolTask Task;
+	Task.task = task;
+	Task.data = taskData;
+	Task.fence = NULL;
+	Task.group = this;
+
+	if (!NumPoolThreads)
+		Task.Exec();
+	else
+		QueueTask(Task);
+}
+
+void CTaskGroup::TaskCompleted()
 {
-	// Wait for completion: the last thread which will complete the job will
-	// signal 'endSignal' about completion.
-	if (numActiveThreads)
-	{
-		guard(ParallelForWait);
-		endSignal.Wait();
-		unguard;
-	}
+	// NumPending could reach zero only when Wait() has released the group's reference, i.e. someone waits for signal
+	if (InterlockedDecrement(&NumPending) == 0)
+		CompleteSignal.Signal();
 }
 
-void ParallelForBase::Start(ThreadPool::ThreadTask worker)
+void CTaskGroup::Wait()
 {
-	if (lastIndex == 0)
-		return;
+	guard(CTaskGroup::Wait);
 
-	//todo: review code
-	int maxThreads = CThread::GetLogicalCPUCount();
-	int stepDivisor = maxThreads * 20;		// assume each thread will request for data 20 times
-	step = (lastIndex + stepDivisor - 1) / stepDivisor;
-	if (step < 20) step = 20; //?? should override for slow tasks, e.g. processing 10 items 1 second each
+	// Help with queued tasks while waiting
+	while (NumPending > 1 && HelpWithTask())
+	{}
 
-	// Divide index count by 'step' with rounding up
-	int numThreads = (lastIndex + step - 1) / step;
+	// Remaining tasks are executed by other threads, release the group's reference and wait for signal
+	if (InterlockedDecrement(&NumPending) != 0)
+		CompleteSignal.Wait();
+	NumPending = 1;
 
-	// Recompute step to avoid having tiny last step
-	step = (lastIndex + numThreads - 1) / numThreads;
-	assert(step > 0);
+	unguard;
+}
 
-	// Clamp numThreads by available thread count
-	if (numThreads > maxThreads)
-		numThreads = maxThreads;
+} // namespace ThreadPool
 
-#if DEBUG_PARALLEL_FOR
-	printf("ParallelFor: %d, %d, step %d (thread %d)\n", currentIndex, lastIndex, step, CThread::CurrentId()&255);
-#endif
 
-	// Allocate threads, exclude 1 thread for the thread executing ParallelFor
+/*-----------------------------------------------------------------------------
+	ParallelFor
+-----------------------------------------------------------------------------*/
+
+namespace ParallelForImpl
+{
+
+// Shared state of ParallelFor. Allocated on heap: helper tasks could be started after ParallelFor returns,
+// when the work was completed without them.
+struct CParallelForState
+{
+	CSemaphore		endSignal;
+	// Number of threads which are processing items, including the reservation made by ParallelFor caller
+	volatile int32	numRunning;
+	volatile int32	refCount;
+	volatile int32	currentIndex;
+	int				lastIndex;
+	int				step;
+	void*			func;
+	RangeFunc		execRange;
 
-	// Reserve 1 "active thread", so if the 1st spawned thread will finish the job before
-	// we'll be able to spawn anything else - it won't send "completed" signal.
-	InterlockedIncrement(&numActiveThreads);
+	FORCEINLINE bool GrabInterval(int& idx1, int& idx2)
+	{
+		if (currentIndex >= lastIndex) return false;
+		idx1 = InterlockedAdd(&currentIndex, step);
+		if (idx1 >= lastIndex) return false;
+		idx2 = min(idx1 + step, lastIndex);
+		return true;
+	}
 
-	// Spawn as many threads as planned. Stop allocating new threads if job will be completed
-	// faster than planned (verify bAllSentToThreads as a loop condition).
-	for (int i = 0; i < numThreads - 1 && !bAllSentToThreads; i++)
+	void ProcessItems()
 	{
-		// Just in case, increment thread count before starting a thread, so we'll avoid
-		// the situation when worker thread will execute everything before we'll return
-		// to the invoker (main) thread and increment count.
-		InterlockedIncrement(&numActiveThreads);
-		if (!ThreadPool::ExecuteInThread(worker, this))
+		int idx1, idx2;
+		while (GrabInterval(idx1, idx2))
 		{
-			// All threads has been allocated, can't spawn more.
-			// Decrement the thread count as we've failed to use new thread.
-			InterlockedDecrement(&numActiveThreads);
-			break;
+			execRange(func, idx1, idx2);
 		}
 	}
 
-	// Remove thread "reservation". If at this moment everything has been completed, the
-	// value goes to zero, and we'll not perform waiting for completion in destructor. If
-	// something is still works, then we'll wait, and the worker thread will send a signal
-	// when count finally decremented to 0.
-	InterlockedDecrement(&numActiveThreads);
-}
+	void Release()
+	{
+		if (InterlockedDecrement(&refCount) == 0)
+			delete this;
+	}
+
+	static void HelperTask(void* data)
+	{
+		guard(ParallelFor::HelperTask);
+
+		CParallelForState* State = (CParallelForState*)data;
+		// Register as running before grabbing items: if ParallelFor caller has already dropped its reservation,
+		// all items were already grabbed, and we'll not call 'func' which may be already destroyed.
+		InterlockedIncrement(&State->numRunning);
+		State->ProcessItems();
+		if (InterlockedDecrement(&State->numRunning) == 0)
+			State->endSignal.Signal();
+		State->Release();
+
+		unguard;
+	}
+
+	// Remove reservation made by ParallelFor caller and wait for threads which are still processing items
+	void Finish()
+	{
+		if (InterlockedDecrement(&numRunning) != 0)
+		{
+			guard(ParallelForWait);
+			endSignal.Wait();
+			unguard;
+		}
+		Release();
+	}
+};
 
-bool ParallelForBase::GrabInterval(int& idx1, int& idx2)
+void Run(int Count, void* Func, RangeFunc ExecRange)
 {
-	CMutex::ScopedLock lock(mutex);
-	idx1 = currentIndex;
-	if (idx1 >= lastIndex)
+	if (Count <= 0) return;
+
+	int NumThreads = ThreadPool::GetNumThreads();
+	if (NumThreads == 0 || Count == 1)
+	{
+		ExecRange(Func, 0, Count);
+		return;
+	}
+
+	CParallelForState* State = new CParallelForState;
+	// Split work to chunks, so each thread will grab data about 8 times, what gives good balancing for
+	// items with different processing time
+	int Step = Count / ((NumThreads + 1) * 8);
+	if (Step < 1) Step = 1;
+	int NumHelpers = min(NumThreads, (Count + Step - 1) / Step - 1);
+
+	State->numRunning = 1;
+	State->refCount = NumHelpers + 1;
+	State->currentIndex = 0;
+	State->lastIndex = Count;
+	State->step = Step;
+	State->func = Func;
+	State->execRange = ExecRange;
+
+	// Queue helper tasks. Idle threads will steal them, busy threads will pick them up only when the work
+	// is still not completed.
+	ThreadPool::CPoolTask Task;
+	Task.task = CParallelForState::HelperTask;
+	Task.data = State;
+	Task.fence = NULL;
+	Task.group = NULL;
+	for (int i = 0; i < NumHelpers; i++)
 	{
-		// All items were sent to threads
-		bAllSentToThreads = true;
-		return false;
+		ThreadPool::QueueTask(Task);
+	}
+
+	// Process items in the current thread
+#if DO_GUARD
+	TRY {
+#endif
+		State->ProcessItems();
+#if DO_GUARD
+	} CATCH_CRASH {
+		// Helpers are using 'Func' which will be destroyed during unwinding of the caller's stack. Don't let
+		// them grab new items, and wait for ones which are still executing.
+		State->currentIndex = State->lastIndex;
+		State->Finish();
+		THROW;
 	}
-	idx2 = idx1 + step;
-	if (idx2 > lastIndex)
-		idx2 = lastIndex;
-	currentIndex = idx2;
-#if DEBUG_PARALLEL_FOR
-	printf("thread %d: GET %d .. %d [%d]\n", CThread::CurrentId()&255, idx1, idx2, idx2 - idx1);
 #endif
-	return true;
+
+	State->Finish();
 }
 
 } // namespace ParallelForImpl
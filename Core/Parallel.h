@@ -274,7 +274,8 @@ namespace ThreadPool
 
 typedef void (*ThreadTask)(void*);
 
-// Execute ThreadTask in thread. Return false if there's no free threads
+// Execute ThreadTask in thread. Return false if there's no idle threads. With 'allowQueue' the task is always
+// accepted: it is put to the queue and will be picked up by the first thread which will become free.
 bool ExecuteInThread(ThreadTask task, void* taskData, CSemaphore* fence = NULL, bool allowQueue = false);
 
 #define TryExecuteInThread(...) TryExecuteInThreadImpl(__FUNCTION__, __VA_ARGS__)
@@ -324,109 +325,103 @@ FORCEINLINE void TryExecuteInThreadImpl(F& task, CSemaphore* fence = NULL, bool
 	static_assert(sizeof(task) == 0, "TryExecuteInThread can't accept lvalue");
 }
 
+// Handle for a set of tasks. Tasks are always queued, Wait() executes queued tasks in the calling thread
+// while the group is not completed, so it is safe to wait for a group from inside of a pool thread.
+class CTaskGroup
+{
+public:
+	CTaskGroup();
+	~CTaskGroup();
+
+	void Run(ThreadTask task, void* taskData);
+
+	template<typename F>
+	void Run(F&& task)
+	{
+		struct Worker
+		{
+			Worker(F&& inTask)
+			: task(MoveTemp(inTask))
+			{}
+
+			F task;
+
+			static void Proc(void* data)
+			{
+				Worker* worker = (Worker*)data;
+				guard(CTaskGroup::Run);
+				worker->task();
+				unguard;
+				delete worker;
+			}
+		};
+		Run(Worker::Proc, new Worker(MoveTemp(task)));
+	}
+
+	void Wait();
+
+	FORCEINLINE bool IsCompleted() const
+	{
+		return NumPending <= 1;
+	}
+
+protected:
+	// Number of unfinished tasks plus 1 "reference" held by the group itself, which is released by Wait().
+	// This way the last task signals the semaphore only when someone waits for it.
+	volatile int32 NumPending;
+	CSemaphore	CompleteSignal;
+
+	friend struct CPoolTask;
+	void TaskCompleted();
+};
+
+// Number of threads in pool, not counting the main thread
+int GetNumThreads();
+
 void WaitForCompletion();
 
 void Shutdown();
 
+// Print per-thread statistics: number of executed and stolen tasks, idle time
+void PrintStats();
+
 }
 
 /*-----------------------------------------------------------------------------
 	ParallelFor
 -----------------------------------------------------------------------------*/
 
-//#define DEBUG_PARALLEL_FOR 1
-
 namespace ParallelForImpl
 {
 
-class ParallelForBase
-{
-public:
-	CMutex mutex;
-	CSemaphore endSignal;
-	int8 numActiveThreads;
-	bool bAllSentToThreads;
-	int currentIndex;
-	int lastIndex;
-	int step;
-
-	ParallelForBase(int inCount);
-	~ParallelForBase();
-
-	void Start(::ThreadPool::ThreadTask worker);
+typedef void (*RangeFunc)(void* Func, int idx1, int idx2);
 
-	bool GrabInterval(int& idx1, int& idx2);
-};
+// Execute 'ExecRange' for all items in [0, Count) range using pool threads. Could be called from pool threads:
+// the caller processes items itself and never waits for helper tasks which weren't started yet.
+void Run(int Count, void* Func, RangeFunc ExecRange);
 
 template<typename F>
-class ParallelForWorker : public ParallelForBase
+void ExecuteRange(void* Func, int idx1, int idx2)
 {
-public:
-	F Func;
-
-	ParallelForWorker(int InCount, F&& InFunc)
-	: ParallelForBase(InCount)
-	, Func(InFunc)
+	F& f = *(F*)Func;
+	int idx = idx1;
+	guard(ParallelForWorker::ExecuteRange);
+	while (idx < idx2)
 	{
-		guard(ParallelFor);
-
-		Start(PoolThreadWorker);
-
-		// Add processing for main thread
-		int idx1, idx2;
-		while (GrabInterval(idx1, idx2))
-		{
-			ExecuteRange(idx1, idx2);
-			//todo: may be periodically check if one of threads were released from another work and can be picked up?
-		}
-		unguard;
+		f(idx++);
 	}
-
-	FORCEINLINE void ExecuteRange(int idx1, int idx2)
-	{
-		int idx = idx1;
-		guard(ParallelForWorker::ExecuteRange);
-		while (idx < idx2)
-		{
-			Func(idx++);
-		}
-		unguardf("%d [%d,%d]/%d", idx, idx1, idx2, lastIndex);
-	}
-
-	static void PoolThreadWorker(void* data)
-	{
-		guard(PoolThreadWorker);
-
-	#if DEBUG_PARALLEL_FOR
-		printf("...... %d: started\n", CThread::CurrentId()&255);
-	#endif
-
-		ParallelForWorker& w = *(ParallelForWorker*)data;
-
-		int idx1, idx2;
-		while (w.GrabInterval(idx1, idx2))
-		{
-			w.ExecuteRange(idx1, idx2);
-		}
-
-		// End the thread, send signal if this was the last allocated thread
-		if (InterlockedDecrement(&w.numActiveThreads) == 0)
-			w.endSignal.Signal();
-
-	#if DEBUG_PARALLEL_FOR
-		printf("...... %d: finished\n", CThread::CurrentId()&255);
-	#endif
-
-		unguard;
-	}
-};
+	unguardf("%d [%d,%d]", idx, idx1, idx2);
+}
 
 } // namespace ParallelForImpl
 
 template<typename F>
 FORCEINLINE void ParallelFor(int Count, F&& Func)
 {
-	ParallelForImpl::ParallelForWorker<F> Worker(Count, MoveTemp(Func));
+	guard(ParallelFor);
+	typedef typename TRemoveReference<F>::Type FuncType;
+	ParallelForImpl::Run(Count, (void*)&Func, ParallelForImpl::ExecuteRange<FuncType>);
+	unguard;
 }
 
 
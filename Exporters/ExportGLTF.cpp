@@ -31,7 +31,55 @@ static CVec3 GetMaterialDebugColor(int Index)
 	return r;
 }
 
-static void ExportMaterial(UUnrealMaterial* Mat, FArchive& Ar, int index, bool bLast)
+// Text buffer for glTF json. The whole json is composed in memory and written with a single call:
+// glb file requires size of json chunk before its contents.
+struct GLTFJsonWriter
+{
+	char* Data;
+	int Size;
+	int Capacity;
+
+	GLTFJsonWriter()
+	: Data(NULL)
+	, Size(0)
+	, Capacity(0)
+	{}
+
+	~GLTFJsonWriter()
+	{
+		if (Data) appFree(Data);
+	}
+
+	void Reserve(int Count)
+	{
+		if (Size + Count > Capacity)
+		{
+			Capacity = max(Capacity * 2, Size + Count);
+			Data = (char*)appRealloc(Data, Capacity);
+		}
+	}
+
+	void Printf(const char* fmt, ...)
+	{
+		Reserve(1024);
+		while (true)
+		{
+			va_list argptr;
+			va_start(argptr, fmt);
+			int len = vsnprintf(Data + Size, Capacity - Size, fmt, argptr);
+			va_end(argptr);
+			if (len >= 0 && len < Capacity - Size)
+			{
+				Size += len;
+				return;
+			}
+			// Not enough space, grow the buffer and try again
+			Reserve(len >= 0 ? len + 1 : Capacity);
+		}
+	}
+};
+
+static void ExportMaterial(UUnrealMaterial* Mat, GLTFJsonWriter& Ar, int index, bool bLast)
 {
 	char dummyName[64];
 	appSprintf(ARRAY_ARG(dummyName), "dummy_material_%d", index);
@@ -85,7 +133,7 @@ struct BufferData
 		FLOAT = 5126
 	};
 
-	byte* Data;
+	int Offset;				// position in GLTFExportContext::BinData
 	int DataSize;
 	int ComponentType;
 	int Count;
@@ -99,38 +147,13 @@ struct BufferData
 	int ItemSize;
 #endif
 
+	// Data for finding identical animation blocks
+	uint32 Hash;
+	int HashNext;
+
 	FString BoundsMin;
 	FString BoundsMax;
 
-	BufferData()
-	: Data(NULL)
-	, DataSize(0)
-	{}
-
-	~BufferData()
-	{
-		if (Data) appFree(Data);
-	}
-
-	void Setup(int InCount, const char* InType, int InComponentType, int InItemSize, bool InNormalized = false)
-	{
-		Count = InCount;
-		Type = InType;
-		bNormalized = InNormalized;
-		ComponentType = InComponentType;
-		DataSize = InCount * InItemSize;
-		// Align all buffers by 4, as requested by glTF format
-		DataSize = Align(DataSize, 4);
-		// Use aligned alloc for CVec4
-		Data = (byte*) appMalloc(DataSize, 16);
-
-		FillPtr = Data;
-#if MAX_DEBUG
-		FillCount = 0;
-		ItemSize = InItemSize;
-#endif
-	}
-
 	template<typename T>
 	inline void Put(const T& p)
 	{
@@ -138,21 +161,19 @@ struct BufferData
 		assert(sizeof(T) == ItemSize);
 		assert(FillCount++ < Count);
 #endif
-		*(T*)FillPtr = p;
+		// Data inside the binary chunk is aligned by 4 only, use memcpy for CVec4
+		memcpy(FillPtr, &p, sizeof(T));
 		FillPtr += sizeof(T);
 	}
+};
 
-	bool IsSameAs(const BufferData& Other) const
-	{
-		// Compare metadata
-		if (Count != Other.Count || strcmp(Type, Other.Type) != 0 || ComponentType != Other.ComponentType ||
-			bNormalized != Other.bNormalized || DataSize != Other.DataSize)
-		{
-			return false;
-		}
-		// Compare data
-		return (memcmp(Data, Other.Data, DataSize) == 0);
-	}
+// Section's vertices and indices remapped to a section-local vertex set
+struct SectionRemap
+{
+	int FirstVert;			// index in GLTFExportContext::SectionVerts
+	int NumVerts;
+	int FirstIndex;			// index in GLTFExportContext::SectionIndices
+	int NumIndices;
 };
 
 struct GLTFExportContext
@@ -160,65 +181,189 @@ struct GLTFExportContext
 	const char* MeshName;
 	const CSkeletalMesh* SkelMesh;
 	const CStaticMesh* StatMesh;
+	bool bBinary;			// write .glb file instead of .gltf + .bin
 
 	TArray<BufferData> Data;
 
+	// Binary chunk holding data of all buffers. It is reserved before filling the
+	// buffers, so FillPtr remains valid while the data is being written.
+	byte* BinData;
+	int BinSize;
+	int BinCapacity;
+
+	// Results of RemapSections()
+	TArray<SectionRemap> Sections;
+	TArray<int> SectionVerts;	// new vertex index -> old vertex index, for all sections
+	TArray<int> SectionIndices;	// remapped indices, for all sections
+
+	enum { HASH_SIZE = 256 };
+	int HashHead[HASH_SIZE];	// index of BufferData + 1
+
 	GLTFExportContext()
 	{
 		memset(this, 0, sizeof(*this));
 	}
 
+	~GLTFExportContext()
+	{
+		if (BinData) appFree(BinData);
+	}
+
 	inline bool IsSkeletal() const
 	{
 		return SkelMesh != NULL;
 	}
 
+	inline const UObject* GetOriginalMesh() const
+	{
+		return IsSkeletal() ? SkelMesh->OriginalMesh : StatMesh->OriginalMesh;
+	}
+
+	// Make sure binary chunk has room for Size more bytes
+	void ReserveBinary(int Size)
+	{
+		if (BinSize + Size > BinCapacity)
+		{
+			BinCapacity = BinSize + Size;
+			BinData = (byte*)appRealloc(BinData, BinCapacity);
+		}
+	}
+
+	void SetupBuffer(BufferData& B, int InCount, const char* InType, int InComponentType, int InItemSize, bool InNormalized = false)
+	{
+		B.Count = InCount;
+		B.Type = InType;
+		B.bNormalized = InNormalized;
+		B.ComponentType = InComponentType;
+		// Align all buffers by 4, as requested by glTF format
+		B.DataSize = Align(InCount * InItemSize, 4);
+		B.Offset = BinSize;
+		assert(BinSize + B.DataSize <= BinCapacity);
+		BinSize += B.DataSize;
+		// Zero alignment bytes
+		memset(BinData + B.Offset + InCount * InItemSize, 0, B.DataSize - InCount * InItemSize);
+
+		B.FillPtr = BinData + B.Offset;
+#if MAX_DEBUG
+		B.FillCount = 0;
+		B.ItemSize = InItemSize;
+#endif
+	}
+
+	bool IsSameData(const BufferData& A, const BufferData& B) const
+	{
+		// Compare metadata
+		if (A.Count != B.Count || strcmp(A.Type, B.Type) != 0 || A.ComponentType != B.ComponentType ||
+			A.bNormalized != B.bNormalized || A.DataSize != B.DataSize)
+		{
+			return false;
+		}
+		// Compare data
+		return (memcmp(BinData + A.Offset, BinData + B.Offset, A.DataSize) == 0);
+	}
+
 	// Compare last item of Data with other itest starting with FirstDataIndex, drop the data
 	// if same data block found and return its index. If no matching data were found, return
-	// index of that last data.
+	// index of that last data. Blocks are found by hash of their contents.
 	int GetFinalIndexForLastBlock(int FirstDataIndex)
 	{
 		int LastIndex = Data.Num()-1;
-		const BufferData& LastData = Data[LastIndex];
-		for (int index = FirstDataIndex; index < LastIndex; index++)
+		BufferData& LastData = Data[LastIndex];
+
+		// Buffer sizes are multiple of 4
+		uint32 Hash = 2166136261u;
+		const uint32* p = (uint32*)(BinData + LastData.Offset);
+		for (int i = LastData.DataSize / 4; i > 0; i--, p++)
 		{
-			if (LastData.IsSameAs(Data[index]))
+			Hash = (Hash ^ *p) * 16777619u;
+		}
+		LastData.Hash = Hash;
+
+		int& Head = HashHead[Hash & (HASH_SIZE-1)];
+		for (int index = Head - 1; index >= FirstDataIndex; index = Data[index].HashNext - 1)
+		{
+			if (Data[index].Hash == Hash && IsSameData(LastData, Data[index]))
 			{
-				// Found matching data
+				// Found matching data; it was placed at the end of binary chunk, release that space
+				assert(LastData.Offset + LastData.DataSize == BinSize);
+				BinSize = LastData.Offset;
 				Data.RemoveAt(LastIndex);
 				return index;
 			}
 		}
 		// Not found
+		LastData.HashNext = Head;
+		Head = LastIndex + 1;
 		return LastIndex;
 	}
 };
 
-#define VERT(n)		*OffsetPointer(Verts, (n) * VertexSize)
-
-static void ExportSection(GLTFExportContext& Context, const CBaseMeshLod& Lod, const CMeshVertex* Verts, int SectonIndex, FArchive& Ar)
+// Build local vertex and index lists for all mesh sections with a single pass over index buffer
+static void RemapSections(GLTFExportContext& Context, const CBaseMeshLod& Lod)
 {
-	guard(ExportSection);
+	guard(RemapSections);
 
-	int VertexSize = Context.IsSkeletal() ? sizeof(CSkelMeshVertex) : sizeof(CStaticMeshVertex);
+	int NumSections = Lod.Sections.Num();
+	int TotalIndices = 0;
+	for (int i = 0; i < NumSections; i++)
+	{
+		TotalIndices += Lod.Sections[i].NumFaces * 3;
+	}
+
+	Context.Sections.AddUninitialized(NumSections);
+	Context.SectionIndices.AddUninitialized(TotalIndices);
+	Context.SectionVerts.Empty(Lod.NumVerts);
 
-	const CMeshSection& S = Lod.Sections[SectonIndex];
-	bool bLast = (SectonIndex == Lod.Sections.Num()-1);
+	// Vertex may be shared between sections, so store the section which did the last remap
+	TArray<int> VertRemap;		// old vertex index -> new vertex index
+	TArray<int> VertSection;
+	VertRemap.AddUninitialized(Lod.NumVerts);
+	VertSection.Init(-1, Lod.NumVerts);
 
-	// Remap section indices to local indices
-	CIndexBuffer::IndexAccessor_t GetIndex = Lod.Indices.GetAccessor();
-	TArray<int> indexRemap; // old vertex index -> new vertex index
-	indexRemap.Init(-1, Lod.NumVerts);
-	int numLocalVerts = 0;
-	int numLocalIndices = S.NumFaces * 3;
-	for (int idx = 0; idx < numLocalIndices; idx++)
+	int* pIndex = Context.SectionIndices.GetData();
+	Lod.Indices.ForEach16or32([&](const auto* Index)
 	{
-		int vertIndex = GetIndex(S.FirstIndex + idx);
-		if (indexRemap[vertIndex] == -1)
+		for (int SectionIndex = 0; SectionIndex < NumSections; SectionIndex++)
 		{
-			indexRemap[vertIndex] = numLocalVerts++;
+			const CMeshSection& S = Lod.Sections[SectionIndex];
+			SectionRemap& R = Context.Sections[SectionIndex];
+			R.FirstVert = Context.SectionVerts.Num();
+			R.FirstIndex = pIndex - Context.SectionIndices.GetData();
+			R.NumIndices = S.NumFaces * 3;
+			const auto* SectionIndices = Index + S.FirstIndex;
+			for (int idx = 0; idx < R.NumIndices; idx++)
+			{
+				int vertIndex = SectionIndices[idx];
+				if (VertSection[vertIndex] != SectionIndex)
+				{
+					VertSection[vertIndex] = SectionIndex;
+					VertRemap[vertIndex] = Context.SectionVerts.Num() - R.FirstVert;
+					Context.SectionVerts.Add(vertIndex);
+				}
+				*pIndex++ = VertRemap[vertIndex];
+			}
+			R.NumVerts = Context.SectionVerts.Num() - R.FirstVert;
 		}
-	}
+	});
+
+	unguard;
+}
+
+#define VERT(n)		*OffsetPointer(Verts, (n) * VertexSize)
+
+static void ExportSection(GLTFExportContext& Context, const CBaseMeshLod& Lod, const CMeshVertex* Verts, int SectonIndex, GLTFJsonWriter& Ar)
+{
+	guard(ExportSection);
+
+	int VertexSize = Context.IsSkeletal() ? sizeof(CSkelMeshVertex) : sizeof(CStaticMeshVertex);
+
+	// Section's vertices and indices were prepared by RemapSections()
+	const SectionRemap& R = Context.Sections[SectonIndex];
+	int numLocalVerts = R.NumVerts;
+	int numLocalIndices = R.NumIndices;
+	// Reverse index map for fast lookup of vertex by its new index
+	const int* revIndexMap = &Context.SectionVerts[R.FirstVert];
+	const int* localIndices = &Context.SectionIndices[R.FirstIndex];
 
 	// Prepare buffers
 	int IndexBufIndex = Context.Data.AddZeroed();
@@ -255,65 +400,53 @@ static void ExportSection(GLTFExportContext& Context, const CBaseMeshLod& Lod, c
 	BufferData* BonesBuf = NULL;
 	BufferData* WeightsBuf = NULL;
 
-	PositionBuf.Setup(numLocalVerts, "VEC3", BufferData::FLOAT, sizeof(CVec3));
-	NormalBuf.Setup(numLocalVerts, "VEC3", BufferData::FLOAT, sizeof(CVec3));
-	TangentBuf.Setup(numLocalVerts, "VEC4", BufferData::FLOAT, sizeof(CVec4));
-	for (int i = 0; i < Lod.NumTexCoords; i++)
+	// Place buffers in binary chunk in the same order as they're referenced in json
+	bool bIndex16 = (numLocalVerts <= 65536);
+	if (bIndex16)
 	{
-		UVBuf[i] = &Context.Data[UVBufIndex[i]];
-		UVBuf[i]->Setup(numLocalVerts, "VEC2", BufferData::FLOAT, sizeof(CMeshUVFloat));
+		Context.SetupBuffer(IndexBuf, numLocalIndices, "SCALAR", BufferData::UNSIGNED_SHORT, sizeof(uint16));
 	}
+	else
+	{
+		Context.SetupBuffer(IndexBuf, numLocalIndices, "SCALAR", BufferData::UNSIGNED_INT, sizeof(uint32));
+	}
+	Context.SetupBuffer(PositionBuf, numLocalVerts, "VEC3", BufferData::FLOAT, sizeof(CVec3));
+	Context.SetupBuffer(NormalBuf, numLocalVerts, "VEC3", BufferData::FLOAT, sizeof(CVec3));
+	Context.SetupBuffer(TangentBuf, numLocalVerts, "VEC4", BufferData::FLOAT, sizeof(CVec4));
 
 	if (Lod.VertexColors)
 	{
 		ColorBuf = &Context.Data[ColorBufIndex];
-		ColorBuf->Setup(numLocalVerts, "VEC4", BufferData::UNSIGNED_BYTE, 4, /*InNormalized=*/ true);
+		Context.SetupBuffer(*ColorBuf, numLocalVerts, "VEC4", BufferData::UNSIGNED_BYTE, 4, /*InNormalized=*/ true);
 	}
 
 	if (Context.IsSkeletal())
 	{
 		BonesBuf = &Context.Data[BonesBufIndex];
 		WeightsBuf = &Context.Data[WeightsBufIndex];
-		BonesBuf->Setup(numLocalVerts, "VEC4", BufferData::UNSIGNED_SHORT, sizeof(uint16)*4);
-		WeightsBuf->Setup(numLocalVerts, "VEC4", BufferData::UNSIGNED_BYTE, sizeof(uint32), /*InNormalized=*/ true);
+		Context.SetupBuffer(*BonesBuf, numLocalVerts, "VEC4", BufferData::UNSIGNED_SHORT, sizeof(uint16)*4);
+		Context.SetupBuffer(*WeightsBuf, numLocalVerts, "VEC4", BufferData::UNSIGNED_BYTE, sizeof(uint32), /*InNormalized=*/ true);
 	}
 
-	// Prepare and build indices
-	TArray<int> localIndices;
-	localIndices.AddUninitialized(numLocalIndices);
-	int* pIndex = localIndices.GetData();
-	for (int i = 0; i < numLocalIndices; i++)
+	for (int i = 0; i < Lod.NumTexCoords; i++)
 	{
-		*pIndex++ = GetIndex(S.FirstIndex + i);
+		UVBuf[i] = &Context.Data[UVBufIndex[i]];
+		Context.SetupBuffer(*UVBuf[i], numLocalVerts, "VEC2", BufferData::FLOAT, sizeof(CMeshUVFloat));
 	}
 
-	if (numLocalVerts <= 65536)
+	// Build indices
+	if (bIndex16)
 	{
-		IndexBuf.Setup(numLocalIndices, "SCALAR", BufferData::UNSIGNED_SHORT, sizeof(uint16));
 		for (int idx = 0; idx < numLocalIndices; idx++)
 		{
-			IndexBuf.Put<uint16>(indexRemap[localIndices[idx]]);
+			IndexBuf.Put<uint16>(localIndices[idx]);
 		}
 	}
 	else
 	{
-		IndexBuf.Setup(numLocalIndices, "SCALAR", BufferData::UNSIGNED_INT, sizeof(uint32));
 		for (int idx = 0; idx < numLocalIndices; idx++)
 		{
-			IndexBuf.Put<uint32>(indexRemap[localIndices[idx]]);
-		}
-	}
-
-	// Build reverse index map for fast lookup of vertex by its new index.
-	// It maps new vertex index to old vertex index.
-	TArray<int> revIndexMap;
-	revIndexMap.AddUninitialized(numLocalVerts);
-	for (int i = 0; i < indexRemap.Num(); i++)
-	{
-		int newIndex = indexRemap[i];
-		if (newIndex != -1)
-		{
-			revIndexMap[newIndex] = i;
+			IndexBuf.Put<uint32>(localIndices[idx]);
 		}
 	}
 
@@ -356,7 +489,7 @@ static void ExportSection(GLTFExportContext& Context, const CBaseMeshLod& Lod, c
 
 	// Compute bounds for PositionBuf
 	CVec3 Mins, Maxs;
-	ComputeBounds((CVec3*)PositionBuf.Data, numLocalVerts, sizeof(CVec3), Mins, Maxs);
+	ComputeBounds((CVec3*)(Context.BinData + PositionBuf.Offset), numLocalVerts, sizeof(CVec3), Mins, Maxs);
 	char buf[256];
 	appSprintf(ARRAY_ARG(buf), "[ %g, %g, %g ]", VECTOR_ARG(Mins));
 	PositionBuf.BoundsMin = buf;
@@ -479,7 +612,7 @@ struct CMat4
 	}
 };
 
-static void ExportSkinData(GLTFExportContext& Context, const CSkelMeshLod& Lod, FArchive& Ar)
+static void ExportSkinData(GLTFExportContext& Context, const CSkelMeshLod& Lod, GLTFJsonWriter& Ar)
 {
 	guard(ExportSkinData);
 
@@ -487,7 +620,7 @@ static void ExportSkinData(GLTFExportContext& Context, const CSkelMeshLod& Lod,
 
 	int MatrixBufIndex = Context.Data.AddZeroed();
 	BufferData& MatrixBuf = Context.Data[MatrixBufIndex];
-	MatrixBuf.Setup(numBones, "MAT4", BufferData::FLOAT, sizeof(CMat4));
+	Context.SetupBuffer(MatrixBuf, numBones, "MAT4", BufferData::FLOAT, sizeof(CMat4));
 
 	Ar.Printf(
 		"  \"nodes\" : [\n"
@@ -603,7 +736,7 @@ static void ExportSkinData(GLTFExportContext& Context, const CSkelMeshLod& Lod,
 	unguard;
 }
 
-static void ExportAnimations(GLTFExportContext& Context, FArchive& Ar)
+static void ExportAnimations(GLTFExportContext& Context, GLTFJsonWriter& Ar)
 {
 	guard(ExportAnimations);
 
@@ -631,6 +764,22 @@ static void ExportAnimations(GLTFExportContext& Context, FArchive& Ar)
 		}
 	}
 
+	// Reserve binary chunk space for all animation data, assuming no data blocks are shared
+	int AnimDataSize = 0;
+	for (int SeqIndex = 0; SeqIndex < Anim->Sequences.Num(); SeqIndex++)
+	{
+		const CAnimSequence &Seq = *Anim->Sequences[SeqIndex];
+		for (int BoneIndex = 0; BoneIndex < AnimBones.Num(); BoneIndex++)
+		{
+			const CAnimTrackView Track = Seq.GetTrack(BoneMap[AnimBones[BoneIndex]]);
+			if (Track.HasKeys())
+			{
+				AnimDataSize += Track.KeyPos.Num() * (sizeof(float) + sizeof(CVec3)) + Track.KeyQuat.Num() * (sizeof(float) + sizeof(CQuat));
+			}
+		}
+	}
+	Context.ReserveBinary(AnimDataSize);
+
 	Ar.Printf(
 		"  \"animations\" : [\n"
 	);
@@ -658,7 +807,7 @@ static void ExportAnimations(GLTFExportContext& Context, FArchive& Ar)
 
 			int BoneNodeIndex;
 			ChannelType Type;
-			const CAnimTrack* Track;
+			CAnimTrackView Track;
 		};
 
 		TArray<AnimSampler> Samplers;
@@ -677,8 +826,8 @@ static void ExportAnimations(GLTFExportContext& Context, FArchive& Ar)
 			int MeshBoneIndex = AnimBones[BoneIndex];
 			int AnimBoneIndex = BoneMap[MeshBoneIndex];
 
-			const CAnimTrack* Track = Seq.Tracks[AnimBoneIndex];
-			if (!Track->HasKeys())
+			const CAnimTrackView Track = Seq.GetTrack(AnimBoneIndex);
+			if (!Track.HasKeys())
 			{
 				//todo: may be store a reference pose position then?
 				continue;
@@ -726,17 +875,17 @@ static void ExportAnimations(GLTFExportContext& Context, FArchive& Ar)
 			const AnimSampler& Sampler = Samplers[SamplerIndex];
 
 			// Prepare time array
-			const TArray<float>* TimeArray = (Sampler.Type == AnimSampler::TRANSLATION) ? &Sampler.Track->KeyPosTime : &Sampler.Track->KeyQuatTime;
+			const TAnimKeyView<float>* TimeArray = (Sampler.Type == AnimSampler::TRANSLATION) ? &Sampler.Track.KeyPosTime : &Sampler.Track.KeyQuatTime;
 			if (TimeArray->Num() == 0)
 			{
 				// For this situation, use track's time array
-				TimeArray = &Sampler.Track->KeyTime;
+				TimeArray = &Sampler.Track.KeyTime;
 			}
-			int NumKeys = Sampler.Type == (AnimSampler::TRANSLATION) ? Sampler.Track->KeyPos.Num() : Sampler.Track->KeyQuat.Num();
+			int NumKeys = Sampler.Type == (AnimSampler::TRANSLATION) ? Sampler.Track.KeyPos.Num() : Sampler.Track.KeyQuat.Num();
 
 			int TimeBufIndex = Context.Data.AddZeroed();
 			BufferData& TimeBuf = Context.Data[TimeBufIndex];
-			TimeBuf.Setup(NumKeys, "SCALAR", BufferData::FLOAT, sizeof(float));
+			Context.SetupBuffer(TimeBuf, NumKeys, "SCALAR", BufferData::FLOAT, sizeof(float));
 
 			// Compute RateScale. Take care of null Rate - this might be valid if animation has just 1 frame (pose)
 			float RateScale = (Seq.Rate > 0.001f) ? 1.0f / Seq.Rate : 1.0f;
@@ -773,10 +922,10 @@ static void ExportAnimations(GLTFExportContext& Context, FArchive& Ar)
 			if (Sampler.Type == AnimSampler::TRANSLATION)
 			{
 				// Translation track
-				DataBuf.Setup(NumKeys, "VEC3", BufferData::FLOAT, sizeof(CVec3));
+				Context.SetupBuffer(DataBuf, NumKeys, "VEC3", BufferData::FLOAT, sizeof(CVec3));
 				for (int i = 0; i < NumKeys; i++)
 				{
-					CVec3 Pos = Sampler.Track->KeyPos[i];
+					CVec3 Pos = Sampler.Track.KeyPos[i];
 					TransformPosition(Pos);
 					DataBuf.Put(Pos);
 				}
@@ -784,10 +933,10 @@ static void ExportAnimations(GLTFExportContext& Context, FArchive& Ar)
 			else
 			{
 				// Rotation track
-				DataBuf.Setup(NumKeys, "VEC4", BufferData::FLOAT, sizeof(CQuat));
+				Context.SetupBuffer(DataBuf, NumKeys, "VEC4", BufferData::FLOAT, sizeof(CQuat));
 				for (int i = 0; i < NumKeys; i++)
 				{
-					CQuat Rot = Sampler.Track->KeyQuat[i];
+					CQuat Rot = Sampler.Track.KeyQuat[i];
 					TransformRotation(Rot);
 					if (Sampler.BoneNodeIndex - FIRST_BONE_NODE == 0)
 					{
@@ -816,10 +965,39 @@ static void ExportAnimations(GLTFExportContext& Context, FArchive& Ar)
 	unguard;
 }
 
-static void ExportMeshLod(GLTFExportContext& Context, const CBaseMeshLod& Lod, const CMeshVertex* Verts, FArchive& Ar, FArchive& Ar2)
+// Compute size of binary data for mesh. Animations are reserved separately.
+static int GetMeshBinarySize(const GLTFExportContext& Context, const CBaseMeshLod& Lod)
+{
+	int VertexSize = sizeof(CVec3) * 2 + sizeof(CVec4) + sizeof(CMeshUVFloat) * Lod.NumTexCoords;
+	if (Lod.VertexColors)
+	{
+		VertexSize += 4;
+	}
+	int Size = 0;
+	if (Context.IsSkeletal())
+	{
+		VertexSize += sizeof(uint16) * 4 + sizeof(uint32);
+		Size += Context.SkelMesh->RefSkeleton.Num() * sizeof(CMat4);
+	}
+	for (int i = 0; i < Context.Sections.Num(); i++)
+	{
+		const SectionRemap& R = Context.Sections[i];
+		int IndexSize = (R.NumVerts <= 65536) ? sizeof(uint16) : sizeof(uint32);
+		Size += Align(R.NumIndices * IndexSize, 4) + R.NumVerts * VertexSize;
+	}
+	return Size;
+}
+
+static void ExportMeshLod(GLTFExportContext& Context, const CBaseMeshLod& Lod, const CMeshVertex* Verts, FArchive& Ar0)
 {
 	guard(ExportMeshLod);
 
+	GLTFJsonWriter Ar;
+
+	// Prepare section data and allocate binary data for the mesh
+	RemapSections(Context, Lod);
+	Context.ReserveBinary(GetMeshBinarySize(Context, Lod));
+
 	// Opening brace
 	Ar.Printf("{\n");
 
@@ -892,27 +1070,37 @@ static void ExportMeshLod(GLTFExportContext& Context, const CBaseMeshLod& Lod, c
 	}
 
 	// Write buffers
-	int bufferLength = 0;
-	for (int i = 0; i < Context.Data.Num(); i++)
+	int bufferLength = Context.BinSize;
+
+	if (Context.bBinary)
 	{
-		bufferLength += Context.Data[i].DataSize;
+		// glb: the buffer is stored in BIN chunk of the same file
+		Ar.Printf(
+			"  \"buffers\" : [\n"
+			"    {\n"
+			"      \"byteLength\" : %d\n"
+			"    }\n"
+			"  ],\n",
+			bufferLength
+		);
+	}
+	else
+	{
+		Ar.Printf(
+			"  \"buffers\" : [\n"
+			"    {\n"
+			"      \"uri\" : \"%s.bin\",\n"
+			"      \"byteLength\" : %d\n"
+			"    }\n"
+			"  ],\n",
+			Context.MeshName, bufferLength
+		);
 	}
-
-	Ar.Printf(
-		"  \"buffers\" : [\n"
-		"    {\n"
-		"      \"uri\" : \"%s.bin\",\n"
-		"      \"byteLength\" : %d\n"
-		"    }\n"
-		"  ],\n",
-		Context.MeshName, bufferLength
-	);
 
 	// Write bufferViews
 	Ar.Printf(
 		"  \"bufferViews\" : [\n"
 	);
-	int bufferOffset = 0;
 	for (int i = 0; i < Context.Data.Num(); i++)
 	{
 		const BufferData& B = Context.Data[i];
@@ -922,11 +1110,10 @@ static void ExportMeshLod(GLTFExportContext& Context, const CBaseMeshLod& Lod, c
 			"      \"byteOffset\" : %d,\n"
 			"      \"byteLength\" : %d\n"
 			"    }%s\n",
-			bufferOffset,
+			B.Offset,
 			B.DataSize,
 			i == (Context.Data.Num()-1) ? "" : ","
 		);
-		bufferOffset += B.DataSize;
 	}
 	Ar.Printf(
 		"  ],\n"
@@ -939,6 +1126,9 @@ static void ExportMeshLod(GLTFExportContext& Context, const CBaseMeshLod& Lod, c
 	for (int i = 0; i < Context.Data.Num(); i++)
 	{
 		const BufferData& B = Context.Data[i];
+#if MAX_DEBUG
+		assert(B.FillCount == B.Count);
+#endif
 		Ar.Printf(
 			"    {\n"
 			"      \"bufferView\" : %d,\n",
@@ -971,25 +1161,54 @@ static void ExportMeshLod(GLTFExportContext& Context, const CBaseMeshLod& Lod, c
 		"  ]\n"
 	);
 
-	// Write binary data
-	guard(WriteBIN);
-	for (int i = 0; i < Context.Data.Num(); i++)
-	{
-		const BufferData& B = Context.Data[i];
-#if MAX_DEBUG
-		assert(B.FillCount == B.Count);
-#endif
-		Ar2.Serialize(B.Data, B.DataSize);
-	}
-	unguard;
-
 	// Closing brace
 	Ar.Printf("}\n");
 
+	if (Context.bBinary)
+	{
+		guard(WriteGLB);
+		// glb layout: header, json chunk padded with spaces, binary chunk. All chunks are aligned by 4.
+		// Buffer sizes are already aligned, so BIN chunk doesn't need padding.
+		assert((Context.BinSize & 3) == 0);
+		while (Ar.Size & 3)
+		{
+			Ar.Printf(" ");
+		}
+		uint32 Header[5];
+		Header[0] = BYTES4('g','l','T','F');
+		Header[1] = 2;							// version
+		Header[2] = 12 + 8 + Ar.Size + 8 + Context.BinSize; // file size
+		Header[3] = Ar.Size;					// json chunk
+		Header[4] = BYTES4('J','S','O','N');
+		for (int i = 0; i < ARRAY_COUNT(Header); i++)
+		{
+			Ar0 << Header[i];
+		}
+		Ar0.Serialize(Ar.Data, Ar.Size);
+		uint32 BinHeader[2];
+		BinHeader[0] = Context.BinSize;
+		BinHeader[1] = BYTES4('B','I','N',0);
+		Ar0 << BinHeader[0] << BinHeader[1];
+		Ar0.Serialize(Context.BinData, Context.BinSize);
+		unguard;
+	}
+	else
+	{
+		Ar0.Serialize(Ar.Data, Ar.Size);
+
+		// Write binary data
+		guard(WriteBIN);
+		FArchive* Ar2 = CreateExportArchive(Context.GetOriginalMesh(), EFileArchiveOptions::Default, "%s.bin", Context.MeshName);
+		assert(Ar2);
+		Ar2->Serialize(Context.BinData, Context.BinSize);
+		delete Ar2;
+		unguard;
+	}
+
 	unguard;
 }
 
-void ExportSkeletalMeshGLTF(const CSkeletalMesh* Mesh)
+void ExportSkeletalMeshGLTF(const CSkeletalMesh* Mesh, bool bBinary)
 {
 	guard(ExportSkeletalMeshGLTF);
 
@@ -1012,25 +1231,25 @@ void ExportSkeletalMeshGLTF(const CSkeletalMesh* Mesh)
 		char meshName[256];
 		appSprintf(ARRAY_ARG(meshName), "%s%s", OriginalMesh->Name, suffix);
 
-		FArchive* Ar = CreateExportArchive(OriginalMesh, EFileArchiveOptions::TextFile, "%s.gltf", meshName);
+		FArchive* Ar = bBinary
+			? CreateExportArchive(OriginalMesh, EFileArchiveOptions::Default, "%s.glb", meshName)
+			: CreateExportArchive(OriginalMesh, EFileArchiveOptions::TextFile, "%s.gltf", meshName);
 		if (Ar)
 		{
 			GLTFExportContext Context;
 			Context.MeshName = meshName;
 			Context.SkelMesh = Mesh;
+			Context.bBinary = bBinary;
 
-			FArchive* Ar2 = CreateExportArchive(OriginalMesh, EFileArchiveOptions::Default, "%s.bin", meshName);
-			assert(Ar2);
-			ExportMeshLod(Context, Mesh->Lods[Lod], Mesh->Lods[Lod].Verts, *Ar, *Ar2);
+			ExportMeshLod(Context, Mesh->Lods[Lod], Mesh->Lods[Lod].Verts, *Ar);
 			delete Ar;
-			delete Ar2;
 		}
 	}
 
 	unguard;
 }
 
-void ExportStaticMeshGLTF(const CStaticMesh* Mesh)
+void ExportStaticMeshGLTF(const CStaticMesh* Mesh, bool bBinary)
 {
 	guard(ExportStaticMeshGLTF);
 
@@ -1053,18 +1272,18 @@ void ExportStaticMeshGLTF(const CStaticMesh* Mesh)
 		char meshName[256];
 		appSprintf(ARRAY_ARG(meshName), "%s%s", OriginalMesh->Name, suffix);
 
-		FArchive* Ar = CreateExportArchive(OriginalMesh, EFileArchiveOptions::TextFile, "%s.gltf", meshName);
+		FArchive* Ar = bBinary
+			? CreateExportArchive(OriginalMesh, EFileArchiveOptions::Default, "%s.glb", meshName)
+			: CreateExportArchive(OriginalMesh, EFileArchiveOptions::TextFile, "%s.gltf", meshName);
 		if (Ar)
 		{
 			GLTFExportContext Context;
 			Context.MeshName = meshName;
 			Context.StatMesh = Mesh;
+			Context.bBinary = bBinary;
 
-			FArchive* Ar2 = CreateExportArchive(OriginalMesh, EFileArchiveOptions::Default, "%s.bin", meshName);
-			assert(Ar2);
-			ExportMeshLod(Context, Mesh->Lods[Lod], Mesh->Lods[Lod].Verts, *Ar, *Ar2);
+			ExportMeshLod(Context, Mesh->Lods[Lod], Mesh->Lods[Lod].Verts, *Ar);
 			delete Ar;
-			delete Ar2;
 		}
 	}
 
@@ -364,7 +364,7 @@ void ExportMd5Anim(const CAnimSet *Anim)
 			{
 				CVec3 BP;
 				CQuat BO;
-				S.Tracks[b]->GetBonePosition(t, S.NumFrames, false, BP, BO);
+				S.GetTrack(b).GetBonePosition(t, S.NumFrames, false, BP, BO);
 				if (!b) BO.Conjugate();			// root bone
 #if MIRROR_MESH
 				BO.Y  *= -1;
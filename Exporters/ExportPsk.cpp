@@ -118,22 +118,24 @@ static void ExportCommonMeshData
 	// get number of faces (some Gears3 meshes may have index buffer larger than needed)
 	// get wedge-material mapping
 	int numFaces = 0;
-	CIndexBuffer::IndexAccessor_t Index = Indices.GetAccessor();
 
 	guard(Wedges);
 	TArray<int> WedgeMat;
 	WedgeMat.Empty(NumVerts);
 	WedgeMat.AddZeroed(NumVerts);
-	for (i = 0; i < NumSections; i++)
+	Indices.ForEach16or32([&](const auto* Index)
 	{
-		const CMeshSection &Sec = *SECT(i);
-		numFaces += Sec.NumFaces;
-		for (int j = 0; j < Sec.NumFaces * 3; j++)
+		for (int i = 0; i < NumSections; i++)
 		{
-			int idx = Index(j + Sec.FirstIndex);
-			WedgeMat[idx] = i;
+			const CMeshSection &Sec = *SECT(i);
+			numFaces += Sec.NumFaces;
+			for (int j = 0; j < Sec.NumFaces * 3; j++)
+			{
+				int idx = Index[j + Sec.FirstIndex];
+				WedgeMat[idx] = i;
+			}
 		}
-	}
+	});
 
 	WedgHdr.DataCount = NumVerts;
 	WedgHdr.DataSize  = sizeof(VVertex);
@@ -165,34 +167,37 @@ static void ExportCommonMeshData
 		FacesHdr.DataCount = numFaces;
 		FacesHdr.DataSize  = sizeof(VTriangle16);
 		SAVE_CHUNK(FacesHdr, "FACE0000");
-		for (i = 0; i < NumSections; i++)
+		Indices.ForEach16or32([&](const auto* Index)
 		{
-			const CMeshSection &Sec = *SECT(i);
-			for (int j = 0; j < Sec.NumFaces; j++)
+			for (int i = 0; i < NumSections; i++)
 			{
-				VTriangle16 T;
-				for (int k = 0; k < 3; k++)
+				const CMeshSection &Sec = *SECT(i);
+				for (int j = 0; j < Sec.NumFaces; j++)
 				{
-					int idx = Index(Sec.FirstIndex + j * 3 + k);
-					assert((idx & ~0xFFFF) == 0); // (idx >= 0 && idx < 65536);
-					T.WedgeIndex[k] = idx;
-				}
-				T.MatIndex        = i;
-				T.AuxMatIndex     = 0;
-				T.SmoothingGroups = 1;
+					VTriangle16 T;
+					for (int k = 0; k < 3; k++)
+					{
+						int idx = Index[Sec.FirstIndex + j * 3 + k];
+						assert((idx & ~0xFFFF) == 0); // (idx >= 0 && idx < 65536);
+						T.WedgeIndex[k] = idx;
+					}
+					T.MatIndex        = i;
+					T.AuxMatIndex     = 0;
+					T.SmoothingGroups = 1;
 #if MIRROR_MESH
-				Exchange(T.WedgeIndex[0], T.WedgeIndex[1]);
+					Exchange(T.WedgeIndex[0], T.WedgeIndex[1]);
 #endif
-				if (sizeof(VTriangle16) == 12)
-				{
-					Ar.Serialize(&T, sizeof(T));
-				}
-				else
-				{
-					Ar << T;
+					if (sizeof(VTriangle16) == 12)
+					{
+						Ar.Serialize(&T, sizeof(T));
+					}
+					else
+					{
+						Ar << T;
+					}
 				}
 			}
-		}
+		});
 	}
 	else
 	{
@@ -200,27 +205,30 @@ static void ExportCommonMeshData
 		FacesHdr.DataCount = numFaces;
 		FacesHdr.DataSize  = 18; // sizeof(VTriangle32) without alignment
 		SAVE_CHUNK(FacesHdr, "FACE3200");
-		for (i = 0; i < NumSections; i++)
+		Indices.ForEach16or32([&](const auto* Index)
 		{
-			const CMeshSection &Sec = *SECT(i);
-			for (int j = 0; j < Sec.NumFaces; j++)
+			for (int i = 0; i < NumSections; i++)
 			{
-				VTriangle32 T;
-				for (int k = 0; k < 3; k++)
+				const CMeshSection &Sec = *SECT(i);
+				for (int j = 0; j < Sec.NumFaces; j++)
 				{
-					int idx = Index(Sec.FirstIndex + j * 3 + k);
-					T.WedgeIndex[k] = idx;
-				}
-				T.MatIndex        = i;
-				T.AuxMatIndex     = 0;
-				T.SmoothingGroups = 1;
+					VTriangle32 T;
+					for (int k = 0; k < 3; k++)
+					{
+						int idx = Index[Sec.FirstIndex + j * 3 + k];
+						T.WedgeIndex[k] = idx;
+					}
+					T.MatIndex        = i;
+					T.AuxMatIndex     = 0;
+					T.SmoothingGroups = 1;
 #if MIRROR_MESH
-				Exchange(T.WedgeIndex[0], T.WedgeIndex[1]);
+					Exchange(T.WedgeIndex[0], T.WedgeIndex[1]);
 #endif
-				// This structure is not packed, can't use single serialize call for it
-				Ar << T;
+					// This structure is not packed, can't use single serialize call for it
+					Ar << T;
+				}
 			}
-		}
+		});
 	}
 	unguard;
 
@@ -339,20 +347,22 @@ static void ExportSkeletalMeshLod(const CSkeletalMesh &Mesh, const CSkelMeshLod
 	// normal, but belongs to different bones.
 //	appResetProfiler();
 	guard(WeldVerts);
-	Share.Prepare(Lod.Verts, Lod.NumVerts, sizeof(CSkelMeshVertex));
-	for (i = 0; i < Lod.NumVerts; i++)
-	{
-		const CSkelMeshVertex &S = Lod.Verts[i];
-		// Here we relies on high possibility that vertices which should be shared between
-		// triangles will have the same order of weights and bones (because most likely
-		// these vertices were duplicated by copying). Doing more complicated comparison
-		// will reduce performance with possibly reducing size of exported mesh by a few
-		// more vertices.
-		uint32 WeightsHash = S.PackedWeights;
-		for (j = 0; j < ARRAY_COUNT(S.Bone); j++)
-			WeightsHash ^= S.Bone[j] << j;
-		Share.AddVertex(S.Position, S.Normal, WeightsHash);
-	}
+	Share.Prepare(Lod.NumVerts);
+	Share.AddVertices(Lod.NumVerts, [&Lod](int Index, CVec3& Pos, CPackedNormal& Normal, uint32& ExtraInfo)
+		{
+			const CSkelMeshVertex &S = Lod.Verts[Index];
+			// Here we relies on high possibility that vertices which should be shared between
+			// triangles will have the same order of weights and bones (because most likely
+			// these vertices were duplicated by copying). Doing more complicated comparison
+			// will reduce performance with possibly reducing size of exported mesh by a few
+			// more vertices.
+			uint32 WeightsHash = S.PackedWeights;
+			for (int j = 0; j < ARRAY_COUNT(S.Bone); j++)
+				WeightsHash ^= S.Bone[j] << j;
+			Pos = S.Position;
+			Normal = S.Normal;
+			ExtraInfo = WeightsHash;
+		});
 	unguard;
 //	appPrintProfiler();
 //	appPrintf("%d wedges were welded into %d verts\n", Lod.NumVerts, Share.Points.Num());
@@ -641,10 +651,11 @@ static void DoExportPsa(const CAnimSet* Anim, const UObject* OriginalAnim)
 				VQuatAnimKey K;
 				CVec3 BP;
 				CQuat BO;
+				const CAnimTrackView Track = S.GetTrack(b);
 
 				BP.Set(0, 0, 0);			// GetBonePosition() will not alter BP and BO when animation tracks are not exists
 				BO.Set(0, 0, 0, 1);
-				S.Tracks[b]->GetBonePosition(t, S.NumFrames, false, BP, BO);
+				Track.GetBonePosition(t, S.NumFrames, false, BP, BO);
 
 				K.Position    = (FVector&) BP;
 				K.Orientation = (FQuat&)   BO;
@@ -667,7 +678,7 @@ static void DoExportPsa(const CAnimSet* Anim, const UObject* OriginalAnim)
 				keysCount--;
 
 				// check for user error
-				if ((S.Tracks[b]->KeyPos.Num() == 0) || (S.Tracks[b]->KeyQuat.Num() == 0))
+				if ((Track.KeyPos.Num() == 0) || (Track.KeyQuat.Num() == 0))
 					requireConfig = true;
 			}
 		}
@@ -755,9 +766,10 @@ static void DoExportPsa(const CAnimSet* Anim, const UObject* OriginalAnim)
 #define FLAG_NO_ROTATION		2
 					static const char *FlagInfo[] = { "", "trans", "rot", "all" };
 					int flag = 0;
-					if (S.Tracks[b]->KeyPos.Num() == 0)
+					const CAnimTrackView Track = S.GetTrack(b);
+					if (Track.KeyPos.Num() == 0)
 						flag |= FLAG_NO_TRANSLATION;
-					if (S.Tracks[b]->KeyQuat.Num() == 0)
+					if (Track.KeyQuat.Num() == 0)
 						flag |= FLAG_NO_ROTATION;
 					if (flag)
 						Ar1->Printf("%s.%d=%s\n", *S.Name, b, FlagInfo[flag]);
@@ -855,12 +867,13 @@ static void ExportStaticMeshLod(const CStaticMeshLod &Lod, FArchive &Ar)
 	// weld vertices
 //	appResetProfiler();
 	guard(WeldVerts);
-	Share.Prepare(Lod.Verts, Lod.NumVerts, sizeof(CStaticMeshVertex));
-	for (int i = 0; i < Lod.NumVerts; i++)
-	{
-		const CMeshVertex &S = Lod.Verts[i];
-		Share.AddVertex(S.Position, S.Normal);
-	}
+	Share.Prepare(Lod.NumVerts);
+	Share.AddVertices(Lod.NumVerts, [&Lod](int Index, CVec3& Pos, CPackedNormal& Normal, uint32& ExtraInfo)
+		{
+			const CMeshVertex &S = Lod.Verts[Index];
+			Pos = S.Position;
+			Normal = S.Normal;
+		});
 	unguard;
 //	appPrintProfiler();
 //	appPrintf("%d wedges were welded into %d verts\n", Lod.NumVerts, Share.Points.Num());
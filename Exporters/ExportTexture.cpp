@@ -13,8 +13,17 @@
 
 #include "Parallel.h"
 
+// UnrealEd for UE2 has a bug with importing TGA_TOPLEFT images, it simply ignores orientation flags,
+// so save images bottom-up
 #define TGA_SAVE_BOTTOMLEFT	1
 
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#	define TGA_USE_SSE2		1
+#	include <emmintrin.h>
+#else
+#	define TGA_USE_SSE2		0
+#endif
+
 
 #define TGA_ORIGIN_MASK		0x30
 #define TGA_BOTLEFT			0x00
@@ -42,153 +51,222 @@ struct GCC_PACK tgaHdr_t
 
 
 bool GNoTgaCompress = false;
+bool GExportTGA = false;
 bool GExportPNG = false;
+bool GExportHDR = false;
+int  GPngCompression = PNG_COMPRESS_DEFAULT;
 bool GExportDDS = false;
 
 //?? place this function outside (cannot place to Core - using FArchive)
 
-void WriteTGA(FArchive &Ar, int width, int height, byte *pic)
+// Find the first bit with specified value in [i, end) range, returns 'end' if not found
+static int FindTGAMaskBit(const uint32* Mask, int i, int end, bool value)
 {
-	guard(WriteTGA);
-
-	int		i;
-
-	byte *src;
-	int size = width * height;
-	// convert RGB to BGR (inplace!)
-	for (i = 0, src = pic; i < size; i++, src += 4)
-		Exchange(src[0], src[2]);
-
-	// check for 24 bit image possibility
-	int colorBytes = 3;
-	for (i = 0, src = pic + 3; i < size; i++, src += 4)
-		if (src[0] != 255)									// src initialized with offset 3
+	while (i < end)
+	{
+		uint32 w = Mask[i >> 5];
+		if (!value) w = ~w;
+		w >>= (i & 31);
+		if (w)
 		{
-			colorBytes = 4;
-			break;
+			// find the lowest set bit
+#if _MSC_VER
+			unsigned long bit;
+			_BitScanForward(&bit, w);
+#else
+			int bit = __builtin_ctz(w);
+#endif
+			return min(i + (int)bit, end);
 		}
+		i = (i | 31) + 1;
+	}
+	return end;
+}
 
-	byte *packed = (byte*)appMalloc(width * height * colorBytes + 4); // +4 for being able to put uint32 even when 3 bytes needed
-	byte *threshold = packed + width * height * colorBytes - 16; // threshold for "dst"
+// Walk over TGA RLE packets of a single row. SameMask has bit set for every pixel which is equal to the
+// next one. Packets never cross row boundary, and contain up to 128 pixels. Func is called as
+// Func(bool bRun, int FirstPixel, int NumPixels).
+template<typename F>
+static void ForEachTGAPacket(const uint32* SameMask, int width, F&& Func)
+{
+	int i = 0;
+	while (i < width)
+	{
+		int n;
+		if ((SameMask[i >> 5] >> (i & 31)) & 1)
+		{
+			// run of equal pixels, the last pixel of the run has bit cleared
+			n = FindTGAMaskBit(SameMask, i, min(i + 127, width), false) - i + 1;
+			Func(true, i, n);
+		}
+		else
+		{
+			// raw pixels, up to the next run
+			n = FindTGAMaskBit(SameMask, i + 1, min(i + 128, width), true) - i;
+			Func(false, i, n);
+		}
+		i += n;
+	}
+}
 
-	src = pic;
-	byte *dst = packed;
-	int column = 0;
-	byte *flag = NULL;
-	bool rle = false;
+// Compute SameMask for the row (see ForEachTGAPacket), and accumulate alpha channel with AND. SameMask
+// could be NULL when RLE compression is not used.
+static void AnalyzeTGARow(const uint32* src, int width, uint32* SameMask, uint32& AlphaAnd)
+{
+	if (SameMask) memset(SameMask, 0, ((width + 31) >> 5) * sizeof(uint32));
+	int i = 0;
+	uint32 Alpha = AlphaAnd;
+#if TGA_USE_SSE2
+	__m128i AlphaV = _mm_set1_epi32(Alpha);
+	for ( ; i + 4 < width; i += 4)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(src + i + 1));
+		AlphaV = _mm_and_si128(AlphaV, a);
+		if (!SameMask) continue;
+		uint32 Bits = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, b)));
+		SameMask[i >> 5] |= Bits << (i & 31);			// 'i' is multiple of 4, so bits never cross uint32 boundary
+	}
+	AlphaV = _mm_and_si128(AlphaV, _mm_srli_si128(AlphaV, 8));
+	AlphaV = _mm_and_si128(AlphaV, _mm_srli_si128(AlphaV, 4));
+	Alpha = _mm_cvtsi128_si32(AlphaV);
+#endif // TGA_USE_SSE2
+	for ( ; i < width; i++)
+	{
+		Alpha &= src[i];
+		if (SameMask && i < width - 1 && src[i] == src[i + 1])
+			SameMask[i >> 5] |= 1u << (i & 31);
+	}
+	AlphaAnd = Alpha;
+}
 
-	bool useCompression = true;
-	if (GNoTgaCompress)
-		threshold = dst;									// will break compression loop immediately
+// Convert RGBA row to BGRA
+static void SwizzleTGARow(const uint32* src, int width, uint32* dst)
+{
+	int i = 0;
+#if TGA_USE_SSE2
+	__m128i MaskAG = _mm_set1_epi32(0xFF00FF00);
+	__m128i MaskB = _mm_set1_epi32(0x000000FF);
+	for ( ; i + 4 <= width; i += 4)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+		__m128i r = _mm_or_si128(_mm_and_si128(x, MaskAG),
+			_mm_or_si128(_mm_and_si128(_mm_srli_epi32(x, 16), MaskB), _mm_slli_epi32(_mm_and_si128(x, MaskB), 16)));
+		_mm_storeu_si128((__m128i*)(dst + i), r);
+	}
+#endif // TGA_USE_SSE2
+	for ( ; i < width; i++)
+	{
+		uint32 x = src[i];
+		dst[i] = (x & 0xFF00FF00) | ((x >> 16) & 0xFF) | ((x & 0xFF) << 16);
+	}
+}
 
-	for (i = 0; i < size; i++)
+// Copy BGRA pixels to 'dst' using 3 or 4 bytes per pixel. Note: 3-byte copy writes one extra byte after
+// the end of data.
+static FORCEINLINE byte* PackTGAPixels(const uint32* src, int count, int colorBytes, byte* dst)
+{
+	if (count == 1)
 	{
-		if (dst >= threshold)								// when compressed is too large, same uncompressed
-		{
-			useCompression = false;
-			break;
-		}
+		*(uint32*)dst = *src;
+		return dst + colorBytes;
+	}
+	if (colorBytes == 4)
+	{
+		memcpy(dst, src, count * 4);
+		return dst + count * 4;
+	}
+	for (int i = 0; i < count; i++, dst += 3)
+		*(uint32*)dst = src[i];
+	return dst;
+}
 
-		uint32 pix = *(uint32*)src;
-		src += 4;
+void WriteTGA(FArchive &Ar, int width, int height, const byte *pic, bool bottomUp)
+{
+	guard(WriteTGA);
+
+	const uint32* src = (const uint32*)pic;
+	int size = width * height;
 
-		if (column < width - 1 &&							// not on screen edge; NOTE: when i == size-1, col==width-1
-			pix == *(uint32*)src &&							// next pixel will be the same
-			!(rle && flag && *flag == 254))					// flag overflow
+	// Analyze the image: check for 24 bit image possibility, find runs of equal pixels and compute size of
+	// RLE-compressed data
+	int MaskWords = (width + 31) >> 5;
+	uint32* SameMasks = NULL;
+	if (!GNoTgaCompress)
+		SameMasks = (uint32*)appMallocNoInit(MaskWords * height * sizeof(uint32));
+	uint32 AlphaAnd = 0xFFFFFFFF;
+	int NumPackets = 0, NumStoredPixels = 0;
+	for (int row = 0; row < height; row++)
+	{
+		if (!SameMasks)
 		{
-			if (!rle || !flag)
-			{
-				// starting new RLE sequence
-				flag = dst++;
-				*flag = 128 - 1;							// will be incremented below
-				*(uint32*)dst = pix;						// store RGBA
-				dst += colorBytes;							// increment dst by 3 or 4 bytes
-			}
-			(*flag)++;										// enqueue one more texel
-			rle = true;
+			AnalyzeTGARow(src + row * width, width, NULL, AlphaAnd);
+			continue;
 		}
-		else
-		{
-			if (rle)
+		uint32* Mask = SameMasks + row * MaskWords;
+		AnalyzeTGARow(src + row * width, width, Mask, AlphaAnd);
+		ForEachTGAPacket(Mask, width, [&NumPackets, &NumStoredPixels](bool bRun, int /*First*/, int Count)
 			{
-				// previous block was RLE, and next (now: current) byte was
-				// the same - enqueue it to previous block and close block
-				(*flag)++;
-				flag = NULL;
-			}
-			else
-			{
-				if (column == 0)							// check for screen edge
-					flag = NULL;
-				if (!flag)
-				{
-					// start new copy sequence
-					flag = dst++;
-					*flag = 255;
-				}
-				*(uint32*)dst = pix;						// store RGBA
-				dst += colorBytes;							// increment dst by 3 or 4 bytes
-				(*flag)++;
-				if (*flag == 127) flag = NULL;				// check for overflow
-			}
-			rle = false;
-		}
-
-		if (++column == width) column = 0;
+				NumPackets++;
+				NumStoredPixels += bRun ? 1 : Count;
+			});
 	}
+	int colorBytes = ((AlphaAnd >> 24) == 255) ? 3 : 4;
+
+	// When compressed is too large, save uncompressed
+	bool useCompression = SameMasks && (NumPackets + NumStoredPixels * colorBytes < size * colorBytes - 16);
 
 	// write header
 	tgaHdr_t header;
 	memset(&header, 0, sizeof(header));
 	header.width  = width;
 	header.height = height;
-#if 0
-	// debug: write black/white image
-	header.pixel_size = 8;
-	header.image_type = 3;
-	fwrite(&header, 1, sizeof(header), f);
-	for (i = 0; i < width * height; i++, pic += 4)
-	{
-		int c = (pic[0]+pic[1]+pic[2]) / 3;
-		fwrite(&c, 1, 1, f);
-	}
-#else
 	header.pixel_size = colorBytes * 8;
 #if TGA_SAVE_BOTTOMLEFT
 	header.attributes = TGA_BOTLEFT;
+	bool flipRows = !bottomUp;
 #else
-	header.attributes = TGA_TOPLEFT;
+	header.attributes = bottomUp ? TGA_BOTLEFT : TGA_TOPLEFT;
+	bool flipRows = false;
 #endif
-	if (useCompression)
-	{
-		header.image_type = 10;		// RLE
-		// write data
-		Ar.Serialize(&header, sizeof(header));
-		Ar.Serialize(packed, dst - packed);
-	}
-	else
+	header.image_type = useCompression ? 10 : 2;		// RLE or uncompressed
+	Ar.Serialize(&header, sizeof(header));
+
+	// Convert and write data row by row. Worst case for RLE row is 1 extra byte per pixel; +4 is for
+	// being able to put uint32 even when 3 bytes needed.
+	uint32* swizzled = (uint32*)appMallocNoInit(width * sizeof(uint32));
+	byte* packed = (byte*)appMallocNoInit(width * (colorBytes + 1) + 4);
+
+	for (int i = 0; i < height; i++)
 	{
-		header.image_type = 2;		// uncompressed
-		// convert to 24 bits image, when needed
-		if (colorBytes == 3)
+		int row = flipRows ? height - 1 - i : i;
+		byte* dst = packed;
+		if (!useCompression && colorBytes == 4)
 		{
-			// Use uint32 for faster data moving
-			dst = pic;
-			uint32* src = (uint32*)pic;
-			for (i = 0; i < size; i++)
-			{
-				uint32 pix = *src++;
-				*((uint32*)dst) = pix;
-				dst += 3;	// increment 'dst' only by 3
-			}
+			// nothing to pack, write swizzled data directly
+			SwizzleTGARow(src + row * width, width, (uint32*)packed);
+			Ar.Serialize(packed, width * 4);
+			continue;
 		}
-		// write data
-		Ar.Serialize(&header, sizeof(header));
-		Ar.Serialize(pic, size * colorBytes);
+		SwizzleTGARow(src + row * width, width, swizzled);
+		if (useCompression)
+		{
+			ForEachTGAPacket(SameMasks + row * MaskWords, width, [swizzled, colorBytes, &dst](bool bRun, int First, int Count)
+				{
+					*dst++ = (bRun ? 128 : 0) + Count - 1;
+					dst = PackTGAPixels(swizzled + First, bRun ? 1 : Count, colorBytes, dst);
+				});
+		}
+		else
+		{
+			dst = PackTGAPixels(swizzled, width, colorBytes, dst);
+		}
+		Ar.Serialize(packed, dst - packed);
 	}
-#endif
 
 	appFree(packed);
+	appFree(swizzled);
+	if (SameMasks) appFree(SameMasks);
 
 	unguard;
 }
@@ -216,24 +294,36 @@ static void float2rgbe(float red, float green, float blue, byte* rgbe)
 	}
 }
 
-static void WriteHDR(FArchive &Ar, int width, int height, byte *pic)
+// Write image in float RGBA format, or in RGBA8 when 'isFloat' is false. The image data is not modified.
+static void WriteHDR(FArchive &Ar, int width, int height, const byte *pic, bool isFloat)
 {
 	guard(WriteHDR);
 
 	char hdr[64];
 	appSprintf(ARRAY_ARG(hdr), "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y %d +X %d\n", height, width);
+	Ar.Serialize(hdr, strlen(hdr));
 
 	//!! TODO: compress HDR file (seems have RLE support)
-	// Convert float[w*h*4] to rgbe[w*h] inplace
-	const float* floatSrc = (float*)pic;
-	byte* byteDst = pic;
-	for (int p = 0; p < width * height; p++, floatSrc += 4, byteDst += 4)
+	// Convert float[w*h*4] to rgbe[w*h] row by row
+	byte* row = (byte*)appMallocNoInit(width * 4);
+	for (int y = 0; y < height; y++)
 	{
-		float2rgbe(floatSrc[0], floatSrc[1], floatSrc[2], byteDst);
+		byte* byteDst = row;
+		if (isFloat)
+		{
+			const float* floatSrc = (const float*)pic + y * width * 4;
+			for (int x = 0; x < width; x++, floatSrc += 4, byteDst += 4)
+				float2rgbe(floatSrc[0], floatSrc[1], floatSrc[2], byteDst);
+		}
+		else
+		{
+			const byte* src = pic + y * width * 4;
+			for (int x = 0; x < width; x++, src += 4, byteDst += 4)
+				float2rgbe(src[0] / 255.0f, src[1] / 255.0f, src[2] / 255.0f, byteDst);
+		}
+		Ar.Serialize(row, width * 4);
 	}
-
-	Ar.Serialize(hdr, strlen(hdr));
-	Ar.Serialize(pic, width * height * 4);
+	appFree(row);
 
 	unguard;
 }
@@ -279,53 +369,141 @@ static void WriteDDS(FArchive& Ar, const CTextureData& TexData, int Slice)
 	unguard;
 }
 
-static void ExportDDS_Worker(FArchive& Ar, CTextureData& TexData, byte* /*pic*/, int Slice)
+static void ExportDDS_Worker(FArchive& Ar, const CTextureData& TexData, const byte* /*pic*/, int Slice)
 {
 	WriteDDS(Ar, TexData, Slice);
 }
 
-static void ExportHDR_Worker(FArchive& Ar, CTextureData& TexData, byte* pic, int /*Slice*/)
+static void ExportHDR_Worker(FArchive& Ar, const CTextureData& TexData, const byte* pic, int /*Slice*/)
 {
-	WriteHDR(Ar, TexData.Mips[0].USize, TexData.Mips[0].VSize, pic);
+	WriteHDR(Ar, TexData.Mips[0].USize, TexData.Mips[0].VSize, pic, PixelFormatInfo[TexData.Format].Float);
 }
 
-static void ExportPNG_Worker(FArchive& Ar, CTextureData& TexData, byte* pic, int /*Slice*/)
+// PNG compression benchmark (-bench=png)
+bool GBenchmarkPNG = false;
+
+static const char* PngPresetNames[] = { "default", "fast", "store", "best" };
+
+static struct
 {
-	TArray<byte> Data;
-	CompressPNG(pic, TexData.Mips[0].USize, TexData.Mips[0].VSize, Data);
-	Ar.Serialize(Data.GetData(), Data.Num());
+	int64		Size[ARRAY_COUNT(PngPresetNames)];
+	int64		Time[ARRAY_COUNT(PngPresetNames)];
+	int64		NumPixels;
+	int			NumImages;
+	int			NumErrors;
+} GPngStats;
+
+// Compress the image with all compression presets, accumulate size and time, and verify that every
+// compressed image is decoded back without changes
+static void BenchmarkPNG(const char* Name, const byte* pic, int width, int height)
+{
+	guard(BenchmarkPNG);
+
+#if THREADING
+	// Textures are exported in parallel, process one image at time for stable timings
+	static CMutex Mutex;
+	CMutex::ScopedLock Lock(Mutex);
+#endif
+
+	GPngStats.NumPixels += (int64)width * height;
+	GPngStats.NumImages++;
+	byte* Check = (byte*)appMallocNoInit(width * height * 4);
+	for (int Preset = 0; Preset < ARRAY_COUNT(PngPresetNames); Preset++)
+	{
+		TArray<byte> Data;
+		int StartTime = appMilliseconds();
+		CompressPNG(pic, width, height, Data, (EPngCompression)Preset);
+		GPngStats.Time[Preset] += appMilliseconds() - StartTime;
+		GPngStats.Size[Preset] += Data.Num();
+
+		// Color type from IHDR chunk: alpha channel is not stored when it has no information
+		bool bHasAlpha = (Data.Num() > 25 && Data[25] == 6);
+		bool bValid = UncompressPNG(Data.GetData(), Data.Num(), width, height, Check, false);
+		for (int i = 0; bValid && i < width * height; i++)
+		{
+			const byte* s = pic + i * 4;
+			const byte* d = Check + i * 4;
+			if (s[0] != d[0] || s[1] != d[1] || s[2] != d[2] || (bHasAlpha && s[3] != d[3]))
+				bValid = false;
+		}
+		if (!bValid)
+		{
+			appPrintf("PNG benchmark: %s (%dx%d) is decoded differently with \"%s\" preset\n", Name, width, height, PngPresetNames[Preset]);
+			GPngStats.NumErrors++;
+		}
+	}
+	appFree(Check);
+
+	unguard;
 }
 
-static void ExportTGA_Worker(FArchive& Ar, CTextureData& TexData, byte* pic, int /*Slice*/)
+bool PrintPNGBenchmark()
 {
-	int width = TexData.Mips[0].USize;
-	int height = TexData.Mips[0].VSize;
-#if TGA_SAVE_BOTTOMLEFT
-	// flip image vertically (UnrealEd for UE2 have a bug with importing TGA_TOPLEFT images,
-	// it simply ignores orientation flags)
-	for (int i = 0; i < height / 2; i++)
+	appPrintf("PNG benchmark: %d images, %.1f Mpixels\n", GPngStats.NumImages, GPngStats.NumPixels / 1000000.0f);
+	for (int Preset = 0; Preset < ARRAY_COUNT(PngPresetNames); Preset++)
 	{
-		uint32 *p1 = (uint32*)(pic + width * 4 * i);
-		uint32 *p2 = (uint32*)(pic + width * 4 * (height - i - 1));
-		for (int j = 0; j < width; j++)
-			Exchange(*p1++, *p2++);
+		appPrintf("  %-8s %8.1f Mb %5.1f%% %8d ms\n", PngPresetNames[Preset], GPngStats.Size[Preset] / (1024.0f * 1024.0f),
+			GPngStats.Size[Preset] * 100.0f / max(GPngStats.NumPixels * 4, (int64)1), (int)GPngStats.Time[Preset]);
 	}
-#endif // TGA_SAVE_BOTTOMLEFT
-	WriteTGA(Ar, width, height, pic);
+	if (GPngStats.NumErrors)
+		appPrintf("PNG benchmark: %d images were decoded differently\n", GPngStats.NumErrors);
+	return GPngStats.NumErrors == 0;
+}
+
+static void ExportPNG_Worker(FArchive& Ar, const CTextureData& TexData, const byte* pic, int /*Slice*/)
+{
+	if (GBenchmarkPNG)
+		BenchmarkPNG(TexData.GetObjectName(), pic, TexData.Mips[0].USize, TexData.Mips[0].VSize);
+	TArray<byte> Data;
+	CompressPNG(pic, TexData.Mips[0].USize, TexData.Mips[0].VSize, Data, (EPngCompression)GPngCompression);
+	Ar.Serialize(Data.GetData(), Data.Num());
+}
+
+static void ExportTGA_Worker(FArchive& Ar, const CTextureData& TexData, const byte* pic, int /*Slice*/)
+{
+	// Note: with TGA_SAVE_BOTTOMLEFT, WriteTGA() flips the image vertically while writing
+	WriteTGA(Ar, TexData.Mips[0].USize, TexData.Mips[0].VSize, pic);
 }
 
+struct CTextureExportFormat
+{
+	const char* Ext;
+	void (*Func)(FArchive& Ar, const CTextureData& TexData, const byte* pic, int slice);
+	bool bNeedDecompressedData;
+};
+
+enum
+{
+	TEXEXPORT_TGA,
+	TEXEXPORT_PNG,
+	TEXEXPORT_DDS,
+	TEXEXPORT_HDR,
+
+	TEXEXPORT_COUNT
+};
+
+static const CTextureExportFormat GTextureExportFormats[TEXEXPORT_COUNT] =
+{
+	{ "tga", ExportTGA_Worker, true  },
+	{ "png", ExportPNG_Worker, true  },
+	{ "dds", ExportDDS_Worker, false },
+	{ "hdr", ExportHDR_Worker, true  },
+};
+
+// Exports a texture to one or more formats. The texture is decoded once, and then all the formats are
+// written in parallel.
 struct CTextureExportWorker
 {
 	CTextureData TexData;
-	FArchive* Ar = NULL;
-	void (*Func)(FArchive& Ar, CTextureData& TexData, byte* pic, int slice) = NULL;
+	int NumFormats = 0;
+	int Formats[TEXEXPORT_COUNT];
+	FArchive* Ar[TEXEXPORT_COUNT];
 	bool bFail = false;
-	bool bNeedDecompressedData = true;
+	bool bNeedDecompressedData = false;
 
 	// Support for cubemaps
 	bool HasSlices = false;
 	FString ExportPath;
-	FString ExportExt;
 
 	FORCEINLINE CTextureExportWorker()
 	{}
@@ -339,7 +517,8 @@ struct CTextureExportWorker
 
 	~CTextureExportWorker()
 	{
-		assert(!Ar);
+		for (int i = 0; i < NumFormats; i++)
+			assert(!Ar[i]);
 	}
 
 	bool Setup(const UUnrealMaterial* Tex, bool InHasSlices = false)
@@ -355,49 +534,55 @@ struct CTextureExportWorker
 			return false;
 		}
 
-		const char* Ext = NULL;
-
+		// Select formats. Float textures could be exported in HDR format only, and TGA is used when nothing else
+		// was selected.
+		int WantedFormats[TEXEXPORT_COUNT];
+		int NumWanted = 0;
+		bool bFloat = PixelFormatInfo[Format].Float;
 		if (GExportDDS && PixelFormatInfo[Format].IsDXT())
-		{
-			Func = ExportDDS_Worker;
-			bNeedDecompressedData = false;
-			Ext = "dds";
-		}
-		else if (PixelFormatInfo[Format].Float)
-		{
-			Func = ExportHDR_Worker;
-			Ext = "hdr";
-		}
-		else if (GExportPNG)
-		{
-			Func = ExportPNG_Worker;
-			Ext = "png";
-		}
-		else
-		{
-			Func = ExportTGA_Worker;
-			Ext = "tga";
-		}
-
-		if (!HasSlices)
-		{
-			Ar = CreateExportArchive(Tex, EFileArchiveOptions::Default, "%s.%s", Tex->Name, Ext);
-		}
-		else
+			WantedFormats[NumWanted++] = TEXEXPORT_DDS;
+		if (!bFloat && GExportTGA)
+			WantedFormats[NumWanted++] = TEXEXPORT_TGA;
+		if (!bFloat && GExportPNG)
+			WantedFormats[NumWanted++] = TEXEXPORT_PNG;
+		if (GExportHDR || (bFloat && !NumWanted))
+			WantedFormats[NumWanted++] = TEXEXPORT_HDR;
+		if (!NumWanted)
+			WantedFormats[NumWanted++] = TEXEXPORT_TGA;
+
+		if (HasSlices)
 		{
 			ExportPath = GetExportPath(Tex);
-			ExportExt = Ext;
-			Ar = CreateExportArchive(Tex, EFileArchiveOptions::Default, "%s/Side_0.%s", Tex->Name, Ext);
 		}
 
-		if (Ar == NULL)
+		for (int i = 0; i < NumWanted; i++)
 		{
-			// Failed to create file, or file already exists with enabled "don't overwrite" mode
-			return false;
+			const CTextureExportFormat& Info = GTextureExportFormats[WantedFormats[i]];
+			FArchive* FormatAr;
+			if (!HasSlices)
+			{
+				FormatAr = CreateExportArchive(Tex, EFileArchiveOptions::Default, "%s.%s", Tex->Name, Info.Ext);
+			}
+			else
+			{
+				FormatAr = CreateExportArchive(Tex, EFileArchiveOptions::Default, "%s/Side_0.%s", Tex->Name, Info.Ext);
+			}
+			if (FormatAr == NULL)
+			{
+				// Failed to create file, or file already exists with enabled "don't overwrite" mode. CreateExportArchive()
+				// checks for file existence only for the first file of the object, so skip all formats in this case.
+				if (i == 0) return false;
+				continue;
+			}
+			Formats[NumFormats] = WantedFormats[i];
+			Ar[NumFormats] = FormatAr;
+			NumFormats++;
+			bNeedDecompressedData |= Info.bNeedDecompressedData;
 		}
 
-		// Get texture data in context of the main thread: it's fast anyway
-		if (!Tex->GetTextureData(TexData) || TexData.Mips.Num() == 0)
+		// Get texture data in context of the main thread: it's fast anyway. Only the first mip is exported,
+		// so don't load others.
+		if (!Tex->GetTextureMip(TexData) || TexData.Mips.Num() == 0)
 		{
 			appPrintf("WARNING: texture %s has no valid mipmaps\n", Tex->Name);
 			bFail = true;
@@ -419,27 +604,30 @@ struct CTextureExportWorker
 			if (Slice >= 1)
 			{
 				// For the first slice, we already have Ar create. For other slices, create new Ar
-				char FullPath[MAX_PACKAGE_PATH];
-				// Part of CreateExportArchive
-				appSprintf(ARRAY_ARG(FullPath), "%s/%s/Side_%d.%s", *ExportPath, TexData.GetObjectName(), Slice, *ExportExt);
-
-				if (GDummyExport)
+				for (int i = 0; i < NumFormats; i++)
 				{
-					// Don't create file in "dummy export" mode
-					//todo: should be some common function, don't copy-paste
-					Ar = new FDummyArchive();
-				}
-				else
-				{
-					Ar = new FFileWriter(FullPath, EFileArchiveOptions::NoOpenError);
-					if (!Ar->IsOpen())
+					char FullPath[MAX_PACKAGE_PATH];
+					// Part of CreateExportArchive
+					appSprintf(ARRAY_ARG(FullPath), "%s/%s/Side_%d.%s", *ExportPath, TexData.GetObjectName(), Slice,
+						GTextureExportFormats[Formats[i]].Ext);
+
+					if (GDummyExport)
+					{
+						// Don't create file in "dummy export" mode
+						//todo: should be some common function, don't copy-paste
+						Ar[i] = new FDummyArchive();
+					}
+					else
 					{
-						appPrintf("Error creating file \"%s\" ...\n", FullPath);
-						delete Ar;
-						bFail = true;
+						Ar[i] = new FFileWriter(FullPath, EFileArchiveOptions::NoOpenError);
+						if (!Ar[i]->IsOpen())
+						{
+							appPrintf("Error creating file \"%s\" ...\n", FullPath);
+							bFail = true;
+						}
 					}
+					Ar[i]->ArVer = 128;
 				}
-				Ar->ArVer = 128;
 			}
 
 			byte* pic = NULL;
@@ -457,23 +645,37 @@ struct CTextureExportWorker
 
 			if (bFail)
 			{
-				// Close and delete created file
-				if (FFileArchive* FileAr = Ar->CastTo<FFileArchive>())
+				// Close and delete created files
+				for (int i = 0; i < NumFormats; i++)
 				{
-					FileAr->Close();
-					remove(FileAr->GetFileName());
+					if (FFileArchive* FileAr = Ar[i]->CastTo<FFileArchive>())
+					{
+						FileAr->Close();
+						remove(FileAr->GetFileName());
+					}
 				}
 			}
-			else
+			else if (NumFormats == 1)
 			{
 				// Do the export
-				Func(*Ar, TexData, pic, HasSlices ? Slice : -1);
+				GTextureExportFormats[Formats[0]].Func(*Ar[0], TexData, pic, HasSlices ? Slice : -1);
+			}
+			else
+			{
+				// Run encoders for all formats in parallel, they are sharing the same decoded image
+				ParallelFor(NumFormats, [this, pic, Slice](int i)
+					{
+						GTextureExportFormats[Formats[i]].Func(*Ar[i], TexData, pic, HasSlices ? Slice : -1);
+					});
 			}
 
 			// Cleanup
 			if (pic) delete[] pic;
-			delete Ar;
-			Ar = NULL;
+			for (int i = 0; i < NumFormats; i++)
+			{
+				delete Ar[i];
+				Ar[i] = NULL;
+			}
 
 			if (bFail)
 			{
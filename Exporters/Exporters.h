@@ -40,7 +40,10 @@ FArchive* CreateExportArchive(const UObject* Obj, EFileArchiveOptions FileOption
 extern bool GExportScripts;
 extern bool GExportLods;
 extern bool GNoTgaCompress;
+extern bool GExportTGA;
 extern bool GExportPNG;
+extern bool GExportHDR;
+extern int  GPngCompression;		// EPngCompression
 extern bool GExportDDS;
 extern bool GUncook;
 extern bool GUseGroups;
@@ -70,8 +73,9 @@ void ExportStaticMesh(const CStaticMesh* Mesh);
 void ExportMd5Mesh(const CSkeletalMesh* Mesh);
 void ExportMd5Anim(const CAnimSet* Anim);
 // glTF
-void ExportSkeletalMeshGLTF(const CSkeletalMesh* Mesh);
-void ExportStaticMeshGLTF(const CStaticMesh* Mesh);
+// bBinary = true will write a single .glb file instead of .gltf and .bin
+void ExportSkeletalMeshGLTF(const CSkeletalMesh* Mesh, bool bBinary = false);
+void ExportStaticMeshGLTF(const CStaticMesh* Mesh, bool bBinary = false);
 // 3D
 void Export3D(const UVertMesh* Mesh);
 // TGA, DDS, PNG
@@ -88,7 +92,15 @@ void ExportGfx(const USwfMovie* Swf);
 void ExportFaceFXAnimSet(const UFaceFXAnimSet* Fx);
 void ExportFaceFXAsset(const UFaceFXAsset* Fx);
 
-void WriteTGA(FArchive& Ar, int width, int height, byte* pic);
+// Write RGBA image. Rows are going from top to bottom, or from bottom to top when 'bottomUp' is set.
+// The image data is not modified.
+void WriteTGA(FArchive& Ar, int width, int height, const byte* pic, bool bottomUp = false);
+
+// When GBenchmarkPNG is set, every texture exported in PNG format is also compressed with all compression
+// presets and verified. PrintPNGBenchmark() displays totals and returns false if any image was not decoded
+// back correctly.
+extern bool GBenchmarkPNG;
+bool PrintPNGBenchmark();
 
 
 #endif // __EXPORT_H__
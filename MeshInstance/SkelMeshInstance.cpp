@@ -508,12 +508,12 @@ void CSkelMeshInstance::UpdateSkeleton()
 #endif // SHOW_ANIM
 
 			// compute bone orientation, take care of empty Tracks array
-			if (AnimSeq1 && AnimBoneIndex != INDEX_NONE && AnimSeq1->Tracks.IsValidIndex(AnimBoneIndex) && AnimSeq1->Tracks[AnimBoneIndex]->HasKeys())
+			if (AnimSeq1 && AnimBoneIndex != INDEX_NONE && AnimBoneIndex < AnimSeq1->NumTracks() && AnimSeq1->GetTrack(AnimBoneIndex).HasKeys())
 			{
 				// get bone position from track
 				if (!AnimSeq2 || Chn->SecondaryBlend != 1.0f)
 				{
-					AnimSeq1->Tracks[AnimBoneIndex]->GetBonePosition(
+					AnimSeq1->GetTrack(AnimBoneIndex).GetBonePosition(
 						Chn->CurrentFrame, AnimSeq1->NumFrames, Chn->bLooped, NewBonePosition, NewBoneRotation);
 #if SHOW_ANIM
 					BoneDebug.bIsAnimated = true;
@@ -521,7 +521,7 @@ void CSkelMeshInstance::UpdateSkeleton()
 					BoneDebug.AnimRotation = NewBoneRotation;
 #endif
 #if SHOW_BONE_UPDATES
-					if (AnimSeq1->Tracks[AnimBoneIndex]->HasKeys())
+					if (AnimSeq1->GetTrack(AnimBoneIndex).HasKeys())
 						BoneUpdateCounts[i]++;
 #endif
 				}
@@ -530,7 +530,7 @@ void CSkelMeshInstance::UpdateSkeleton()
 				{
 					CVec3 AnimBonePositionBlend = Bone.Position;	// default position - from bind pose
 					CQuat AnimBoneRotationBlend = Bone.Orientation; // ...
-					AnimSeq2->Tracks[AnimBoneIndex]->GetBonePosition(
+					AnimSeq2->GetTrack(AnimBoneIndex).GetBonePosition(
 						Frame2, AnimSeq2->NumFrames, Chn->bLooped, AnimBonePositionBlend, AnimBoneRotationBlend);
 					if (Chn->SecondaryBlend == 1.0f)
 					{
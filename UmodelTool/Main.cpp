@@ -18,6 +18,7 @@
 #include "UnrealMesh/UnMesh2.h"
 #include "UnrealMesh/UnMesh3.h"
 #include "UnrealMesh/UnMesh4.h"
+#include "UnrealMesh/UnMathTools.h"		// BenchmarkVertexShare
 
 #include "UnSound.h"
 #include "UnThirdParty.h"
@@ -36,11 +37,14 @@
 #include "UmodelCommands.h"
 #include "Version.h"
 #include "MiscStrings.h"
+#include "Parallel.h"
 
 #define APP_CAPTION					"UE Viewer"
 
 //#define SHOW_HIDDEN_SWITCHES		1
 //#define DUMP_MEM_ON_EXIT			1
+//#define DUMP_STRING_POOL_ON_EXIT	1
+//#define DUMP_THREAD_POOL_ON_EXIT	1
 
 
 // Note: declaring this variable in global scope will have side effect that
@@ -51,6 +55,11 @@ CUmodelSettings GSettings;
 extern bool GEnableThreads;
 #endif
 
+#if UNREAL4
+extern int GPakReadAheadBlocks;
+extern int GBlockCacheSizeMb;
+#endif
+
 /*-----------------------------------------------------------------------------
 	Table of known Unreal classes
 -----------------------------------------------------------------------------*/
@@ -252,6 +261,9 @@ static void CallExportSkeletalMesh(const CSkeletalMesh* Mesh)
 	case EExportMeshFormat::gltf:
 		ExportSkeletalMeshGLTF(Mesh);
 		break;
+	case EExportMeshFormat::glb:
+		ExportSkeletalMeshGLTF(Mesh, true);
+		break;
 	case EExportMeshFormat::md5:
 		ExportMd5Mesh(Mesh);
 		break;
@@ -270,6 +282,9 @@ static void CallExportStaticMesh(const CStaticMesh* Mesh)
 	case EExportMeshFormat::gltf:
 		ExportStaticMeshGLTF(Mesh);
 		break;
+	case EExportMeshFormat::glb:
+		ExportStaticMeshGLTF(Mesh, true);
+		break;
 	}
 }
 
@@ -283,6 +298,7 @@ static void CallExportAnimation(const CAnimSet* Anim)
 		ExportPsa(Anim);
 		break;
 	case EExportMeshFormat::gltf:
+	case EExportMeshFormat::glb:
 		appPrintf("ERROR: glTF animation could be exported from mesh viewer only.\n");
 		break;
 	case EExportMeshFormat::md5:
@@ -386,7 +402,28 @@ static void PrintUsage()
 #	endif
 #	if THREADING
 			"    -nomt           disable multithreading optimizations\n"
+			"    -mtload         serialize objects using multiple threads (experimental)\n"
+#	endif
+#	if UNREAL4
+			"    -pakreadahead=N number of pak blocks decompressed at once for sequential\n"
+			"                    reads, 1 disables read-ahead\n"
+			"    -blockcache=MB  size of decompressed pak block cache, 0 disables cache\n"
+			"    -indexcache=DIR store pak directories and package scan results in DIR\n"
+			"                    for faster startup\n"
+#	endif
+			"    -bench=NAME     run a benchmark and verify results, use with -nomt for\n"
+			"                    single-threaded timings; NAME is one of:\n"
+			"                      bc   - compare DXT/BC decoder with nvtt\n"
+			"                      idx  - compare typed mesh index access with accessor\n"
+#	if THREADING
+			"                      load - compare object order of serial and -mtload\n"
+			"                             loading of <package>\n"
 #	endif
+			"                      png  - export textures from <package> with all PNG\n"
+			"                             compression presets\n"
+			"                      prop - compare cached property lookup with linear search\n"
+			"                      scan - compare parallel and serial listing of -path\n"
+			"                      weld - compare mesh vertex welding with reference code\n"
 #endif // SHOW_HIDDEN_SWITCHES
 			"\n"
 			"Options:\n"
@@ -440,9 +477,17 @@ static void PrintUsage()
 			"    -psk            use ActorX format for meshes (default)\n"
 			"    -md5            use md5mesh/md5anim format for skeletal mesh\n"
 			"    -gltf           use glTF 2.0 format for mesh\n"
+			"    -glb            use binary glTF 2.0 format for mesh (single .glb file)\n"
 			"    -lods           export all available mesh LOD levels\n"
 			"    -dds            export textures in DDS format whenever possible\n"
 			"    -png            export textures in PNG format instead of TGA\n"
+			"    -tga            export textures in TGA format (default)\n"
+			"    -hdr            export textures in Radiance HDR format (always used for\n"
+			"                    float textures)\n"
+			"                    Several texture formats could be specified together, in\n"
+			"                    this case all of them are written from a single decode\n"
+			"    -png=<preset>   PNG export with compression preset: default, fast, store\n"
+			"                    or best\n"
 			"    -notgacomp      disable TGA compression\n"
 			"    -nooverwrite    prevent existing files from being overwritten (better\n"
 			"                    performance)\n"
@@ -798,6 +843,8 @@ int main(int argc, const char **argv)
 	TArray<const char*> packagesToLoad, objectsToLoad;
 	TArray<const char*> params;
 	const char *attachAnimName = NULL;
+	const char *benchName = NULL;
+	bool bBenchmarkLoading = false;
 	for (int arg = 1; arg < argc; arg++)
 	{
 		const char *opt = argv[arg];
@@ -839,6 +886,8 @@ int main(int argc, const char **argv)
 			OPT_NBOOL("nolightmap", GSettings.Startup.UseLightmapTexture)
 			OPT_BOOL ("sounds",  GSettings.Startup.UseSound)
 			OPT_BOOL ("dds",     GSettings.Export.ExportDdsTexture)
+			OPT_BOOL ("tga",     GExportTGA)
+			OPT_BOOL ("hdr",     GExportHDR)
 			OPT_BOOL ("notgacomp", GNoTgaCompress)
 			OPT_BOOL ("nooverwrite", GDontOverwriteFiles)
 #if HAS_UI
@@ -874,6 +923,10 @@ int main(int argc, const char **argv)
 		{
 			GSettings.Export.SkeletalMeshFormat = GSettings.Export.StaticMeshFormat = EExportMeshFormat::gltf;
 		}
+		else if (!stricmp(opt, "glb"))
+		{
+			GSettings.Export.SkeletalMeshFormat = GSettings.Export.StaticMeshFormat = EExportMeshFormat::glb;
+		}
 		else if (!stricmp(opt, "all") && mainCmd == CMD_Dump)
 		{
 			// -all should be used only with -dump
@@ -893,6 +946,20 @@ int main(int argc, const char **argv)
 		{
 			GSettings.Export.SetPath(opt+4);
 		}
+		else if (!strnicmp(opt, "png=", 4))
+		{
+			static const char* PngPresets[] = { "default", "fast", "store", "best" };
+			int preset;
+			for (preset = 0; preset < ARRAY_COUNT(PngPresets); preset++)
+				if (!stricmp(opt+4, PngPresets[preset])) break;
+			if (preset == ARRAY_COUNT(PngPresets))
+			{
+				appPrintf("ERROR: unknown PNG compression preset \"%s\"\n", opt+4);
+				exit(0);
+			}
+			GSettings.Export.TextureFormat = ETextureExportFormat::png;
+			GPngCompression = preset;
+		}
 		else if (!strnicmp(opt, "game=", 5))
 		{
 			int tag = FindGameTag(opt+5);
@@ -964,12 +1031,46 @@ int main(int argc, const char **argv)
 		{
 			GEnableThreads = false;
 		}
+		else if (!stricmp(opt, "mtload"))
+		{
+			GParallelObjectLoading = true;
+		}
+#endif
+#if UNREAL4
+		else if (!strnicmp(opt, "pakreadahead=", 13))
+		{
+			int blocks = atoi(opt+13);
+			if (blocks < 1)
+			{
+				appPrintf("ERROR: pakreadahead value is not valid: %s\n", opt+13);
+				exit(0);
+			}
+			GPakReadAheadBlocks = blocks;
+		}
+		else if (!strnicmp(opt, "blockcache=", 11))
+		{
+			int size = atoi(opt+11);
+			if (size < 0)
+			{
+				appPrintf("ERROR: blockcache value is not valid: %s\n", opt+11);
+				exit(0);
+			}
+			GBlockCacheSizeMb = size;
+		}
+		else if (!strnicmp(opt, "indexcache=", 11))
+		{
+			appStrncpyz(GGameIndexCacheDir, opt+11, MAX_PACKAGE_PATH);
+		}
 #endif
 		else if (!stricmp(opt, "testexport"))
 		{
 			mainCmd = CMD_Export;
 			GDummyExport = true;
 		}
+		else if (!strnicmp(opt, "bench=", 6))
+		{
+			benchName = opt+6;
+		}
 		else if (!stricmp(opt, "debug"))
 		{
 			// Do nothing if this option is not supported
@@ -980,6 +1081,46 @@ int main(int argc, const char **argv)
 		}
 	}
 
+	// Benchmarks are executed after parsing of all options, because options like -nomt affect results
+	if (benchName)
+	{
+		if (!stricmp(benchName, "bc"))
+			return BenchmarkBCDecoder() ? 0 : 1;
+		if (!stricmp(benchName, "weld"))
+			return BenchmarkVertexShare() ? 0 : 1;
+		if (!stricmp(benchName, "idx"))
+			return BenchmarkIndexAccess() ? 0 : 1;
+		if (!stricmp(benchName, "scan"))
+		{
+			if (!hasRootDir) CommandLineError("-bench=scan requires -path");
+			return BenchmarkDirectoryScanner(*GSettings.Startup.GamePath) ? 0 : 1;
+		}
+		if (!stricmp(benchName, "prop"))
+		{
+			// UE3 has the largest set of classes, including 3rd party ones
+			InitClassAndExportSystems(GAME_UE3);
+			return BenchmarkFindProperty() ? 0 : 1;
+		}
+		if (!stricmp(benchName, "png"))
+		{
+			// the benchmark works with exported textures, results are displayed after export
+			mainCmd = CMD_Export;
+			GSettings.Export.TextureFormat = ETextureExportFormat::png;
+			GBenchmarkPNG = true;
+		}
+#if THREADING
+		else if (!stricmp(benchName, "load"))
+		{
+			// the benchmark works with loaded packages
+			bBenchmarkLoading = true;
+		}
+#endif
+		else
+		{
+			CommandLineError("unknown benchmark: %s", benchName);
+		}
+	}
+
 	// Parse UMODEL [package_name [obj_name [class_name]]]
 	const char *argPkgName   = (params.Num() >= 1) ? params[0] : NULL;
 	const char *argObjName   = (params.Num() >= 2) ? params[1] : NULL;
@@ -1170,6 +1311,11 @@ int main(int argc, const char **argv)
 	// register exporters and classes
 	InitClassAndExportSystems(Packages[0]->Game);
 
+#if THREADING
+	if (bBenchmarkLoading)
+		return BenchmarkParallelLoading(Packages) ? 0 : 1;
+#endif
+
 	if (mainCmd == CMD_PkgInfo)
 	{
 		DisplayPackageStats(Packages);
@@ -1267,6 +1413,8 @@ int main(int argc, const char **argv)
 		{
 			ExportPackages(Packages);
 		}
+		if (GBenchmarkPNG)
+			return PrintPNGBenchmark() ? 0 : 1;
 #if HAS_UI || RENDERING
 		if (!GApplication.GuiShown)
 			return 0;
@@ -1337,6 +1485,12 @@ int main(int argc, const char **argv)
 	appPrintf("Memory: allocated " FORMAT_SIZE("d") " bytes in %d blocks\n", GTotalAllocationSize, GTotalAllocationCount);
 	appDumpMemoryAllocations();
 #endif
+#if DUMP_STRING_POOL_ON_EXIT
+	appPrintStringPoolStats();
+#endif
+#if DUMP_THREAD_POOL_ON_EXIT && THREADING
+	ThreadPool::PrintStats();
+#endif
 
 	unguardf("umodel_build=%s", STR(GIT_REVISION));	// using string constant to allow non-git builds (with GIT_REVISION 'unknown')
 
@@ -138,6 +138,7 @@ UIElement& UISettingsDialog::MakeExportOptions()
 					.SetWidth(100)
 					.AddItem("ActorX (psk)", EExportMeshFormat::psk)
 					.AddItem("glTF 2.0", EExportMeshFormat::gltf)
+					.AddItem("glTF 2.0 (glb)", EExportMeshFormat::glb)
 					.AddItem("md5mesh", EExportMeshFormat::md5)
 				+ NewControl(UISpacer)
 				+ NewControl(UILabel, "Static Mesh:").SetY(4).SetAutoSize()
@@ -145,6 +146,7 @@ UIElement& UISettingsDialog::MakeExportOptions()
 					.SetWidth(100)
 					.AddItem("ActorX (pskx)", EExportMeshFormat::psk)
 					.AddItem("glTF 2.0", EExportMeshFormat::gltf)
+					.AddItem("glTF 2.0 (glb)", EExportMeshFormat::glb)
 			]
 			+ NewControl(UICheckbox, "Export LODs", &Opt.Export.ExportMeshLods)
 		]
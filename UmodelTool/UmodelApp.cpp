@@ -457,7 +457,8 @@ static void TakeScreenshot(const char *ObjectName, bool CatchAlpha)
 		delete picDepth;
 	}
 
-	WriteTGA(Ar, width, height, pic);
+	// glReadPixels() returns rows from bottom to top
+	WriteTGA(Ar, width, height, pic, true);
 	delete pic;
 }
 
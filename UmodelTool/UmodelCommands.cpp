@@ -8,6 +8,8 @@
 #include "Exporters/Exporters.h"
 #include "UmodelApp.h"
 
+#include "Parallel.h"
+
 
 bool ExportObjects(const TArray<UObject*> *Objects, IProgressCallback* progress)
 {
@@ -51,6 +53,81 @@ bool ExportObjects(const TArray<UObject*> *Objects, IProgressCallback* progress)
 }
 
 
+#if THREADING
+
+// Maximal number of packages prefetched ahead of the package being exported
+#define MAX_PREFETCH_PACKAGES		4
+
+// Reads export data of the next packages while the current package is loaded and exported in the main thread,
+// so file reading and pak decompression overlaps with object serialization.
+class CPackagePrefetcher
+{
+public:
+	CPackagePrefetcher(const TArray<UnPackage*>& InPackages)
+	:	Packages(InPackages)
+	,	NumStarted(0)
+	{
+		Depth = min(ThreadPool::GetNumThreads(), MAX_PREFETCH_PACKAGES);
+	}
+
+	~CPackagePrefetcher()
+	{
+		// Release data which wasn't used (export was cancelled)
+		for (CSlot& Slot : Slots)
+		{
+			Slot.Tasks.Wait();
+			if (Slot.Data) delete Slot.Data;
+		}
+	}
+
+	// Get prefetched data for the package with index 'PackageIndex', and start prefetching of the next packages.
+	// Packages should be requested in order.
+	FArchive* Get(int PackageIndex)
+	{
+		guard(CPackagePrefetcher::Get);
+
+		if (!Depth) return NULL;
+
+		while (NumStarted < Packages.Num() && NumStarted < PackageIndex + Depth)
+		{
+			CSlot& Slot = Slots[NumStarted % Depth];
+			Slot.Package = Packages[NumStarted];
+			Slot.Tasks.Run(CSlot::Prefetch, &Slot);
+			NumStarted++;
+		}
+
+		CSlot& Slot = Slots[PackageIndex % Depth];
+		Slot.Tasks.Wait();
+		assert(Slot.Package == Packages[PackageIndex]);
+		FArchive* Data = Slot.Data;
+		Slot.Data = NULL;
+		return Data;
+
+		unguard;
+	}
+
+protected:
+	struct CSlot
+	{
+		UnPackage*				Package = NULL;
+		FArchive*				Data = NULL;
+		ThreadPool::CTaskGroup	Tasks;
+
+		static void Prefetch(void* Param)
+		{
+			CSlot* Slot = (CSlot*)Param;
+			Slot->Data = Slot->Package->PrefetchExportData();
+		}
+	};
+
+	const TArray<UnPackage*>& Packages;
+	CSlot		Slots[MAX_PREFETCH_PACKAGES];
+	int			Depth;
+	int			NumStarted;
+};
+
+#endif // THREADING
+
 bool ExportPackages(const TArray<UnPackage*>& Packages, IProgressCallback* Progress)
 {
 	guard(ExportPackages);
@@ -73,6 +150,10 @@ bool ExportPackages(const TArray<UnPackage*>& Packages, IProgressCallback* Progr
 
 	BeginExport(true);
 
+#if THREADING
+	CPackagePrefetcher Prefetcher(Packages);
+#endif
+
 	// For each package: load a package, export, then release
 	for (int i = 0; i < Packages.Num(); i++)
 	{
@@ -84,14 +165,16 @@ bool ExportPackages(const TArray<UnPackage*>& Packages, IProgressCallback* Progr
 			cancelled = true;
 			break;
 		}
-		// Load
-		if (!LoadWholePackage(package, Progress))
-		{
-			cancelled = true;
-			break;
-		}
-		// Export
-		if (!ExportObjects(NULL, Progress))
+#if THREADING
+		FArchive* PrefetchedData = Prefetcher.Get(i);
+		if (PrefetchedData) package->AttachPrefetchedData(PrefetchedData);
+#endif
+		// Load and export
+		bool bSucceeded = LoadWholePackage(package, Progress) && ExportObjects(NULL, Progress);
+#if THREADING
+		if (PrefetchedData) package->AttachPrefetchedData(NULL);
+#endif
+		if (!bSucceeded)
 		{
 			cancelled = true;
 			break;
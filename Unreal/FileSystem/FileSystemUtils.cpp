@@ -1,5 +1,10 @@
 #include "Core.h"
 #include "UnCore.h"
+#include "FileSystemUtils.h"
+
+#if THREADING
+#include "Parallel.h"
+#endif
 
 
 void ValidateMountPoint(FString& MountPoint, const FString& ContextFilename)
@@ -79,6 +84,11 @@ int32 StringToCompressionMethod(const char* Name)
 
 bool FileRequiresAesKey(bool fatal)
 {
+#if THREADING
+	// Files could be opened from different threads, ask user for a key only once
+	static CMutex KeyMutex;
+	CMutex::ScopedLock Lock(KeyMutex);
+#endif
 	if ((GAesKeys.Num() == 0) && !UE4EncryptedPak())
 	{
 		if (fatal)
@@ -88,4 +98,154 @@ bool FileRequiresAesKey(bool fatal)
 	return true;
 }
 
+/*-----------------------------------------------------------------------------
+	Decompressed block cache
+-----------------------------------------------------------------------------*/
+
+int GBlockCacheSizeMb = 64;
+
+struct CCachedBlock
+{
+	const void*		Container;
+	uint64			Offset;
+	int				Size;
+	CCachedBlock*	HashNext;
+	// LRU list: Head is the most recently used block
+	CCachedBlock*	Prev;
+	CCachedBlock*	Next;
+
+	FORCEINLINE byte* GetData()
+	{
+		return (byte*)(this + 1);
+	}
+};
+
+#define BLOCK_CACHE_HASH_BITS	12
+#define BLOCK_CACHE_HASH_SIZE	(1 << BLOCK_CACHE_HASH_BITS)
+
+static CCachedBlock* BlockCacheHash[BLOCK_CACHE_HASH_SIZE];
+static CCachedBlock* BlockCacheHead = NULL;
+static CCachedBlock* BlockCacheTail = NULL;
+static size_t BlockCacheSize = 0;
+
+#if THREADING
+static CMutex GBlockCacheMutex;
+#endif
+
+FORCEINLINE int GetBlockCacheHash(const void* Container, uint64 Offset)
+{
+	uint64 Key = (Offset ^ (uint64)(size_t)Container) * 0x9E3779B97F4A7C15ull;
+	return int(Key >> (64 - BLOCK_CACHE_HASH_BITS));
+}
+
+static CCachedBlock** FindCachedBlock(const void* Container, uint64 Offset)
+{
+	CCachedBlock** Prev = &BlockCacheHash[GetBlockCacheHash(Container, Offset)];
+	while (CCachedBlock* Block = *Prev)
+	{
+		if (Block->Offset == Offset && Block->Container == Container)
+			break;
+		Prev = &Block->HashNext;
+	}
+	return Prev;
+}
+
+static void UnlinkCachedBlock(CCachedBlock* Block)
+{
+	if (Block->Prev) Block->Prev->Next = Block->Next; else BlockCacheHead = Block->Next;
+	if (Block->Next) Block->Next->Prev = Block->Prev; else BlockCacheTail = Block->Prev;
+}
+
+static void LinkCachedBlockToHead(CCachedBlock* Block)
+{
+	Block->Prev = NULL;
+	Block->Next = BlockCacheHead;
+	if (BlockCacheHead) BlockCacheHead->Prev = Block; else BlockCacheTail = Block;
+	BlockCacheHead = Block;
+}
+
+static void FreeCachedBlock(CCachedBlock* Block)
+{
+	*FindCachedBlock(Block->Container, Block->Offset) = Block->HashNext;
+	UnlinkCachedBlock(Block);
+	BlockCacheSize -= Block->Size;
+	appFree(Block);
+}
+
+bool GetCachedBlock(const void* Container, uint64 BlockOffset, byte* Dst, int Size)
+{
+	if (GBlockCacheSizeMb <= 0) return false;
+
+#if THREADING
+	CMutex::ScopedLock Lock(GBlockCacheMutex);
+#endif
+
+	CCachedBlock* Block = *FindCachedBlock(Container, BlockOffset);
+	if (!Block || Block->Size != Size)
+		return false;
+
+	// Move to the head of LRU list
+	UnlinkCachedBlock(Block);
+	LinkCachedBlockToHead(Block);
+	memcpy(Dst, Block->GetData(), Size);
+#if PROFILE
+	GBlockCacheHits++;
+#endif
+	return true;
+}
+
+void PutCachedBlock(const void* Container, uint64 BlockOffset, const byte* Src, int Size)
+{
+	size_t MaxSize = size_t(GBlockCacheSizeMb) << 20;
+	if ((size_t)Size > MaxSize) return;
+
+#if THREADING
+	CMutex::ScopedLock Lock(GBlockCacheMutex);
+#endif
+
+	// Every block put to the cache was decompressed because it was missing there
+#if PROFILE
+	GBlockCacheMisses++;
+#endif
+
+	// The block could be already added by another thread
+	if (*FindCachedBlock(Container, BlockOffset))
+		return;
+
+	// Free space by dropping least recently used blocks
+	while (BlockCacheTail && BlockCacheSize + Size > MaxSize)
+	{
+		FreeCachedBlock(BlockCacheTail);
+	}
+
+	CCachedBlock* Block = (CCachedBlock*)appMallocNoInit(sizeof(CCachedBlock) + Size);
+	Block->Container = Container;
+	Block->Offset = BlockOffset;
+	Block->Size = Size;
+	memcpy(Block->GetData(), Src, Size);
+
+	CCachedBlock** HashHead = &BlockCacheHash[GetBlockCacheHash(Container, BlockOffset)];
+	Block->HashNext = *HashHead;
+	*HashHead = Block;
+	LinkCachedBlockToHead(Block);
+	BlockCacheSize += Size;
+}
+
+void PurgeCachedBlocks(const void* Container)
+{
+#if THREADING
+	CMutex::ScopedLock Lock(GBlockCacheMutex);
+#endif
+
+	CCachedBlock* Next;
+	for (CCachedBlock* Block = BlockCacheHead; Block; Block = Next)
+	{
+		Next = Block->Next;
+		if (Block->Container == Container)
+		{
+			FreeCachedBlock(Block);
+		}
+	}
+}
+
 #endif // UNREAL4
@@ -9,4 +9,22 @@ int32 StringToCompressionMethod(const char* Name);
 
 bool FileRequiresAesKey(bool fatal = true);
 
+#if UNREAL4
+
+// Process-wide LRU cache of decompressed container blocks, shared by pak and IoStore readers.
+// A block is identified by its container object and by the offset of its compressed data in
+// container file. All functions are thread-safe.
+
+// Cache size limit in megabytes, 0 disables caching
+extern int GBlockCacheSizeMb;
+
+// Copy cached block data to Dst. Returns false if the block is not in cache.
+bool GetCachedBlock(const void* Container, uint64 BlockOffset, byte* Dst, int Size);
+// Put decompressed block data to the cache
+void PutCachedBlock(const void* Container, uint64 BlockOffset, const byte* Src, int Size);
+// Drop all blocks belonging to the Container, should be called when container is destroyed
+void PurgeCachedBlocks(const void* Container);
+
+#endif // UNREAL4
+
 #endif // __FILE_SYSTEM_UTILS_H__
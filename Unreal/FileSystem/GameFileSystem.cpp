@@ -13,8 +13,8 @@
 #	include <io.h>					// for findfirst() set
 #else
 #	include <dirent.h>				// for opendir() etc
-#	include <sys/stat.h>			// for stat()
 #endif
+#include <sys/stat.h>				// for stat()
 
 
 /*-----------------------------------------------------------------------------
@@ -348,9 +348,350 @@ int RegisterGameFolder(const char* FolderName)
 }
 
 
+/*-----------------------------------------------------------------------------
+	Game file index cache
+-----------------------------------------------------------------------------*/
+
+#if UNREAL4
+
+// The cache holds pak file directories together with package scan results. Pak files are validated
+// with their name, size and modification time, so the cache is refreshed automatically when game is
+// updated. Paks with encrypted index are not cached to not store decrypted data on disk. The cache is
+// also invalidated when a different set of AES keys is used.
+
+#define GAME_INDEX_MAGIC		0x58494D55		// 'UMIX'
+#define GAME_INDEX_VERSION		2
+
+char GGameIndexCacheDir[MAX_PACKAGE_PATH];
+
+// Pak directory stored in the cache file
+struct CCachedPakInfo
+{
+	FString		Filename;					// relative to GRootDirectory
+	int64		Size;
+	int64		Time;
+	int			DataOffset;					// location of FPakVFS::SaveDirectory() data in the cache file
+	int			DataSize;
+	uint32		DataHash;
+};
+
+// Pak attached to the game file system, used to write the cache
+struct CAttachedPakInfo
+{
+	FPakVFS*	Vfs;
+	FString		Filename;
+	int64		Size;
+	int64		Time;
+};
+
+static FArchive* GGameIndexReader = NULL;
+static TArray<CCachedPakInfo> GCachedPaks;
+static TArray<CAttachedPakInfo> GAttachedPaks;
+static int GNumPaksFromCache = 0;			// number of GAttachedPaks restored from GCachedPaks
+static bool GGameIndexDirty = false;
+
+static uint32 GetGameIndexHash(const byte* Data, int Size)
+{
+	// FNV-1a
+	uint32 Hash = 0x811C9DC5;
+	for (int i = 0; i < Size; i++)
+		Hash = (Hash ^ Data[i]) * 0x01000193;
+	return Hash;
+}
+
+// Hash of all AES keys, so the keys are not stored in the cache file
+static uint32 GetAesKeysHash()
+{
+	uint32 Hash = GetGameIndexHash(NULL, 0);
+	for (const FString& Key : GAesKeys)
+	{
+		Hash ^= GetGameIndexHash((const byte*)*Key, Key.Len());
+		Hash *= 0x01000193;
+	}
+	return Hash;
+}
+
+static void GetGameIndexFilename(char* Buffer, int BufferSize)
+{
+	// Different game roots are using different cache files
+	uint32 Hash = GetGameIndexHash((const byte*)GRootDirectory, strlen(GRootDirectory));
+	appSprintf(Buffer, BufferSize, "%s/umodel-%08X.idx", GGameIndexCacheDir, Hash);
+}
+
+static bool GetFileStamp(const char* Filename, int64& Size, int64& Time)
+{
+#if _WIN32
+	struct _stat64 buf;
+	if (_stat64(Filename, &buf) != 0) return false;
+#else
+	struct stat64 buf;
+	if (stat64(Filename, &buf) != 0) return false;
+#endif
+	Size = buf.st_size;
+	Time = buf.st_mtime;
+	return true;
+}
+
+static void LoadGameIndex()
+{
+	guard(LoadGameIndex);
+
+	GCachedPaks.Empty();
+	GAttachedPaks.Empty();
+	GNumPaksFromCache = 0;
+	GGameIndexDirty = true;
+	if (!GGameIndexCacheDir[0]) return;
+
+	char Filename[MAX_PACKAGE_PATH];
+	GetGameIndexFilename(ARRAY_ARG(Filename));
+	FArchive* Ar = new FMappedFileReader(Filename, EFileArchiveOptions::NoOpenError);
+	if (!Ar->IsOpen())
+	{
+		delete Ar;
+		return;
+	}
+	Ar->Game = GAME_UE4_BASE;
+
+	// Validate the header
+	int32 Magic = 0, Version = 0, ForceGame, ForcePlatform;
+	int64 FileSize = Ar->GetFileSize64();
+	if (FileSize >= 8)
+	{
+		*Ar << Magic << Version;
+	}
+	if (Magic != GAME_INDEX_MAGIC || Version != GAME_INDEX_VERSION || FileSize >= MAX_FILE_SIZE_32)
+	{
+		delete Ar;
+		return;
+	}
+	FString Root;
+	uint32 KeysHash;
+	*Ar << Root << ForceGame << ForcePlatform << KeysHash;
+	if (strcmp(*Root, GRootDirectory) != 0 || ForceGame != GForceGame || ForcePlatform != GForcePlatform ||
+		KeysHash != GetAesKeysHash())
+	{
+		delete Ar;
+		return;
+	}
+
+	// Read the list of paks, pak data will be accessed later
+	while (true)
+	{
+		byte bMore;
+		*Ar << bMore;
+		if (!bMore) break;
+		CCachedPakInfo* Pak = new (GCachedPaks) CCachedPakInfo;
+		*Ar << Pak->Filename << Pak->Size << Pak->Time << Pak->DataSize << Pak->DataHash;
+		Pak->DataOffset = Ar->Tell();
+		if (Pak->DataSize < 0 || Pak->DataOffset + (int64)Pak->DataSize > FileSize)
+		{
+			// Truncated file
+			GCachedPaks.Empty();
+			delete Ar;
+			return;
+		}
+		Ar->Seek(Pak->DataOffset + Pak->DataSize);
+	}
+
+	GGameIndexReader = Ar;
+	GGameIndexDirty = false;
+
+	unguard;
+}
+
+static void FinishGameIndexLoading()
+{
+	if (GGameIndexReader)
+	{
+		delete GGameIndexReader;
+		GGameIndexReader = NULL;
+	}
+	// Rewrite the cache when pak set has changed: paks which were not found in the cache already set
+	// GGameIndexDirty, so check for cached paks which were removed or replaced
+	if (GNumPaksFromCache != GCachedPaks.Num())
+	{
+		GGameIndexDirty = true;
+	}
+	GCachedPaks.Empty();
+	if (GGameIndexDirty)
+	{
+		appSaveGameIndex();
+	}
+}
+
+void appSaveGameIndex()
+{
+	guard(appSaveGameIndex);
+
+	if (!GGameIndexCacheDir[0] || !GRootDirectory[0]) return;
+
+	char Filename[MAX_PACKAGE_PATH], TempFilename[MAX_PACKAGE_PATH];
+	GetGameIndexFilename(ARRAY_ARG(Filename));
+	appSprintf(ARRAY_ARG(TempFilename), "%s.tmp", Filename);
+	appMakeDirectory(GGameIndexCacheDir);
+
+	FFileWriter* Ar = new FFileWriter(TempFilename, EFileArchiveOptions::NoOpenError);
+	if (!Ar->IsOpen())
+	{
+		appPrintf("WARNING: unable to create game index cache %s\n", TempFilename);
+		delete Ar;
+		return;
+	}
+	Ar->Game = GAME_UE4_BASE;
+
+	int32 Magic = GAME_INDEX_MAGIC, Version = GAME_INDEX_VERSION, ForceGame = GForceGame, ForcePlatform = GForcePlatform;
+	FString Root(GRootDirectory);
+	uint32 KeysHash = GetAesKeysHash();
+	*Ar << Magic << Version << Root << ForceGame << ForcePlatform << KeysHash;
+
+	for (CAttachedPakInfo& Pak : GAttachedPaks)
+	{
+		FMemWriter Mem;
+		Mem.Game = GAME_UE4_BASE;
+		if (!Pak.Vfs->SaveDirectory(Mem)) continue;
+
+		const TArray<byte>& Data = Mem.GetData();
+		byte bMore = 1;
+		int32 DataSize = Data.Num();
+		uint32 DataHash = GetGameIndexHash(Data.GetData(), DataSize);
+		*Ar << bMore << Pak.Filename << Pak.Size << Pak.Time << DataSize << DataHash;
+		Ar->Serialize(const_cast<byte*>(Data.GetData()), DataSize);
+	}
+	byte bMore = 0;
+	*Ar << bMore;
+	delete Ar;
+
+	// Replace the cache file
+	remove(Filename);
+	if (rename(TempFilename, Filename) != 0)
+	{
+		appPrintf("WARNING: unable to write game index cache %s\n", Filename);
+	}
+	GGameIndexDirty = false;
+
+	unguard;
+}
+
+// Check if pak directory could be restored from the game index cache. Only file stamps are
+// verified here, AttachPakReader() will also validate the cached data.
+static bool IsPakCached(const char* FullName)
+{
+	int64 Size, Time;
+	if (!GGameIndexReader || !GetFileStamp(FullName, Size, Time))
+		return false;
+	const char* Filename = FullName + strlen(GRootDirectory) + 1;
+	for (const CCachedPakInfo& Cached : GCachedPaks)
+	{
+		if (Cached.Size == Size && Cached.Time == Time && stricmp(*Cached.Filename, Filename) == 0)
+			return true;
+	}
+	return false;
+}
+
+// Attach pak reader using the cached directory when possible
+static bool AttachPakReader(FPakVFS* Vfs, FArchive* reader, const char* FullName, FString& error)
+{
+	guard(AttachPakReader);
+
+	CAttachedPakInfo Pak;
+	if (!GGameIndexCacheDir[0] || !GetFileStamp(FullName, Pak.Size, Pak.Time))
+	{
+		return Vfs->AttachReader(reader, error);
+	}
+	Pak.Vfs = Vfs;
+	Pak.Filename = FullName + strlen(GRootDirectory) + 1;
+
+	for (const CCachedPakInfo& Cached : GCachedPaks)
+	{
+		if (Cached.Size != Pak.Size || Cached.Time != Pak.Time || stricmp(*Cached.Filename, *Pak.Filename) != 0)
+			continue;
+		const byte* Data = GGameIndexReader->GetDirectPointer(Cached.DataOffset, Cached.DataSize);
+		if (!Data || GetGameIndexHash(Data, Cached.DataSize) != Cached.DataHash)
+			break;
+		FMemReader CacheAr(Data, Cached.DataSize);
+		CacheAr.Game = GAME_UE4_BASE;
+		Vfs->AttachReaderFromCache(reader, CacheAr);
+		GAttachedPaks.Add(Pak);
+		GNumPaksFromCache++;
+		return true;
+	}
+
+	// Not cached, or cached data is outdated
+	if (!Vfs->AttachReader(reader, error))
+		return false;
+	GAttachedPaks.Add(Pak);
+	GGameIndexDirty = true;
+	return true;
+
+	unguardf("%s", FullName);
+}
+
+// Pak file with index loaded by PreloadPakFile(), but with files not registered yet
+struct CPreloadedPak
+{
+	FArchive*	Reader;
+	FPakVFS*	Vfs;
+};
+
+// Read pak index in advance. Doesn't modify global state, so could be executed in parallel for
+// several pak files. Registration is done later with RegisterGameFile(), in the usual order.
+static void PreloadPakFile(const char* FullName, int64 FileSize, CPreloadedPak& Preloaded)
+{
+	guard(PreloadPakFile);
+
+	Preloaded.Reader = NULL;
+	Preloaded.Vfs = NULL;
+	if (IsPakCached(FullName))
+		return;
+
+	FArchive* reader = appCreateFileReader(FullName, EFileArchiveOptions::Default, FileSize);
+	if (!reader) return;
+	reader->Game = GAME_UE4_BASE;
+	Preloaded.Reader = reader;
+	Preloaded.Vfs = new FPakVFS(FullName);
+	Preloaded.Vfs->LoadIndex(reader);
+
+	unguardf("%s", FullName);
+}
+
+#if THREADING
+
+static bool TryPreloadPakFileImpl(const char* FullName, int64 FileSize, CPreloadedPak& Preloaded)
+{
+	TRY {
+		PreloadPakFile(FullName, FileSize, Preloaded);
+		return true;
+	} CATCH {
+		return false;
+	}
+}
+
+// PreloadPakFile() for a pool thread. Errors are not raised here: a pak with failed index is left for
+// RegisterGameFile(), which will load it again in the main thread and report the error in the usual way.
+static void TryPreloadPakFile(const char* FullName, int64 FileSize, CPreloadedPak& Preloaded)
+{
+	if (TryPreloadPakFileImpl(FullName, FileSize, Preloaded))
+		return;
+	CErrorContext Error;
+	GError.DetachThreadError(Error);
+	delete Preloaded.Vfs;
+	delete Preloaded.Reader;
+	Preloaded.Vfs = NULL;
+	Preloaded.Reader = NULL;
+}
+
+#endif // THREADING
+
+#else
+
+struct CPreloadedPak;
+
+#endif // UNREAL4
+
+
 //!! add define USE_VFS = SUPPORT_ANDROID || UNREAL4, perhaps || SUPPORT_IOS
 
-static void RegisterGameFile(const char* FullName, int64 FileSize = -1)
+static void RegisterGameFile(const char* FullName, int64 FileSize = -1, CPreloadedPak* Preloaded = NULL)
 {
 	guard(RegisterGameFile);
 
@@ -379,10 +720,18 @@ static void RegisterGameFile(const char* FullName, int64 FileSize = -1)
 	FPakVFS* PakVfs = NULL;
 	if (!stricmp(ext, "pak"))
 	{
-		reader = new FFileReader(FullName);
-		if (!reader) return;
-		reader->Game = GAME_UE4_BASE;
-		PakVfs = new FPakVFS(FullName);
+		if (Preloaded && Preloaded->Vfs)
+		{
+			reader = Preloaded->Reader;
+			PakVfs = Preloaded->Vfs;
+		}
+		else
+		{
+			reader = appCreateFileReader(FullName, EFileArchiveOptions::Default, FileSize);
+			if (!reader) return;
+			reader->Game = GAME_UE4_BASE;
+			PakVfs = new FPakVFS(FullName);
+		}
 		vfs = PakVfs;
 		GIsUE4Pak = true; // ignore non-UE4 extensions for speedup file registration
 	}
@@ -398,7 +747,12 @@ static void RegisterGameFile(const char* FullName, int64 FileSize = -1)
 		assert(reader);
 		// read VFS directory
 		FString error;
-		if (!vfs->AttachReader(reader, error))
+#if UNREAL4
+		bool bAttached = PakVfs ? AttachPakReader(PakVfs, reader, FullName, error) : vfs->AttachReader(reader, error);
+#else
+		bool bAttached = vfs->AttachReader(reader, error);
+#endif
+		if (!bAttached)
 		{
 #if UNREAL4
 			// Reset GIsUE4Pak back in a case if .pak file appeared in directory
@@ -699,89 +1053,525 @@ CGameFileInfo* CGameFileInfo::Register(FVirtualFileSystem* parentVfs, const CReg
 	unguardf("%s", RegisterInfo.Filename);
 }
 
-static bool ScanGameDirectory(const char *dir, bool recurse)
-{
-	guard(ScanGameDirectory);
-
-	char Path[MAX_PACKAGE_PATH];
-	bool res = true;
-//	printf("Scan %s\n", dir);
+// Directory listing is performed by worker threads, while the calling thread walks the
+// resulting tree in a fixed depth-first order and registers files. Registration of a
+// directory starts as soon as its listing is ready, so pak indices are loaded while the
+// rest of the tree is still being scanned.
 
+struct CScanDirectory
+{
+	FString			Path;
 	struct FileInfo
 	{
-		FStaticString<256> Filename;	// short file name
-		int64 Size;						// file size
+		FString		Filename;				// short file name
+		int64		Size;					// file size
 	};
-
-	//todo: check - there's TArray<FStaticString> what's unsafe
 	TArray<FileInfo> Files;
-	Files.Empty(1024);
+	TArray<CScanDirectory*> SubDirs;
+	volatile int32	bClaimed;				// nonzero when some thread has taken this directory for listing
+	volatile int32	bListed;				// nonzero when Files and SubDirs are complete
+
+	CScanDirectory(const char* InPath)
+	: Path(InPath)
+	, bClaimed(0)
+	, bListed(0)
+	{}
+
+	// Returns true if the caller is the thread which should list this directory
+	bool Claim()
+	{
+#if THREADING
+		return InterlockedIncrement(&bClaimed) == 1;
+#else
+		return ++bClaimed == 1;
+#endif
+	}
+};
+
+struct CDirectoryScanner
+{
+	bool			bRecurse;
+	TArray<CScanDirectory*> AllDirs;		// owns all CScanDirectory objects
+	TArray<CScanDirectory*> Queue;			// directories waiting for listing, used as a stack
+#if THREADING
+	CMutex			Mutex;
+	volatile int32	NumPending;				// number of queued directories plus number of directories being listed by workers
+	volatile int32	bAborted;				// nonzero when registration has failed, workers should stop listing
+	CSemaphore		WorkSignal;				// signaled once per queued directory, and when all work is done
+	CSemaphore		ListedSignal;			// signaled when WaitingDir becomes listed
+	CScanDirectory*	WaitingDir;				// directory the main thread is waiting for, protected by Mutex
+	int				NumWorkers;				// when nonzero, all directories are listed by workers
+	// statistics
+	int				NumListedDirs;			// protected by Mutex
+	int				NumEarlyExits;			// number of workers which have stopped while some directories were not listed, protected by Mutex
+	volatile int32	NumListingWorkers;		// number of workers which have listed at least one directory
+	int				NumMainListed;			// number of directories listed by the main thread
+#endif
+
+	CDirectoryScanner(bool InRecurse)
+	: bRecurse(InRecurse)
+#if THREADING
+	, NumPending(0)
+	, bAborted(0)
+	, WaitingDir(NULL)
+	, NumWorkers(0)
+	, NumListedDirs(0)
+	, NumEarlyExits(0)
+	, NumListingWorkers(0)
+	, NumMainListed(0)
+#endif
+	{}
+
+	~CDirectoryScanner()
+	{
+		for (CScanDirectory* Dir : AllDirs)
+			delete Dir;
+	}
+
+	CScanDirectory* AddDirectory(const char* Path)
+	{
+		CScanDirectory* Dir = new CScanDirectory(Path);
+#if THREADING
+		CMutex::ScopedLock Lock(Mutex);
+#endif
+		AllDirs.Add(Dir);
+		return Dir;
+	}
+
+	void ListDirectory(CScanDirectory* Dir);
+	void WaitForListing(CScanDirectory* Dir);
+	void RegisterDirectory(CScanDirectory* Dir);
+#if THREADING
+	int StartWorkers(CScanDirectory* Root, CSemaphore& Fence);
+	static void WorkerThread(void* Data);
+#endif
+};
 
-	guard(ReadDir);
+void CDirectoryScanner::ListDirectory(CScanDirectory* Dir)
+{
+	guard(ListDirectory);
+
+	const char* dir = *Dir->Path;
+	char Path[MAX_PACKAGE_PATH];
+	Dir->Files.Empty(256);
 
 #if _WIN32
 	appSprintf(ARRAY_ARG(Path), "%s/*.*", dir);
 	_finddatai64_t found;
 	intptr_t hFind = _findfirsti64(Path, &found);
-	if (hFind == -1) return true;
-	do
+	if (hFind != -1)
 	{
-		if (found.name[0] == '.') continue;			// "." or ".."
-		// directory -> recurse
-		if (found.attrib & _A_SUBDIR)
+		do
 		{
-			if (recurse)
+			if (found.name[0] == '.') continue;			// "." or ".."
+			// directory -> recurse
+			if (found.attrib & _A_SUBDIR)
 			{
-				appSprintf(ARRAY_ARG(Path), "%s/%s", dir, found.name);
-				res = ScanGameDirectory(Path, recurse);
+				if (bRecurse)
+				{
+					appSprintf(ARRAY_ARG(Path), "%s/%s", dir, found.name);
+					Dir->SubDirs.Add(AddDirectory(Path));
+				}
 			}
-		}
-		else
+			else
+			{
+				CScanDirectory::FileInfo* File = new (Dir->Files) CScanDirectory::FileInfo;
+				File->Filename = found.name;
+				File->Size = found.size;
+			}
+		} while (_findnexti64(hFind, &found) != -1);
+		_findclose(hFind);
+	}
+#else
+	DIR *find = opendir(dir);
+	if (find)
+	{
+		struct dirent *ent;
+		while ((ent = readdir(find)))
 		{
-			Files.Add( { found.name, found.size } );
+			if (ent->d_name[0] == '.') continue;			// "." or ".."
+			bool IsDirectory;
+			int64 Size = 0;
+			if (ent->d_type == DT_DIR)
+			{
+				// File type is known from directory entry, no need to call stat()
+				IsDirectory = true;
+			}
+			else
+			{
+				// Regular file (we need its size) or unknown file type (DT_UNKNOWN, DT_LNK).
+				// note: using 'stat64' here because 'stat' ignores large files; fstatat avoids
+				// resolving the whole path for every file.
+				struct stat64 buf;
+				if (fstatat64(dirfd(find), ent->d_name, &buf, 0) < 0) continue;	// or break?
+				IsDirectory = S_ISDIR(buf.st_mode);
+				Size = buf.st_size;
+			}
+			if (IsDirectory)
+			{
+				if (bRecurse)
+				{
+					appSprintf(ARRAY_ARG(Path), "%s/%s", dir, ent->d_name);
+					Dir->SubDirs.Add(AddDirectory(Path));
+				}
+			}
+			else
+			{
+				CScanDirectory::FileInfo* File = new (Dir->Files) CScanDirectory::FileInfo;
+				File->Filename = ent->d_name;
+				File->Size = Size;
+			}
 		}
-	} while (res && _findnexti64(hFind, &found) != -1);
-	_findclose(hFind);
+		closedir(find);
+	}
+#endif
+
+	// Register files in sorted order - should be done for pak files, so patches will work.
+	// Subdirectories are sorted too, so registration order doesn't depend on file system.
+	Dir->Files.Sort([](const CScanDirectory::FileInfo& p1, const CScanDirectory::FileInfo& p2) -> int
+		{
+			return stricmp(*p1.Filename, *p2.Filename);
+		});
+	Dir->SubDirs.Sort([](CScanDirectory* const& p1, CScanDirectory* const& p2) -> int
+		{
+			return stricmp(*p1->Path, *p2->Path);
+		});
+
+#if THREADING
+	int NumSubDirs = Dir->SubDirs.Num();
+	{
+		// Put subdirectories to the queue in reverse order, so the first one will be picked first,
+		// in the same order as RegisterDirectory will request them. The mutex also makes all data
+		// written above visible to the thread which waits for this directory.
+		CMutex::ScopedLock Lock(Mutex);
+		for (int i = NumSubDirs - 1; i >= 0; i--)
+			Queue.Add(Dir->SubDirs[i]);
+		InterlockedAdd(&NumPending, NumSubDirs);
+		Dir->bListed = 1;
+		NumListedDirs++;
+		if (WaitingDir == Dir)
+			ListedSignal.Signal();
+	}
+	for (int i = 0; i < NumSubDirs; i++)
+		WorkSignal.Signal();
 #else
-	DIR *find = opendir(dir);
-	if (!find) return true;
-	struct dirent *ent;
-	while (/*res &&*/ (ent = readdir(find)))
-	{
-		if (ent->d_name[0] == '.') continue;			// "." or ".."
-		appSprintf(ARRAY_ARG(Path), "%s/%s", dir, ent->d_name);
-		// directory -> recurse
-		// note: using 'stat64' here because 'stat' ignores large files
-		struct stat64 buf;
-		if (stat64(Path, &buf) < 0) continue;			// or break?
-		if (S_ISDIR(buf.st_mode))
+	Dir->bListed = 1;
+#endif
+
+	unguardf("%s", *Dir->Path);
+}
+
+#if THREADING
+
+// Queue the root directory and spawn listing workers, returns the number of started workers
+int CDirectoryScanner::StartWorkers(CScanDirectory* Root, CSemaphore& Fence)
+{
+	Queue.Add(Root);
+	NumPending = 1;
+	WorkSignal.Signal();
+	int MaxWorkers = CThread::GetLogicalCPUCount();
+	for (NumWorkers = 0; NumWorkers < MaxWorkers; NumWorkers++)
+	{
+		if (!ThreadPool::ExecuteInThread(WorkerThread, this, &Fence))
+			break;
+	}
+	return NumWorkers;
+}
+
+void CDirectoryScanner::WorkerThread(void* Data)
+{
+	CDirectoryScanner* Scanner = (CDirectoryScanner*)Data;
+	int NumListed = 0;
+	while (true)
+	{
+		Scanner->WorkSignal.Wait();
+		CScanDirectory* Dir = NULL;
+		{
+			CMutex::ScopedLock Lock(Scanner->Mutex);
+			int Last = Scanner->Queue.Num() - 1;
+			if (Last >= 0)
+			{
+				Dir = Scanner->Queue[Last];
+				Scanner->Queue.RemoveAt(Last);
+			}
+		}
+		if (!Dir)
 		{
-			if (recurse)
-				res = ScanGameDirectory(Path, recurse);
+			// Every queued directory has its own signal, so an empty queue means that all work is done.
+			// Pass the signal to the next worker.
+			Scanner->WorkSignal.Signal();
+			CMutex::ScopedLock Lock(Scanner->Mutex);
+			if (!Scanner->bAborted && Scanner->NumListedDirs != Scanner->AllDirs.Num())
+				Scanner->NumEarlyExits++;
+			break;
 		}
-		else
+		if (!Scanner->bAborted && Dir->Claim())
+		{
+			Scanner->ListDirectory(Dir);
+			NumListed++;
+		}
+		if (InterlockedDecrement(&Scanner->NumPending) == 0)
+		{
+			// No directory is queued or being listed, so no more work will appear: wake up the workers
+			Scanner->WorkSignal.Signal();
+		}
+	}
+	if (NumListed)
+		InterlockedIncrement(&Scanner->NumListingWorkers);
+}
+
+#endif // THREADING
+
+void CDirectoryScanner::WaitForListing(CScanDirectory* Dir)
+{
+#if THREADING
+	// Directories are never claimed here when workers are running: a worker which pops a directory listed
+	// by this thread would release its NumPending reference while subdirectories are not queued yet, and
+	// workers could stop before the whole tree is listed.
+	if (!NumWorkers)
+	{
+		if (Dir->Claim())
 		{
-			Files.Add( { ent->d_name, buf.st_size } );
+			ListDirectory(Dir);
+			NumMainListed++;
 		}
+		return;
 	}
-	closedir(find);
+	{
+		CMutex::ScopedLock Lock(Mutex);
+		if (Dir->bListed) return;
+		WaitingDir = Dir;
+	}
+	ListedSignal.Wait();
+	CMutex::ScopedLock Lock(Mutex);
+	WaitingDir = NULL;
+#else
+	if (Dir->Claim())
+		ListDirectory(Dir);
+#endif
+}
+
+void CDirectoryScanner::RegisterDirectory(CScanDirectory* Dir)
+{
+	guard(RegisterDirectory);
+
+	WaitForListing(Dir);
+
+	// Subdirectories are registered before files of the current directory
+	for (CScanDirectory* SubDir : Dir->SubDirs)
+		RegisterDirectory(SubDir);
+
+	char Path[MAX_PACKAGE_PATH];
+	int NumFiles = Dir->Files.Num();
+
+#if UNREAL4
+	TArray<CPreloadedPak> Preloaded;
+	// Load indices of all pak files in this directory in parallel. Files are registered below in
+	// sorted order, so patch paks will override files from base paks as before.
+	TArray<int> PakFiles;
+	for (int i = 0; i < NumFiles; i++)
+	{
+		const char* ext = strrchr(*Dir->Files[i].Filename, '.');
+		if (ext && !stricmp(ext, ".pak"))
+			PakFiles.Add(i);
+	}
+	if (PakFiles.Num() > 1)
+	{
+		Preloaded.AddZeroed(NumFiles);
+	#if THREADING
+		ThreadPool::CTaskGroup Tasks;
+	#endif
+		for (int FileIndex : PakFiles)
+		{
+			auto Load = [Dir, FileIndex, &Preloaded]()
+			{
+				char PakPath[MAX_PACKAGE_PATH];
+				const CScanDirectory::FileInfo& File = Dir->Files[FileIndex];
+				appSprintf(ARRAY_ARG(PakPath), "%s/%s", *Dir->Path, *File.Filename);
+	#if THREADING
+				TryPreloadPakFile(PakPath, File.Size, Preloaded[FileIndex]);
+	#else
+				PreloadPakFile(PakPath, File.Size, Preloaded[FileIndex]);
+	#endif
+			};
+	#if THREADING
+			Tasks.Run(MoveTemp(Load));
+	#else
+			Load();
+	#endif
+		}
+	#if THREADING
+		Tasks.Wait();
+	#endif
+	}
+#endif // UNREAL4
+
+	for (int i = 0; i < NumFiles; i++)
+	{
+		const CScanDirectory::FileInfo& File = Dir->Files[i];
+		appSprintf(ARRAY_ARG(Path), "%s/%s", *Dir->Path, *File.Filename);
+		CPreloadedPak* Pak = NULL;
+#if UNREAL4
+		if (Preloaded.Num()) Pak = &Preloaded[i];
 #endif
+		RegisterGameFile(Path, File.Size, Pak);
+	}
 
 	unguard;
+}
 
-	// Register files in sorted order - should be done for pak files, so patches will work.
-	Files.Sort([](const FileInfo& p1, const FileInfo& p2) -> int
+#if THREADING
+
+// Returns false if registration has failed, GError holds the error then
+static bool TryRegisterDirectory(CDirectoryScanner& Scanner, CScanDirectory* Root)
+{
+	TRY {
+		Scanner.RegisterDirectory(Root);
+		return true;
+	} CATCH {
+		return false;
+	}
+}
+
+#endif // THREADING
+
+static void ScanGameDirectory(const char *dir, bool recurse)
+{
+	guard(ScanGameDirectory);
+
+	CDirectoryScanner Scanner(recurse);
+	CScanDirectory* Root = Scanner.AddDirectory(dir);
+
+#if THREADING
+	// Spawn directory listing workers. The root directory is listed by the first worker,
+	// or by this thread if no threads are available.
+	CSemaphore Fence;
+	int NumWorkers = 0;
+	if (recurse)
+		NumWorkers = Scanner.StartWorkers(Root, Fence);
+
+	bool bRegistered = TryRegisterDirectory(Scanner, Root);
+	if (!bRegistered)
+		Scanner.bAborted = 1;
+
+	// Workers could still be active, wait for them before releasing Scanner, even when registration has failed
+	for (int i = 0; i < NumWorkers; i++)
+		Fence.Wait();
+
+	if (!bRegistered)
+		THROW;
+#else
+	Scanner.RegisterDirectory(Root);
+#endif // THREADING
+
+	unguard;
+}
+
+// Walk the directory tree in registration order without registering files, used by -bench=scan
+static void ListDirectoryTree(CDirectoryScanner& Scanner, CScanDirectory* Dir, TArray<FString>& Paths)
+{
+	Scanner.WaitForListing(Dir);
+	new (Paths) FString(*Dir->Path);
+	for (CScanDirectory* SubDir : Dir->SubDirs)
+		ListDirectoryTree(Scanner, SubDir, Paths);
+	char Path[MAX_PACKAGE_PATH];
+	for (const CScanDirectory::FileInfo& File : Dir->Files)
+	{
+		appSprintf(ARRAY_ARG(Path), "%s/%s %X%08X", *Dir->Path, *File.Filename, (uint32)(File.Size >> 32), (uint32)File.Size);
+		new (Paths) FString(Path);
+	}
+}
+
+bool BenchmarkDirectoryScanner(const char* dir)
+{
+	guard(BenchmarkDirectoryScanner);
+
+	appPrintf("Verifying parallel directory scanner with serial listing of %s\n", dir);
+
+	// Pass 0 lists all directories in this thread, pass 1 uses workers
+	TArray<FString> Paths[2];
+	char Result[2][32];
+	int NumDirs = 0, MaxSubDirs = 0;
+	int NumWorkers = 0, NumListingWorkers = 0, NumEarlyExits = 0, NumMainListed = 0;
+	for (int Pass = 0; Pass < 2; Pass++)
+	{
+		CDirectoryScanner Scanner(true);
+		CScanDirectory* Root = Scanner.AddDirectory(dir);
+		int StartTime = appMilliseconds();
+#if THREADING
+		CSemaphore Fence;
+		int NumStarted = 0;
+		if (Pass == 1)
+			NumStarted = Scanner.StartWorkers(Root, Fence);
+		ListDirectoryTree(Scanner, Root, Paths[Pass]);
+		for (int i = 0; i < NumStarted; i++)
+			Fence.Wait();
+		if (Pass == 1)
 		{
-			return stricmp(*p1.Filename, *p2.Filename);
-		});
+			NumWorkers = NumStarted;
+			NumListingWorkers = Scanner.NumListingWorkers;
+			NumEarlyExits = Scanner.NumEarlyExits;
+			NumMainListed = Scanner.NumMainListed;
+		}
+#else
+		if (Pass == 1)
+		{
+			appStrncpyz(Result[Pass], "-", ARRAY_COUNT(Result[Pass]));
+			break;
+		}
+		ListDirectoryTree(Scanner, Root, Paths[Pass]);
+#endif // THREADING
+		appSprintf(ARRAY_ARG(Result[Pass]), "%d ms", appMilliseconds() - StartTime);
+		NumDirs = Scanner.AllDirs.Num();
+		for (const CScanDirectory* Dir : Scanner.AllDirs)
+			MaxSubDirs = max(MaxSubDirs, Dir->SubDirs.Num());
+	}
 
-	for (const FileInfo& File : Files)
+	bool bIdentical = true;
+#if THREADING
+	if (Paths[1].Num() != Paths[0].Num())
 	{
-		appSprintf(ARRAY_ARG(Path), "%s/%s", dir, *File.Filename);
-		RegisterGameFile(Path, File.Size);
+		bIdentical = false;
 	}
+	else
+	{
+		for (int i = 0; i < Paths[0].Num(); i++)
+		{
+			if (strcmp(*Paths[0][i], *Paths[1][i]) != 0)
+			{
+				bIdentical = false;
+				break;
+			}
+		}
+	}
+	if (!bIdentical)
+		appStrncpyz(Result[1], "MISMATCH", ARRAY_COUNT(Result[1]));
+#endif // THREADING
+
+	appPrintf("%8s %8s %10s %10s\n", "Dirs", "Entries", "serial", "parallel");
+	appPrintf("%8d %8d %10s %10s\n", NumDirs, Paths[0].Num(), Result[0], Result[1]);
+
+	appPrintf(bIdentical ? "Directory scanner: all results are identical to serial listing\n" : "Directory scanner: MISMATCH found\n");
+	bool bResult = bIdentical;
+
+#if THREADING
+	appPrintf("%d workers started, %d of them listed directories, %d directories listed by the main thread\n",
+		NumWorkers, NumListingWorkers, NumMainListed);
+	// Workers should not stop before the whole tree is listed, and several workers should take part
+	// in listing when the tree is large and wide enough
+	if (NumEarlyExits)
+	{
+		appPrintf("Directory scanner: %d workers stopped before listing was complete\n", NumEarlyExits);
+		bResult = false;
+	}
+	if (NumWorkers >= 2 && NumDirs >= 64 && MaxSubDirs >= NumWorkers && NumListingWorkers < 2)
+	{
+		appPrintf("Directory scanner: listing was not done in parallel\n");
+		bResult = false;
+	}
+#endif // THREADING
 
-	return res;
+	return bResult;
 
 	unguard;
 }
@@ -799,7 +1589,13 @@ void appSetRootDirectory(const char *dir, bool recurse)
 
 	if (dir[0] == 0) dir = ".";	// using dir="" will cause scanning of "/dir1", "/dir2" etc (i.e. drive root)
 	appStrncpyz(GRootDirectory, dir, ARRAY_COUNT(GRootDirectory));
+#if UNREAL4
+	LoadGameIndex();
+#endif
 	ScanGameDirectory(GRootDirectory, recurse);
+#if UNREAL4
+	FinishGameIndexLoading();
+#endif
 
 #if GEARS4
 	if (GForceGame == GAME_Gears4)
@@ -1296,12 +2092,12 @@ FArchive* CGameFileInfo::CreateReader(bool bDontCrash) const
 		appSprintf(ARRAY_ARG(buf), "%s/%s", GRootDirectory, *RelativeName);
 		if (!bDontCrash)
 		{
-			return new FFileReader(buf);
+			return appCreateFileReader(buf, EFileArchiveOptions::Default, Size);
 		}
 		else
 		{
 			// "Safe" mode
-			FArchive* Reader = new FFileReader(buf, EFileArchiveOptions::OpenWarning);
+			FArchive* Reader = appCreateFileReader(buf, EFileArchiveOptions::OpenWarning, Size);
 			if (!Reader->IsOpen())
 			{
 				delete Reader;
@@ -31,6 +31,11 @@ public:
 	virtual bool AttachReader(FArchive* reader, FString& error) = 0;
 	// Open a file from VFS.
 	virtual FArchive* CreateReader(int index) = 0;
+	// Return true if files of this VFS could be read from different threads at the same time
+	virtual bool AllowsConcurrentReads() const
+	{
+		return false;
+	}
 
 	// Reserve space for 'count' files
 	void Reserve(int count);
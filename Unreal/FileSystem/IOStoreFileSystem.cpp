@@ -301,6 +301,8 @@ FIOStoreFile::FIOStoreFile(int InFileIndex, FIOStoreFileSystem* InParent)
 :	Parent(InParent)
 ,	FileIndex(InFileIndex)
 ,	UncompressedBuffer(NULL)
+,	CompressedBuffer(NULL)
+,	CompressedBufferCapacity(0)
 ,	IsFileOpen(true)
 {
 	const FIoOffsetAndLength& OffsetAndLength = Parent->ChunkLocations[FileIndex];
@@ -321,6 +323,12 @@ void FIOStoreFile::Close()
 		appFree(UncompressedBuffer);
 		UncompressedBuffer = NULL;
 	}
+	if (CompressedBuffer)
+	{
+		appFree(CompressedBuffer);
+		CompressedBuffer = NULL;
+		CompressedBufferCapacity = 0;
+	}
 	if (IsFileOpen)
 	{
 //		Parent->FileClosed();
@@ -353,64 +361,44 @@ void FIOStoreFile::Serialize(void *data, int size)
 		IsFileOpen = true;
 	}
 
-	FArchive* Reader = Parent->Reader;
-
 	// References:
 	// - FIoStoreReaderImpl::Read() - simpler implementation
 	// - FFileIoStore::ReadBlocks() - more complex asynchronous reading, doing the same
+	int BlockSize = Parent->CompressionBlockSize;
 	while (size > 0)
 	{
-		if ((UncompressedBuffer == NULL) || (ArPos < UncompressedBufferPos) || (ArPos >= UncompressedBufferPos + Parent->CompressionBlockSize))
+		int64 ContainerPos = UncompressedOffset + ArPos;
+		int BlockIndex = int(ContainerPos / BlockSize);
+		bool bBuffered = (UncompressedBuffer != NULL) && (ArPos >= UncompressedBufferPos) && (ArPos < UncompressedBufferPos + BlockSize);
+		if (!bBuffered && (ContainerPos % BlockSize) == 0)
+		{
+			int UncompressedBlockSize = Parent->CompressionBlocks[BlockIndex].GetUncompressedSize();
+			if (size >= UncompressedBlockSize)
+			{
+				// The request covers the whole block: decode it directly into the caller's memory
+				ReadBlock(BlockIndex, (byte*)data);
+
+				ArPos += UncompressedBlockSize;
+				size  -= UncompressedBlockSize;
+				data  = OffsetPointer(data, UncompressedBlockSize);
+				continue;
+			}
+		}
+
+		if (!bBuffered)
 		{
 			// buffer is not ready
 			if (UncompressedBuffer == NULL)
 			{
-				UncompressedBuffer = (byte*)appMallocNoInit(Parent->CompressionBlockSize); // size of uncompressed block
+				UncompressedBuffer = (byte*)appMallocNoInit(BlockSize); // size of uncompressed block
 			}
 			// prepare buffer
-			int BlockIndex = int((UncompressedOffset + ArPos) / Parent->CompressionBlockSize);
-			UncompressedBufferPos = int(int64(Parent->CompressionBlockSize) * BlockIndex - UncompressedOffset);
-
-			const FIoStoreTocCompressedBlockEntry& Block = Parent->CompressionBlocks[BlockIndex];
-			int CompressedBlockSize = Block.GetCompressedSize();
-			int UncompressedBlockSize = Block.GetUncompressedSize();
-			byte* CompressedData;
-			if (!(Parent->ContainerFlags & int(EIoContainerFlags::Encrypted)))
-			{
-				CompressedData = (byte*)appMallocNoInit(CompressedBlockSize);
-				Reader->Seek64(Block.GetOffset());
-				Reader->Serialize(CompressedData, CompressedBlockSize);
-			}
-			else
-			{
-				int EncryptedSize = Align(CompressedBlockSize, EncryptionAlign);
-				CompressedData = (byte*)appMallocNoInit(EncryptedSize);
-				Reader->Seek64(Block.GetOffset());
-				Reader->Serialize(CompressedData, EncryptedSize);
-				FileRequiresAesKey();
-				Parent->DecryptDataBlock(CompressedData, EncryptedSize);
-			}
-			uint32 CompressionMethodIndex = Block.GetCompressionMethodIndex();
-			if (CompressionMethodIndex)
-			{
-				// Compressed data
-				assert(CompressionMethodIndex <= Parent->NumCompressionMethods); // 0 = None is not counted, so "<=" is used here
-				int CompressionFlags = Parent->CompressionMethods[CompressionMethodIndex];
-				appDecompress(CompressedData, CompressedBlockSize, UncompressedBuffer, UncompressedBlockSize, CompressionFlags);
-				appFree(CompressedData);
-			}
-			else
-			{
-				// Uncompressed data
-				//todo: don't allocate 'CompressedData' and don't 'memcpy', read directly to 'UncompressedBuffer'
-				assert(CompressedBlockSize == UncompressedBlockSize);
-				memcpy(UncompressedBuffer, CompressedData, UncompressedBlockSize);
-				appFree(CompressedData);
-			}
+			UncompressedBufferPos = int(int64(BlockSize) * BlockIndex - UncompressedOffset);
+			ReadBlock(BlockIndex, UncompressedBuffer);
 		}
 
 		// data is in buffer, copy it
-		int BytesToCopy = UncompressedBufferPos + Parent->CompressionBlockSize - ArPos; // number of bytes until end of the buffer
+		int BytesToCopy = UncompressedBufferPos + BlockSize - ArPos; // number of bytes until end of the buffer
 		if (BytesToCopy > size) BytesToCopy = size;
 		assert(BytesToCopy > 0);
 
@@ -427,6 +415,84 @@ void FIOStoreFile::Serialize(void *data, int size)
 	unguard;
 }
 
+void FIOStoreFile::ReadBlock(int BlockIndex, byte* Dst)
+{
+	guard(FIOStoreFile::ReadBlock);
+
+	FArchive* Reader = Parent->Reader;
+
+	const FIoStoreTocCompressedBlockEntry& Block = Parent->CompressionBlocks[BlockIndex];
+	int CompressedBlockSize = Block.GetCompressedSize();
+	int UncompressedBlockSize = Block.GetUncompressedSize();
+	uint32 CompressionMethodIndex = Block.GetCompressionMethodIndex();
+	bool bEncrypted = (Parent->ContainerFlags & int(EIoContainerFlags::Encrypted)) != 0;
+	// Plain uncompressed blocks are not cached: reading them is as fast as copying from the cache
+	bool bUseCache = CompressionMethodIndex || bEncrypted;
+	if (bUseCache && GetCachedBlock(Parent, Block.GetOffset(), Dst, UncompressedBlockSize))
+	{
+		// The block was taken from the cache
+		return;
+	}
+
+	if (!CompressionMethodIndex && !bEncrypted)
+	{
+		// Plain uncompressed data: read directly to the destination
+		assert(CompressedBlockSize == UncompressedBlockSize);
+		if (const byte* Src = Reader->GetDirectPointer(Block.GetOffset(), UncompressedBlockSize))
+		{
+			memcpy(Dst, Src, UncompressedBlockSize);
+		}
+		else
+		{
+			Reader->Seek64(Block.GetOffset());
+			Reader->Serialize(Dst, UncompressedBlockSize);
+		}
+		return;
+	}
+
+	const byte* CompressedData = NULL;
+	if (!bEncrypted)
+	{
+		// Decompress directly from the reader's memory when possible
+		CompressedData = Reader->GetDirectPointer(Block.GetOffset(), CompressedBlockSize);
+	}
+	if (!CompressedData)
+	{
+		int ReadSize = bEncrypted ? Align(CompressedBlockSize, EncryptionAlign) : CompressedBlockSize;
+		if (CompressedBufferCapacity < ReadSize)
+		{
+			if (CompressedBuffer) appFree(CompressedBuffer);
+			CompressedBufferCapacity = ReadSize;
+			CompressedBuffer = (byte*)appMallocNoInit(CompressedBufferCapacity);
+		}
+		Reader->Seek64(Block.GetOffset());
+		Reader->Serialize(CompressedBuffer, ReadSize);
+		if (bEncrypted)
+		{
+			FileRequiresAesKey();
+			Parent->DecryptDataBlock(CompressedBuffer, ReadSize);
+		}
+		CompressedData = CompressedBuffer;
+	}
+
+	if (CompressionMethodIndex)
+	{
+		// Compressed data
+		assert(CompressionMethodIndex <= Parent->NumCompressionMethods); // 0 = None is not counted, so "<=" is used here
+		int CompressionFlags = Parent->CompressionMethods[CompressionMethodIndex];
+		appDecompress(const_cast<byte*>(CompressedData), CompressedBlockSize, Dst, UncompressedBlockSize, CompressionFlags);
+	}
+	else
+	{
+		// Uncompressed encrypted data
+		assert(CompressedBlockSize == UncompressedBlockSize);
+		memcpy(Dst, CompressedData, UncompressedBlockSize);
+	}
+	PutCachedBlock(Parent, Block.GetOffset(), Dst, UncompressedBlockSize);
+
+	unguardf("block=%d", BlockIndex);
+}
+
 /*-----------------------------------------------------------------------------
 	FPackageId to CGameFileInfo map
 -----------------------------------------------------------------------------*/
@@ -498,6 +564,7 @@ FIOStoreFileSystem::FIOStoreFileSystem(const char* InFilename, bool InIsGlobalCo
 
 FIOStoreFileSystem::~FIOStoreFileSystem()
 {
+	PurgeCachedBlocks(this);
 	delete Reader;
 }
 
@@ -537,7 +604,7 @@ bool FIOStoreFileSystem::AttachReader(FArchive* reader, FString& error)
 	appStrncpyz(ContainerFileName, *Filename, ARRAY_COUNT(ContainerFileName));
 	char* ext = strrchr(ContainerFileName, '.') + 1;
 	strcpy(ext, "ucas");
-	FArchive* ContainerFile = new FFileReader(ContainerFileName, EFileArchiveOptions::NoOpenError);
+	FArchive* ContainerFile = appCreateFileReader(ContainerFileName, EFileArchiveOptions::NoOpenError);
 	if (!ContainerFile->IsOpen())
 	{
 		delete ContainerFile;
@@ -57,8 +57,13 @@ protected:
 	// Data for decompression
 	byte*		UncompressedBuffer;
 	int			UncompressedBufferPos;	// buffer's position inside the chunk
+	byte*		CompressedBuffer;		// scratch memory for compressed or encrypted block, reused between reads
+	int			CompressedBufferCapacity;
 
 	bool		IsFileOpen;
+
+	// Read and decompress a single compression block into Dst, which should fit the whole uncompressed block
+	void ReadBlock(int BlockIndex, byte* Dst);
 };
 
 class FIOStoreFileSystem : public FVirtualFileSystem
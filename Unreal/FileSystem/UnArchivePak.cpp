@@ -5,6 +5,8 @@
 
 #include "UnArchivePak.h"
 
+#include "Parallel.h"
+
 #if UNREAL4
 
 #define PAK_FILE_MAGIC		0x5A6F12E1
@@ -14,6 +16,16 @@
 // of pak files exceeding C library limitations (2048 files in msvcrt.dll).
 #define MAX_OPEN_PAKS		32
 
+int GPakReadAheadBlocks = 16;
+
+#if THREADING
+// Pak files could be read from multiple threads (for example, with ScanContent). FPakVFS::Reader is shared
+// between all files of the pak, so Seek+Serialize pairs are serialized with FPakVFS::ReaderMutex. Open/close
+// bookkeeping affects all paks (VFSWithOpenReaders), so it uses a global lock. Reading with GetDirectPointer()
+// doesn't change the reader's state and doesn't need the lock.
+static CMutex GPakOpenFilesMutex;
+#endif
+
 FArchive& operator<<(FArchive& Ar, FPakInfo& P)
 {
 	// New FPakInfo fields.
@@ -286,6 +298,13 @@ void FPakEntry::DecodeFrom(const uint8* Data)
 	unguard;
 }
 
+FPakVFS::~FPakVFS()
+{
+	PurgeCachedBlocks(this);
+	delete Reader;
+//	if (HashTable) delete[] HashTable;
+}
+
 FPakFile::~FPakFile()
 {
 	// Can't call virtual 'Close' from destructor, so use fully qualified name
@@ -298,7 +317,15 @@ void FPakFile::Close()
 	{
 		appFree(UncompressedBuffer);
 		UncompressedBuffer = NULL;
+		UncompressedBufferSize = UncompressedBufferCapacity = 0;
 	}
+	if (CompressedBuffer)
+	{
+		appFree(CompressedBuffer);
+		CompressedBuffer = NULL;
+		CompressedBufferCapacity = 0;
+	}
+	DecodedEnd = -1;
 	if (IsFileOpen)
 	{
 		Parent->FileClosed();
@@ -306,6 +333,122 @@ void FPakFile::Close()
 	}
 }
 
+int FPakFile::DecompressBlocks(int BlockIndex, int NumBlocks, byte* Dst)
+{
+	guard(FPakFile::DecompressBlocks);
+
+	FArchive* Reader = Parent->Reader;
+	int BlockSize = Info->CompressionBlockSize;
+	int Alignment = Info->bEncrypted ? EncryptionAlign : 1;
+	const FPakCompressedBlock* Blocks = &Info->CompressionBlocks[BlockIndex];
+
+	// Compressed blocks are expected to follow each other, but verify that: blocks are decrypted
+	// in place, so they must not overlap
+	for (int i = 1; i < NumBlocks; i++)
+	{
+		const FPakCompressedBlock& Prev = Blocks[i-1];
+		if (Blocks[i].CompressedStart < Prev.CompressedStart + Align(Prev.CompressedEnd - Prev.CompressedStart, Alignment))
+		{
+			NumBlocks = i;
+			break;
+		}
+	}
+
+	int DataStart = BlockSize * BlockIndex;
+	int DataSize = min(BlockSize * NumBlocks, (int)Info->UncompressedSize - DataStart); // don't pass file end
+
+	// Serve blocks from the cache when possible
+	int NumCachedBlocks = 0;
+	while (NumCachedBlocks < NumBlocks)
+	{
+		int Offset = NumCachedBlocks * BlockSize;
+		if (!GetCachedBlock(Parent, Blocks[NumCachedBlocks].CompressedStart, Dst + Offset, min(BlockSize, DataSize - Offset)))
+			break;
+		NumCachedBlocks++;
+	}
+	if (NumCachedBlocks)
+	{
+		return min(DataSize, NumCachedBlocks * BlockSize);
+	}
+
+	// Read compressed data for all blocks with a single call
+	int64 ReadStart = Blocks[0].CompressedStart;
+	int ReadSize = (int)(Blocks[NumBlocks-1].CompressedStart - ReadStart) + Align((int)(Blocks[NumBlocks-1].CompressedEnd - Blocks[NumBlocks-1].CompressedStart), Alignment);
+	// Unencrypted data is decompressed directly from the reader's memory when possible. Note: pak files
+	// are UE4-only, so appDecompress won't modify source data (in-place decryption is used by UE3 games).
+	byte* CompressedData = Info->bEncrypted ? NULL : const_cast<byte*>(Reader->GetDirectPointer(ReadStart, ReadSize));
+	if (!CompressedData)
+	{
+		if (CompressedBufferCapacity < ReadSize)
+		{
+			if (CompressedBuffer) appFree(CompressedBuffer);
+			CompressedBufferCapacity = ReadSize;
+			CompressedBuffer = (byte*)appMallocNoInit(CompressedBufferCapacity);
+		}
+		CompressedData = CompressedBuffer;
+	#if THREADING
+		CMutex::ScopedLock Lock(Parent->ReaderMutex);
+	#endif
+		Reader->Seek64(ReadStart);
+		Reader->Serialize(CompressedData, ReadSize);
+	}
+	if (Info->bEncrypted)
+	{
+		FileRequiresAesKey();
+	}
+
+#if PROFILE
+	int StartTime = appMilliseconds();
+#endif
+
+	auto DecompressBlock = [this, Blocks, CompressedData, ReadStart, Alignment, BlockSize, Dst, DataSize](int i)
+	{
+		const FPakCompressedBlock& Block = Blocks[i];
+		byte* BlockData = CompressedData + (Block.CompressedStart - ReadStart);
+		int CompressedBlockSize = (int)(Block.CompressedEnd - Block.CompressedStart);
+		int UncompressedBlockSize = min(BlockSize, DataSize - i * BlockSize);
+		if (Info->bEncrypted)
+		{
+			Parent->DecryptDataBlock(BlockData, Align(CompressedBlockSize, Alignment));
+		}
+		appDecompress(BlockData, CompressedBlockSize, Dst + i * BlockSize, UncompressedBlockSize, Info->CompressionMethod);
+		PutCachedBlock(Parent, Block.CompressedStart, Dst + i * BlockSize, UncompressedBlockSize);
+	};
+
+	// Decode the first block in the current thread: this will also make compression method
+	// detection (COMPRESS_FIND) happen before other threads could use it.
+	DecompressBlock(0);
+	if (NumBlocks > 1)
+	{
+		ParallelFor(NumBlocks - 1, [&DecompressBlock](int i) { DecompressBlock(i + 1); });
+	}
+
+#if PROFILE
+	GNumDecompressBlocks += NumBlocks;
+	GDecompressBytes += DataSize;
+	GDecompressTime += appMilliseconds() - StartTime;
+#endif
+
+	return DataSize;
+
+	unguardf("block=%d/%d", BlockIndex, Info->CompressionBlocks.Num());
+}
+
+void FPakFile::ReadCompressedBlocks(int BlockIndex, int NumBlocks)
+{
+	int BlockSize = Info->CompressionBlockSize;
+	if (UncompressedBufferCapacity < BlockSize * NumBlocks)
+	{
+		if (UncompressedBuffer) appFree(UncompressedBuffer);
+		UncompressedBufferCapacity = BlockSize * NumBlocks;
+		UncompressedBuffer = (byte*)appMallocNoInit(UncompressedBufferCapacity);
+	}
+	UncompressedBufferPos = BlockSize * BlockIndex;
+	UncompressedBufferSize = 0; // invalidate the buffer in a case of decompression error
+	UncompressedBufferSize = DecompressBlocks(BlockIndex, NumBlocks, UncompressedBuffer);
+	DecodedEnd = UncompressedBufferPos + UncompressedBufferSize;
+}
+
 void FPakFile::Serialize(void *data, int size)
 {
 	PROFILE_IF(size >= 1024);
@@ -326,44 +469,49 @@ void FPakFile::Serialize(void *data, int size)
 	{
 		guard(SerializeCompressed);
 
+		int BlockSize = Info->CompressionBlockSize;
+		int MaxBlocks = max(GPakReadAheadBlocks, 1);
 		while (size > 0)
 		{
-			if ((UncompressedBuffer == NULL) || (ArPos < UncompressedBufferPos) || (ArPos >= UncompressedBufferPos + Info->CompressionBlockSize))
+			bool bBuffered = (UncompressedBuffer != NULL) && (ArPos >= UncompressedBufferPos) && (ArPos < UncompressedBufferPos + UncompressedBufferSize);
+			if (!bBuffered && (ArPos % BlockSize) == 0 && (size >= BlockSize || ArPos + size == Info->UncompressedSize))
+			{
+				// The request covers whole blocks (the last block may be cut by file end): decompress
+				// them directly into the caller's memory, bypassing UncompressedBuffer
+				int BlockIndex = ArPos / BlockSize;
+				int NumBlocks = (ArPos + size == Info->UncompressedSize) ? (size + BlockSize - 1) / BlockSize : size / BlockSize;
+				NumBlocks = min(NumBlocks, MaxBlocks);
+				int BytesDecoded = DecompressBlocks(BlockIndex, NumBlocks, (byte*)data);
+				assert(BytesDecoded > 0 && BytesDecoded <= size);
+
+				ArPos += BytesDecoded;
+				size  -= BytesDecoded;
+				data  = OffsetPointer(data, BytesDecoded);
+				DecodedEnd = ArPos;
+				continue;
+			}
+
+			if (!bBuffered)
 			{
 				// buffer is not ready
-				if (UncompressedBuffer == NULL)
+				int BlockIndex = ArPos / BlockSize;
+				int NumBlocks = 1;
+				if (GPakReadAheadBlocks > 1)
 				{
-					UncompressedBuffer = (byte*)appMallocNoInit((int)Info->CompressionBlockSize); // size of uncompressed block
+					// Detect sequential reading: if the request continues exactly at the end of previously
+					// decompressed data, read ahead GPakReadAheadBlocks blocks. Otherwise decode all blocks
+					// covered by the request at once.
+					int BlockStart = BlockSize * BlockIndex;
+					bool bSequential = (DecodedEnd == BlockStart);
+					NumBlocks = bSequential ? GPakReadAheadBlocks : (ArPos + size - BlockStart + BlockSize - 1) / BlockSize;
+					NumBlocks = min(NumBlocks, GPakReadAheadBlocks);
+					NumBlocks = min(NumBlocks, Info->CompressionBlocks.Num() - BlockIndex);
 				}
-				// prepare buffer
-				int BlockIndex = ArPos / Info->CompressionBlockSize;
-				UncompressedBufferPos = Info->CompressionBlockSize * BlockIndex;
-
-				const FPakCompressedBlock& Block = Info->CompressionBlocks[BlockIndex];
-				int CompressedBlockSize = (int)(Block.CompressedEnd - Block.CompressedStart);
-				int UncompressedBlockSize = min((int)Info->CompressionBlockSize, (int)Info->UncompressedSize - UncompressedBufferPos); // don't pass file end
-				byte* CompressedData;
-				if (!Info->bEncrypted)
-				{
-					CompressedData = (byte*)appMallocNoInit(CompressedBlockSize);
-					Reader->Seek64(Block.CompressedStart);
-					Reader->Serialize(CompressedData, CompressedBlockSize);
-				}
-				else
-				{
-					int EncryptedSize = Align(CompressedBlockSize, EncryptionAlign);
-					CompressedData = (byte*)appMallocNoInit(EncryptedSize);
-					Reader->Seek64(Block.CompressedStart);
-					Reader->Serialize(CompressedData, EncryptedSize);
-					FileRequiresAesKey();
-					Parent->DecryptDataBlock(CompressedData, EncryptedSize);
-				}
-				appDecompress(CompressedData, CompressedBlockSize, UncompressedBuffer, UncompressedBlockSize, Info->CompressionMethod);
-				appFree(CompressedData);
+				ReadCompressedBlocks(BlockIndex, NumBlocks);
 			}
 
 			// data is in buffer, copy it
-			int BytesToCopy = UncompressedBufferPos + Info->CompressionBlockSize - ArPos; // number of bytes until end of the buffer
+			int BytesToCopy = UncompressedBufferPos + UncompressedBufferSize - ArPos; // number of bytes until end of the buffer
 			if (BytesToCopy > size) BytesToCopy = size;
 			assert(BytesToCopy > 0);
 
@@ -391,17 +539,43 @@ void FPakFile::Serialize(void *data, int size)
 		}
 		while (size > 0)
 		{
-			if ((ArPos < UncompressedBufferPos) || (ArPos >= UncompressedBufferPos + EncryptedBufferSize))
+			bool bBuffered = (ArPos >= UncompressedBufferPos) && (ArPos < UncompressedBufferPos + EncryptedBufferSize);
+			if (!bBuffered && (ArPos & (EncryptionAlign - 1)) == 0 && size >= EncryptionAlign)
+			{
+				// Aligned request: read whole AES blocks into the caller's memory and decrypt them in place
+				int DirectSize = size & ~(EncryptionAlign - 1);
+				{
+				#if THREADING
+					CMutex::ScopedLock Lock(Parent->ReaderMutex);
+				#endif
+					Reader->Seek64(Info->Pos + Info->StructSize + ArPos);
+					Reader->Serialize(data, DirectSize);
+				}
+				FileRequiresAesKey();
+				Parent->DecryptDataBlock((byte*)data, DirectSize);
+
+				ArPos += DirectSize;
+				size  -= DirectSize;
+				data  = OffsetPointer(data, DirectSize);
+				continue;
+			}
+
+			if (!bBuffered)
 			{
 				// Should fetch block and decrypt it.
 				// Note: AES is block encryption, so we should always align read requests for correct decryption.
 				UncompressedBufferPos = ArPos & ~(EncryptionAlign - 1);
-				Reader->Seek64(Info->Pos + Info->StructSize + UncompressedBufferPos);
 				int RemainingSize = Info->Size - UncompressedBufferPos;
 				if (RemainingSize > EncryptedBufferSize)
 					RemainingSize = EncryptedBufferSize;
 				RemainingSize = Align(RemainingSize, EncryptionAlign); // align for AES, pak contains aligned data
-				Reader->Serialize(UncompressedBuffer, RemainingSize);
+				{
+				#if THREADING
+					CMutex::ScopedLock Lock(Parent->ReaderMutex);
+				#endif
+					Reader->Seek64(Info->Pos + Info->StructSize + UncompressedBufferPos);
+					Reader->Serialize(UncompressedBuffer, RemainingSize);
+				}
 				FileRequiresAesKey();
 				Parent->DecryptDataBlock(UncompressedBuffer, RemainingSize);
 			}
@@ -428,10 +602,21 @@ void FPakFile::Serialize(void *data, int size)
 		guard(SerializeUncompressed);
 
 		// Pure data
-		// seek every time in a case if the same 'Reader' was used by different FPakFile
-		// (this is a lightweight operation for buffered FArchive)
-		Reader->Seek64(Info->Pos + Info->StructSize + ArPos);
-		Reader->Serialize(data, size);
+		int64 ReadPos = Info->Pos + Info->StructSize + ArPos;
+		if (const byte* Src = Reader->GetDirectPointer(ReadPos, size))
+		{
+			memcpy(data, Src, size);
+		}
+		else
+		{
+		#if THREADING
+			CMutex::ScopedLock Lock(Parent->ReaderMutex);
+		#endif
+			// seek every time in a case if the same 'Reader' was used by different FPakFile
+			// (this is a lightweight operation for buffered FArchive)
+			Reader->Seek64(ReadPos);
+			Reader->Serialize(data, size);
+		}
 		ArPos += size;
 
 		unguard;
@@ -439,7 +624,51 @@ void FPakFile::Serialize(void *data, int size)
 	unguardf("file=%s", *Info->FileInfo->GetRelativeName());
 }
 
+const byte* FPakFile::GetDirectPointer(int64 Pos, int Size)
+{
+	// Only plain data could be accessed directly
+	if (Info->CompressionMethod || Info->bEncrypted || Pos < 0 || Pos + Size > Info->UncompressedSize)
+		return NULL;
+
+	if (!IsFileOpen)
+	{
+		Parent->FileOpened();
+		IsFileOpen = true;
+	}
+	return Parent->Reader->GetDirectPointer(Info->Pos + Info->StructSize + Pos, Size);
+}
+
 bool FPakVFS::AttachReader(FArchive* reader, FString& error)
+{
+	guard(FPakVFS::AttachReader);
+
+	if (!bIndexLoaded || bIndexNeedsAesKey)
+	{
+		LoadIndex(reader, true);
+	}
+	if (!bIndexValid)
+	{
+		error = IndexError;
+		return false;
+	}
+	RegisterFiles();
+	return true;
+
+	unguardf("%s", *Filename);
+}
+
+void FPakVFS::LoadIndex(FArchive* reader, bool bAllowKeyRequest)
+{
+	bIndexNeedsAesKey = false;
+	bIndexValid = ReadIndex(reader, IndexError, bAllowKeyRequest);
+	bIndexLoaded = true;
+	// The index looks correct, store 'reader'. It is not stored when index loading has failed, so the
+	// caller could release the reader and FPakVFS independently.
+	if (bIndexValid)
+		Reader = reader;
+}
+
+bool FPakVFS::ReadIndex(FArchive* reader, FString& error, bool bAllowKeyRequest)
 {
 	int mainVer = 0, subVer = 0;
 
@@ -487,6 +716,12 @@ bool FPakVFS::AttachReader(FArchive* reader, FString& error)
 
 	if (info.bEncryptedIndex)
 	{
+		if (!bAllowKeyRequest && GAesKeys.Num() == 0)
+		{
+			// Key request could show UI and modifies GAesKeys, so it is done later by AttachReader()
+			bIndexNeedsAesKey = true;
+			return false;
+		}
 		if (!FileRequiresAesKey(false))
 		{
 			char buf[1024];
@@ -513,26 +748,71 @@ bool FPakVFS::AttachReader(FArchive* reader, FString& error)
 		result = LoadPakIndex(reader, info, error);
 	}
 
+	PakVersion = info.Version;
+
+	// Close the file handle. FPakVFS::Reader is assigned by LoadIndex() after this function returns.
 	if (result)
 	{
-		// Print statistics
-		appPrintf("Pak %s: %d files", *Filename, FileInfos.Num());
-		if (NumEncryptedFiles)
-			appPrintf(" (%d encrypted)", NumEncryptedFiles);
-		if (strcmp(*MountPoint, "/") != 0)
-			appPrintf(", mount point: \"%s\"", *MountPoint);
-		appPrintf(", version %d\n", info.Version);
+		reader->Close();
 	}
 
-	// Close the file handle
-	if (Reader)
+	return result;
+
+	unguardf("PakVer=%d.%d", mainVer, subVer);
+}
+
+int FPakVFS::AddPendingName(const char* Name)
+{
+	int Offset = PendingNames.Num();
+	int Len = strlen(Name) + 1;
+	if (Offset + Len > PendingNames.Max())
 	{
-		Reader->Close();
+		// FArray grows by small steps when several items are added at once, so grow the buffer here
+		PendingNames.Reserve(max(Offset + Len, PendingNames.Max() * 2));
 	}
+	PendingNames.SetNumUninitialized(Offset + Len);
+	memcpy(PendingNames.GetData() + Offset, Name, Len);
+	return Offset;
+}
 
-	return result;
+void FPakVFS::RegisterFiles()
+{
+	guard(FPakVFS::RegisterFiles);
 
-	unguardf("PakVer=%d.%d", mainVer, subVer);
+	Reserve(PendingFiles.Num());
+
+	TArray<int> Folders;
+	Folders.SetNumUninitialized(PendingFolders.Num());
+	for (int i = 0; i < PendingFolders.Num(); i++)
+	{
+		Folders[i] = RegisterGameFolder(&PendingNames[PendingFolders[i]]);
+	}
+
+	for (const FPendingFile& File : PendingFiles)
+	{
+		FPakEntry& E = FileInfos[File.IndexInArchive];
+		CRegisterFileInfo reg;
+		reg.Filename = &PendingNames[File.Name];
+		if (File.Folder >= 0)
+			reg.FolderIndex = Folders[File.Folder];
+		reg.Size = E.UncompressedSize;
+		reg.IndexInArchive = File.IndexInArchive;
+		E.FileInfo = RegisterFile(reg);
+	}
+
+	PendingFiles.Empty();
+	PendingFolders.Empty();
+	PendingNames.Empty();
+
+	// Print statistics
+	appPrintf("Pak %s: %d files", *Filename, FileInfos.Num());
+	if (NumEncryptedFiles)
+		appPrintf(" (%d encrypted)", NumEncryptedFiles);
+	if (strcmp(*MountPoint, "/") != 0)
+		appPrintf(", mount point: \"%s\"", *MountPoint);
+	appPrintf(", version %d\n", PakVersion);
+
+	unguard;
 }
 
 // FPakVFS objects which has Reader open, but no active files (MRU)
@@ -553,6 +833,10 @@ void FPakVFS::FileOpened()
 {
 	guard(FPakVFS::FileOpened);
 
+#if THREADING
+	CMutex::ScopedLock Lock(GPakOpenFilesMutex);
+#endif
+
 	if (NumOpenFiles++ == 0)
 	{
 		// This is the very first open handle in pak.
@@ -578,6 +862,10 @@ void FPakVFS::FileClosed()
 {
 	guard(FPakVFS::FileClosed);
 
+#if THREADING
+	CMutex::ScopedLock Lock(GPakOpenFilesMutex);
+#endif
+
 	assert(NumOpenFiles > 0);
 	if (--NumOpenFiles == 0)
 	{
@@ -690,14 +978,36 @@ void FPakVFS::DecryptDataBlock(byte* Data, int DataSize)
 	unguard;
 }
 
+// Read a block of index data from the current position of 'reader'. Unencrypted data is used in place when
+// the reader keeps file contents in memory, otherwise (or when data should be decrypted) it is copied to 'Buffer'.
+static const byte* ReadIndexBlock(FArchive* reader, int64 Size, bool bEncrypted, TArray<byte>& Buffer)
+{
+	guard(ReadIndexBlock);
+
+	int64 Pos = reader->Tell64();
+	if (!bEncrypted)
+	{
+		const byte* Data = reader->GetDirectPointer(Pos, (int)Size);
+		if (Data)
+		{
+			reader->Seek64(Pos + Size);
+			return Data;
+		}
+	}
+	Buffer.SetNumUninitialized((int)Size);
+	reader->Serialize(Buffer.GetData(), (int)Size);
+	return Buffer.GetData();
+
+	unguard;
+}
+
 bool FPakVFS::LoadPakIndexLegacy(FArchive* reader, const FPakInfo& info, FString& error)
 {
 	guard(FPakVFS::LoadPakIndexLegacy);
 
 	// Always read index to memory block for faster serialization
 	TArray<byte> InfoBlock;
-	InfoBlock.SetNumUninitialized(info.IndexSize);
-	reader->Serialize(InfoBlock.GetData(), info.IndexSize);
+	const byte* InfoData = ReadIndexBlock(reader, info.IndexSize, info.bEncryptedIndex, InfoBlock);
 
 	// Manage pak files with encrypted index
 	if (info.bEncryptedIndex)
@@ -706,11 +1016,8 @@ bool FPakVFS::LoadPakIndexLegacy(FArchive* reader, const FPakInfo& info, FString
 			return false;
 	}
 
-	// this file looks correct, store 'reader'
-	Reader = reader;
-
 	// Read pak index
-	FMemReader InfoReader(InfoBlock.GetData(), info.IndexSize);
+	FMemReader InfoReader(InfoData, info.IndexSize);
 	InfoReader.SetupFrom(*reader);
 
 	TRY {
@@ -742,7 +1049,7 @@ bool FPakVFS::LoadPakIndexLegacy(FArchive* reader, const FPakInfo& info, FString
 
 	// Read file information
 	FileInfos.AddZeroed(count);
-	Reserve(count);
+	PendingFiles.Empty(count);
 
 	for (int i = 0; i < count; i++)
 	{
@@ -783,12 +1090,11 @@ bool FPakVFS::LoadPakIndexLegacy(FArchive* reader, const FPakInfo& info, FString
 			E.CompressionMethod = COMPRESS_FIND;
 		}
 
-		// Register the file
-		CRegisterFileInfo reg;
-		reg.Filename = *CombinedPath;
-		reg.Size = E.UncompressedSize;
-		reg.IndexInArchive = i;
-		E.FileInfo = RegisterFile(reg);
+		// Remember the file for registration
+		FPendingFile& Pending = PendingFiles.AddZeroed_GetRef();
+		Pending.IndexInArchive = i;
+		Pending.Folder = -1;
+		Pending.Name = AddPendingName(*CombinedPath);
 
 		unguardf("Index=%d/%d", i, count);
 	}
@@ -815,8 +1121,7 @@ bool FPakVFS::LoadPakIndex(FArchive* reader, const FPakInfo& info, FString& erro
 
 	// Read full index into InfoBlock and setup InfoReader
 	TArray<byte> InfoBlock;
-	InfoBlock.SetNumUninitialized(info.IndexSize);
-	reader->Serialize(InfoBlock.GetData(), info.IndexSize);
+	const byte* InfoData = ReadIndexBlock(reader, info.IndexSize, info.bEncryptedIndex, InfoBlock);
 
 	// Manage pak files with encrypted index
 	if (info.bEncryptedIndex)
@@ -825,11 +1130,8 @@ bool FPakVFS::LoadPakIndex(FArchive* reader, const FPakInfo& info, FString& erro
 			return false;
 	}
 
-	// this file looks correct, store 'reader'
-	Reader = reader;
-
 	// Read pak index
-	FMemReader InfoReader(InfoBlock.GetData(), info.IndexSize);
+	FMemReader InfoReader(InfoData, info.IndexSize);
 	InfoReader.SetupFrom(*reader);
 
 	TRY {
@@ -855,7 +1157,7 @@ bool FPakVFS::LoadPakIndex(FArchive* reader, const FPakInfo& info, FString& erro
 //		appPrintf("Empty pak file \"%s\"\n", *Filename);
 		return true;
 	}
-	Reserve(count);
+	PendingFiles.Empty(count);
 
 	// Process MountPoint
 	ValidateMountPoint(MountPoint, Filename);
@@ -911,9 +1213,8 @@ bool FPakVFS::LoadPakIndex(FArchive* reader, const FPakInfo& info, FString& erro
 	guard(ReadFullDirectory);
 	reader->Seek64(FullDirectoryIndexOffset);
 	InfoBlock.Empty(); // avoid reallocation with memcpy
-	InfoBlock.SetNumUninitialized(FullDirectoryIndexSize);
-	reader->Serialize(InfoBlock.GetData(), FullDirectoryIndexSize);
-	InfoReader = FMemReader(InfoBlock.GetData(), InfoBlock.Num());
+	InfoData = ReadIndexBlock(reader, FullDirectoryIndexSize, info.bEncryptedIndex, InfoBlock);
+	InfoReader = FMemReader(InfoData, (int)FullDirectoryIndexSize);
 	InfoReader.SetupFrom(*reader);
 
 	if (info.bEncryptedIndex)
@@ -965,7 +1266,7 @@ bool FPakVFS::LoadPakIndex(FArchive* reader, const FPakInfo& info, FString& erro
 		int FolderIndex = -1;
 		if (NumFilesInDirectory)
 		{
-			FolderIndex = RegisterGameFolder(*DirectoryPath);
+			FolderIndex = PendingFolders.Add(AddPendingName(*DirectoryPath));
 		}
 
 		for (int DirectoryFileIndex = 0; DirectoryFileIndex < NumFilesInDirectory; DirectoryFileIndex++, FileIndex++)
@@ -1011,13 +1312,11 @@ bool FPakVFS::LoadPakIndex(FArchive* reader, const FPakInfo& info, FString& erro
 			assert(CompressionMethodIndex >= 0 && CompressionMethodIndex <= 4);
 			E.CompressionMethod = CompressionMethodIndex > 0 ? info.CompressionMethods[CompressionMethodIndex-1] : 0;
 
-			// Register the file
-			CRegisterFileInfo reg;
-			reg.Filename = *DirectoryFileName;
-			reg.FolderIndex = FolderIndex;
-			reg.Size = E.UncompressedSize;
-			reg.IndexInArchive = FileIndex;
-			E.FileInfo = RegisterFile(reg);
+			// Remember the file for registration
+			FPendingFile& Pending = PendingFiles.AddZeroed_GetRef();
+			Pending.IndexInArchive = FileIndex;
+			Pending.Folder = FolderIndex;
+			Pending.Name = AddPendingName(*DirectoryFileName);
 
 			unguard;
 		}
@@ -1045,6 +1344,158 @@ bool FPakVFS::LoadPakIndex(FArchive* reader, const FPakInfo& info, FString& erro
 	unguard;
 }
 
+// Serialize FPakEntry fields in umodel's own format, used for game file index cache
+static void SerializeCachedEntry(FArchive& Ar, FPakEntry& E)
+{
+	Ar << E.Pos << E.Size << E.UncompressedSize << E.CompressionMethod << E.CompressionBlockSize;
+	Ar << E.CompressionBlocks << E.bEncrypted << E.StructSize;
+}
+
+bool FPakVFS::SaveDirectory(FArchive& Ar) const
+{
+	guard(FPakVFS::SaveDirectory);
+
+	// Don't store decrypted index data on disk. Note: PakEncryptionKey is assigned only for paks with
+	// encrypted index, so cached paks are always using GAesKeys[0] for encrypted files. The game index
+	// cache is invalidated when AES keys are changed.
+	if (!PakEncryptionKey.IsEmpty())
+		return false;
+
+	// Collect folders used by registered files
+	TArray<int> FolderMap;				// global folder index -> local index
+	TArray<int> Folders;				// local folder index -> global index
+	FolderMap.Init(-1, appGetGameFolderCount());
+	for (const FPakEntry& E : FileInfos)
+	{
+		if (E.FileInfo && FolderMap[E.FileInfo->FolderIndex] < 0)
+		{
+			FolderMap[E.FileInfo->FolderIndex] = Folders.Add(E.FileInfo->FolderIndex);
+		}
+	}
+
+	FString Name = MountPoint;
+	int32 Value = NumEncryptedFiles;
+	int32 Version = PakVersion;
+	int32 LicenseeVer = Reader->ArLicenseeVer;
+	Ar << Name << Value << Version << LicenseeVer;
+
+	int32 NumFolders = Folders.Num();
+	Ar << NumFolders;
+	for (int FolderIndex : Folders)
+	{
+		Name = CGameFileInfo::GetPathByIndex(FolderIndex);
+		Ar << Name;
+	}
+
+	int32 NumFiles = FileInfos.Num();
+	Ar << NumFiles;
+	for (int i = 0; i < NumFiles; i++)
+	{
+		FPakEntry& E = const_cast<FPakEntry&>(FileInfos[i]);
+		SerializeCachedEntry(Ar, E);
+
+		byte bRegistered = (E.FileInfo != NULL);
+		Ar << bRegistered;
+		if (!bRegistered) continue;
+
+		const CGameFileInfo* Info = E.FileInfo;
+		int32 LocalFolder = FolderMap[Info->FolderIndex];
+		Info->GetCleanName(Name);
+		Ar << LocalFolder << Name;
+
+		// Package scan results. File could be overridden by another pak, store results only when
+		// they belong to this pak.
+		byte bScanned = Info->IsPackageScanned && Info->FileSystem == this && Info->IndexInVfs == i;
+		Ar << bScanned;
+		if (bScanned)
+		{
+			uint16 Counts[4] = { Info->NumSkeletalMeshes, Info->NumStaticMeshes, Info->NumAnimations, Info->NumTextures };
+			Ar << Counts[0] << Counts[1] << Counts[2] << Counts[3];
+		}
+	}
+	return true;
+
+	unguard;
+}
+
+void FPakVFS::AttachReaderFromCache(FArchive* reader, FArchive& CacheAr)
+{
+	guard(FPakVFS::AttachReaderFromCache);
+
+	Reader = reader;
+
+	FString Name;
+	int32 Value, Version, LicenseeVer;
+	CacheAr << Name << Value << Version << LicenseeVer;
+	MountPoint = *Name;
+	NumEncryptedFiles = Value;
+	// Restore the state set by ReadIndex()
+	PakVersion = Version;
+	reader->ArLicenseeVer = LicenseeVer;
+
+	int32 NumFolders;
+	CacheAr << NumFolders;
+	TArray<int> Folders;
+	Folders.SetNumUninitialized(NumFolders);
+	for (int i = 0; i < NumFolders; i++)
+	{
+		CacheAr << Name;
+		Folders[i] = RegisterGameFolder(*Name);
+	}
+
+	int32 NumFiles;
+	CacheAr << NumFiles;
+	FileInfos.AddZeroed(NumFiles);
+	Reserve(NumFiles);
+	for (int i = 0; i < NumFiles; i++)
+	{
+		FPakEntry& E = FileInfos[i];
+		SerializeCachedEntry(CacheAr, E);
+
+		byte bRegistered;
+		CacheAr << bRegistered;
+		if (!bRegistered) continue;
+
+		int32 LocalFolder;
+		CacheAr << LocalFolder << Name;
+
+		CRegisterFileInfo reg;
+		reg.Filename = *Name;
+		reg.FolderIndex = Folders[LocalFolder];
+		reg.Size = E.UncompressedSize;
+		reg.IndexInArchive = i;
+		E.FileInfo = RegisterFile(reg);
+
+		byte bScanned;
+		CacheAr << bScanned;
+		if (bScanned)
+		{
+			uint16 Counts[4];
+			CacheAr << Counts[0] << Counts[1] << Counts[2] << Counts[3];
+			if (CGameFileInfo* Info = E.FileInfo)
+			{
+				Info->IsPackageScanned = true;
+				Info->NumSkeletalMeshes = Counts[0];
+				Info->NumStaticMeshes = Counts[1];
+				Info->NumAnimations = Counts[2];
+				Info->NumTextures = Counts[3];
+			}
+		}
+	}
+
+	appPrintf("Pak %s: %d files (cached)", *Filename, FileInfos.Num());
+	if (NumEncryptedFiles)
+		appPrintf(" (%d encrypted)", NumEncryptedFiles);
+	if (strcmp(*MountPoint, "/") != 0)
+		appPrintf(", mount point: \"%s\"", *MountPoint);
+	appPrintf(", version %d\n", PakVersion);
+
+	// Close the file handle, like AttachReader does
+	Reader->Close();
+
+	unguard;
+}
+
 #if 0
 const FPakEntry* FPakVFS::FindFile(const char* name)
 {
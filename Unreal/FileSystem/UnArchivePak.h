@@ -3,6 +3,10 @@
 
 #if UNREAL4
 
+#if THREADING
+#include "Parallel.h"
+#endif
+
 // Pak file versions
 enum
 {
@@ -107,12 +111,18 @@ public:
 	:	Info(info)
 	,	Parent(parent)
 	,	UncompressedBuffer(NULL)
+	,	UncompressedBufferSize(0)
+	,	UncompressedBufferCapacity(0)
+	,	DecodedEnd(-1)
+	,	CompressedBuffer(NULL)
+	,	CompressedBufferCapacity(0)
 	,	IsFileOpen(true)
 	{}
 
 	virtual ~FPakFile();
 
 	virtual void Serialize(void *data, int size);
+	virtual const byte* GetDirectPointer(int64 Pos, int Size);
 
 	virtual void Seek(int Pos)
 	{
@@ -142,9 +152,23 @@ protected:
 	const FPakEntry* Info;
 	byte*		UncompressedBuffer;
 	int			UncompressedBufferPos;
+	int			UncompressedBufferSize;		// number of valid bytes in UncompressedBuffer (compressed files only)
+	int			UncompressedBufferCapacity;	// allocated size of UncompressedBuffer
+	int			DecodedEnd;					// end of the most recently decompressed data, used to detect sequential reading
+	byte*		CompressedBuffer;			// scratch memory for compressed data, reused between reads
+	int			CompressedBufferCapacity;
 	bool		IsFileOpen;
+
+	// Decompress up to NumBlocks blocks starting with BlockIndex into Dst, returns number of decompressed bytes
+	int DecompressBlocks(int BlockIndex, int NumBlocks, byte* Dst);
+	// Decompress NumBlocks blocks starting with BlockIndex into UncompressedBuffer
+	void ReadCompressedBlocks(int BlockIndex, int NumBlocks);
 };
 
+// Number of compressed blocks decoded at once when FPakFile detects sequential reading.
+// Blocks are decompressed with ParallelFor. Value 1 disables read-ahead.
+extern int GPakReadAheadBlocks;
+
 
 class FPakVFS : public FVirtualFileSystem
 {
@@ -157,20 +181,37 @@ public:
 //	,	HashTable(NULL)
 	,	NumEncryptedFiles(0)
 	,	NumOpenFiles(0)
+	,	PakVersion(0)
+	,	bIndexLoaded(false)
+	,	bIndexValid(false)
+	,	bIndexNeedsAesKey(false)
 	{}
 
-	virtual ~FPakVFS()
-	{
-		delete Reader;
-//		if (HashTable) delete[] HashTable;
-	}
+	virtual ~FPakVFS();
 
 	virtual bool AttachReader(FArchive* reader, FString& error);
 
+	// Read and decode pak index without registering files. Doesn't touch global state, so indices of
+	// different paks could be loaded in parallel. AttachReader() will register files using loaded data.
+	// When bAllowKeyRequest is false, AES key for encrypted index is not requested from user: this
+	// is deferred to AttachReader(), which is called from the main thread.
+	void LoadIndex(FArchive* reader, bool bAllowKeyRequest = false);
+
 	virtual FArchive* CreateReader(int index);
 
+	// Reading of the shared pak file is protected with a mutex
+	virtual bool AllowsConcurrentReads() const
+	{
+		return true;
+	}
+
 	const FString& GetPakEncryptionKey() const;
 
+	// Game file index cache support. SaveDirectory() returns false if pak directory shouldn't be cached,
+	// AttachReaderFromCache() is used instead of AttachReader() with data previously stored by SaveDirectory().
+	bool SaveDirectory(FArchive& Ar) const;
+	void AttachReaderFromCache(FArchive* reader, FArchive& CacheAr);
+
 protected:
 	FString				Filename;
 	FArchive*			Reader;
@@ -179,6 +220,28 @@ protected:
 	int					NumEncryptedFiles;
 	int					NumOpenFiles;
 	FString				PakEncryptionKey;
+	int					PakVersion;
+#if THREADING
+	CMutex				ReaderMutex;		// serializes Seek+Serialize on Reader, which is shared by all files of the pak
+#endif
+
+	// Results of LoadIndex(), consumed by RegisterFiles()
+	struct FPendingFile
+	{
+		int32			IndexInArchive;
+		int32			Folder;				// index in PendingFolders, or -1 when Name holds the full path
+		int32			Name;				// offset in PendingNames
+	};
+	bool				bIndexLoaded;
+	bool				bIndexValid;
+	bool				bIndexNeedsAesKey;	// index is encrypted, and LoadIndex() wasn't allowed to request a key
+	FString				IndexError;
+	TArray<FPendingFile> PendingFiles;
+	TArray<int32>		PendingFolders;		// offsets in PendingNames
+	TArray<char>		PendingNames;
+
+	int AddPendingName(const char* Name);
+	void RegisterFiles();
 
 	// Called when some FPakFile has been opened
 	void FileOpened();
@@ -186,6 +249,8 @@ protected:
 	// Called by FPakFile when it is destroyed
 	void FileClosed();
 
+	// Read pak header and index, used by LoadIndex()
+	bool ReadIndex(FArchive* reader, FString& error, bool bAllowKeyRequest);
 	// UE4.24 and older
 	bool LoadPakIndexLegacy(FArchive* reader, const FPakInfo& info, FString& error);
 	// UE4.25 and newer
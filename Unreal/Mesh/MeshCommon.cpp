@@ -4,85 +4,151 @@
 #include "MeshCommon.h"
 #include "UnrealMesh/UnMathTools.h"		// CVertexShare
 #include "UnrealMaterial/UnMaterial.h"
+#include "Parallel.h"
 
 #define STRIP_BINORMAL		1
 
+// Meshes with this number of items (triangles or vertices) or more are processed using multiple threads
+#define PARALLEL_MESH_MIN_ITEMS		16384
+// Number of items processed by a single task
+#define PARALLEL_MESH_TASK_ITEMS	4096
+
 // WARNING for BuildNnnCommon functions: do not access Verts[i] directly, use VERT macro only!
 #define VERT(n)		OffsetPointer(Verts, (n) * VertexSize)
 
+// Split [0, Count) into ranges and call Func(First, Last) for each range. Large ranges are processed
+// with ParallelFor, so the function should process ranges independently.
+template<typename F>
+static void ForEachRange(int Count, F&& Func)
+{
+	if (Count >= PARALLEL_MESH_MIN_ITEMS)
+	{
+		int NumTasks = (Count + PARALLEL_MESH_TASK_ITEMS - 1) / PARALLEL_MESH_TASK_ITEMS;
+		ParallelFor(NumTasks, [&Func, Count](int Task)
+			{
+				int First = Task * PARALLEL_MESH_TASK_ITEMS;
+				Func(First, min(First + PARALLEL_MESH_TASK_ITEMS, Count));
+			});
+	}
+	else
+	{
+		Func(0, Count);
+	}
+}
+
 void BuildNormalsCommon(CMeshVertex *Verts, int VertexSize, int NumVerts, const CIndexBuffer &Indices)
 {
 	guard(BuildNormalsCommon);
 
-	int i, j;
-
 	// Find vertices to share.
 	// We are using very simple algorithm here: to share all vertices with the same position
 	// independently on normals of faces which share this vertex.
-	TArray<CVec3> tmpNorm;
-	tmpNorm.AddZeroed(NumVerts);					// really will use Points.Num() items, which value is smaller than NumVerts
 	CVertexShare Share;
-	Share.Prepare(Verts, NumVerts, VertexSize);
-	for (i = 0; i < NumVerts; i++)
+	Share.Prepare(NumVerts);
+	Share.AddVertices(NumVerts, [Verts, VertexSize](int Index, CVec3& Pos, CPackedNormal& Normal, uint32& ExtraInfo)
+		{
+			Pos = VERT(Index)->Position;
+			Normal.Data = 0;
+		});
+	int NumPoints = Share.Points.Num();
+	int NumTris = Indices.Num() / 3;
+	int NumCorners = NumTris * 3;
+
+	// Compute face normals and angles at face corners. Each face is processed independently.
+	struct CFaceNormal
 	{
-		CPackedNormal NullVec;
-		NullVec.Data = 0;
-		Share.AddVertex(VERT(i)->Position, NullVec);
-	}
+		CVec3			Normal;
+		float			Angle[3];
+	};
+	TArray<CFaceNormal> Faces;
+	Faces.AddUninitialized(NumTris);
 
-	CIndexBuffer::IndexAccessor_t Index = Indices.GetAccessor();
-	for (i = 0; i < Indices.Num() / 3; i++)
+	Indices.ForEach16or32([&](const auto* Index)
 	{
-		CMeshVertex *V[3];
-		CVec3 *N[3];
-		for (j = 0; j < 3; j++)
+		ForEachRange(NumTris, [&](int First, int Last)
 		{
-			int idx = Index(i * 3 + j);				// index in Verts[]
-			V[j] = VERT(idx);
-			N[j] = &tmpNorm[Share.WedgeToVert[idx]]; // remap to shared verts
-		}
+			for (int i = First; i < Last; i++)
+			{
+				const CMeshVertex *V[3];
+				for (int j = 0; j < 3; j++)
+					V[j] = VERT(Index[i * 3 + j]);
 
-		// compute edges
-		CVec3 D[3];				// 0->1, 1->2, 2->0
-		VectorSubtract(V[1]->Position, V[0]->Position, D[0]);
-		VectorSubtract(V[2]->Position, V[1]->Position, D[1]);
-		VectorSubtract(V[0]->Position, V[2]->Position, D[2]);
-		// compute face normal
-		CVec3 norm;
-		cross(D[1], D[0], norm);
-		norm.Normalize();
-		// compute angles
-		for (j = 0; j < 3; j++) D[j].Normalize();
-		float angle[3];
-		angle[0] = acos(-dot(D[0], D[2]));
-		angle[1] = acos(-dot(D[0], D[1]));
-		angle[2] = acos(-dot(D[1], D[2]));
-		// add normals for triangle verts
-		for (j = 0; j < 3; j++)
-			VectorMA(*N[j], angle[j], norm);
-	}
+				// compute edges
+				CVecT D[3];				// 0->1, 1->2, 2->0
+				VectorSubtract(V[1]->Position, V[0]->Position, D[0]);
+				VectorSubtract(V[2]->Position, V[1]->Position, D[1]);
+				VectorSubtract(V[0]->Position, V[2]->Position, D[2]);
+				// compute face normal
+				CVecT norm;
+				cross(D[1], D[0], norm);
+				norm.Normalize();
+				// compute angles
+				for (int j = 0; j < 3; j++) D[j].Normalize();
+				CFaceNormal &F = Faces[i];
+				F.Normal = norm;
+				F.Angle[0] = acos(-dot(D[0], D[2]));
+				F.Angle[1] = acos(-dot(D[0], D[1]));
+				F.Angle[2] = acos(-dot(D[1], D[2]));
+			}
+		});
+	});
+
+	// Build shared vertex -> face corner adjacency. Corners of every vertex are stored in ascending order,
+	// so normals are accumulated in the same order as with a sequential loop over faces, and the result
+	// doesn't depend on threading.
+	TArray<int> FirstCorner;					// FirstCorner[i] .. FirstCorner[i+1]-1 are corners of vertex 'i'
+	FirstCorner.AddZeroed(NumPoints + 1);
+	TArray<int> Corners;
+	Corners.AddUninitialized(NumCorners);
+	Indices.ForEach16or32([&](const auto* Index)
+	{
+		for (int i = 0; i < NumCorners; i++)
+			FirstCorner[Share.WedgeToVert[Index[i]]]++;
+		for (int i = 1; i < NumPoints; i++)
+			FirstCorner[i] += FirstCorner[i - 1];	// now FirstCorner[i] points after the last corner of vertex 'i'
+		for (int i = NumCorners - 1; i >= 0; i--)
+			Corners[--FirstCorner[Share.WedgeToVert[Index[i]]]] = i;
+		FirstCorner[NumPoints] = NumCorners;
+	});
 
 	// TODO: add "hard angle threshold" - do not share vertex between faces when angle between them
 	// is too large.
 
-	// normalize shared normals ...
-	for (i = 0; i < Share.Points.Num(); i++)
-		tmpNorm[i].Normalize();
+	// Accumulate and normalize shared normals ...
+	TArray<CVec3> tmpNorm;
+	tmpNorm.AddUninitialized(NumPoints);
+	ForEachRange(NumPoints, [&](int First, int Last)
+	{
+		for (int i = First; i < Last; i++)
+		{
+			CVec3 N;
+			N.Set(0, 0, 0);
+			for (int k = FirstCorner[i]; k < FirstCorner[i + 1]; k++)
+			{
+				int Corner = Corners[k];
+				const CFaceNormal &F = Faces[Corner / 3];
+				VectorMA(N, F.Angle[Corner % 3], F.Normal);
+			}
+			N.Normalize();
+			tmpNorm[i] = N;
+		}
+	});
 
 	// ... then place ("unshare") normals to Verts
-	for (i = 0; i < NumVerts; i++)
-		Pack(VERT(i)->Normal, tmpNorm[Share.WedgeToVert[i]]);
+	ForEachRange(NumVerts, [&](int First, int Last)
+	{
+		for (int i = First; i < Last; i++)
+			Pack(VERT(i)->Normal, tmpNorm[Share.WedgeToVert[i]]);
+	});
 
 	unguard;
 }
 
 
-void BuildTangentsCommon(CMeshVertex *Verts, int VertexSize, const CIndexBuffer &Indices)
+void BuildTangentsCommon(CMeshVertex *Verts, int VertexSize, int NumVerts, const CIndexBuffer &Indices)
 {
 	guard(BuildTangentsCommon);
 
-	int i, j;
-
 	// TODO: this is not a 100% correct algorithm. Here we're iterating over all indices, processing the
 	// same wedge as many times as many triangles using it, with overwriting previous results. We should
 	// accumulate tangent value between triangles, counting number of triangles using them in a first
@@ -91,82 +157,469 @@ void BuildTangentsCommon(CMeshVertex *Verts, int VertexSize, const CIndexBuffer
 	// Should review the algorithm described above, to check for case when the same vertex should not
 	// share tangent space due to mirored texture (i.e. vertex use different tangent vector direction
 	// for different triangles).
-	CIndexBuffer::IndexAccessor_t Index = Indices.GetAccessor();
-	for (i = 0; i < Indices.Num() / 3; i++)
+	int NumTris = Indices.Num() / 3;
+
+	// Only the last triangle corner referencing a vertex determines its tangent. Find this corner, so
+	// every vertex is written exactly once, and triangles could be processed in parallel.
+	TArray<int> LastCorner;
+	LastCorner.Init(-1, NumVerts);
+	Indices.ForEach16or32([&](const auto* Index)
+	{
+		for (int i = 0; i < NumTris * 3; i++)
+			LastCorner[Index[i]] = i;
+	});
+
+	// The W component of a normal may be overwritten below with the binormal sign while other triangles
+	// are still reading this vertex, so take normals from a copy with W stripped.
+	TArray<CPackedNormal> Normals;
+	Normals.AddUninitialized(NumVerts);
+	for (int i = 0; i < NumVerts; i++)
+		Normals[i].Data = VERT(i)->Normal.Data & 0xFFFFFF;
+
+	Indices.ForEach16or32([&](const auto* Index)
 	{
-		CMeshVertex *V[3];
-		for (j = 0; j < 3; j++)
+		ForEachRange(NumTris, [&](int First, int Last)
 		{
-			int idx = Index(i * 3 + j);
-			V[j] = VERT(idx);
+			for (int i = First; i < Last; i++)
+			{
+				CMeshVertex *V[3];
+				int VertIndex[3];
+				for (int j = 0; j < 3; j++)
+				{
+					int idx = Index[i * 3 + j];
+					VertIndex[j] = idx;
+					V[j] = VERT(idx);
+				}
+
+				// compute tangent
+				CVecT tang;
+				float U0 = V[0]->UV.U;
+				float V0 = V[0]->UV.V;
+				float U1 = V[1]->UV.U;
+				float V1 = V[1]->UV.V;
+				float U2 = V[2]->UV.U;
+				float V2 = V[2]->UV.V;
+
+				if (V0 == V2)
+				{
+					// W[0] -> W[2] -- axis for tangent
+					VectorSubtract(V[2]->Position, V[0]->Position, tang);
+					// we should make 'tang' to look in direction of growing 'U'
+					if (U2 < U0) tang.Negate();
+				}
+				else
+				{
+					float pos = (V1 - V0) / (V2 - V0);			// fraction, where W[1] is placed between W[0] and W[2] (may be < 0 or > 1)
+					CVecT tmp;
+					Lerp(V[0]->Position, V[2]->Position, pos, tmp);
+					VectorSubtract(tmp, V[1]->Position, tang);
+					// tang.V == W[1].V; but tang.U may be greater or smaller than W[1].U
+					// we should make tang to look in side of growing U
+					float tU = Lerp(U0, U2, pos);
+					if (tU < U1) tang.Negate();
+				}
+				// now, tang is on triangle plane
+				// now we should place tangent orthogonal to normal, then normalize vector
+				float binormalScale = 1.0f;
+				for (int j = 0; j < 3; j++)
+				{
+					// Skip vertices which will be overwritten by a later triangle. The 1st vertex is
+					// processed anyway, because binormal sign is computed with it.
+					bool bStore = (LastCorner[VertIndex[j]] == i * 3 + j);
+					if (!bStore && j != 0) continue;
+
+					CMeshVertex &DW = *V[j];
+					CVecT normal;
+					Unpack(normal, Normals[VertIndex[j]]);
+					float pos = dot(normal, tang);
+
+					CVecT tangent;
+					VectorMA(tang, -pos, normal, tangent);
+					tangent.Normalize();
+
+					CVecT binormal;
+					cross(normal, tangent, binormal);
+					binormal.Normalize();
+					if (j == 0)		// do this only once per triangle
+					{
+						// check binormal sign
+						// find two points with different V
+						int W1 = 0;
+						int W2 = (V1 != V0) ? 1 : 2;
+						// check projections of these points to binormal
+						float p1 = dot(V[W1]->Position, binormal);
+						float p2 = dot(V[W2]->Position, binormal);
+						if ((p1 - p2) * (V[W1]->UV.V - V[W2]->UV.V) < 0)
+							binormalScale = -1.0f;
+					}
+					if (!bStore) continue;
+
+					Pack(DW.Tangent, tangent);		// store
+		#if !STRIP_BINORMAL
+					binormal.Scale(binormalScale);
+					Pack(DW.Binormal, binormal);	// store
+		#else
+					DW.Normal.SetW(binormalScale);
+		#endif
+				}
+			}
+		});
+	});
+
+	unguard;
+}
+
+// Reference welder for BenchmarkVertexShare(). Vertices are sorted, so identical ones are placed together,
+// and points are numbered in order of their first vertex. The result should be the same as CVertexShare's.
+struct CWeldKey
+{
+	uint32			Data[5];		// position bits, normal and extra info
+	int				Index;
+};
+
+static int CompareWeldKeys(const CWeldKey& A, const CWeldKey& B)
+{
+	int r = memcmp(A.Data, B.Data, sizeof(A.Data));
+	return r ? r : A.Index - B.Index;
+}
+
+struct CWeldTestMesh
+{
+	const char*			Name;
+	TArray<CVec3>		Pos;
+	TArray<CPackedNormal> Normal;
+	TArray<uint32>		Extra;
+
+	// Results of the reference welder
+	TArray<int>			WedgeToVert;
+	TArray<int>			VertToWedge;
+	TArray<int>			PointToWedge;		// the first wedge of every point
+
+	void WeldReference()
+	{
+		int NumVerts = Pos.Num();
+		TArray<CWeldKey> Keys;
+		Keys.AddUninitialized(NumVerts);
+		for (int i = 0; i < NumVerts; i++)
+		{
+			CWeldKey& Key = Keys[i];
+			for (int j = 0; j < 3; j++)
+			{
+				float f = Pos[i][j] + 0.0f;			// -0 and +0 are equal
+				memcpy(&Key.Data[j], &f, sizeof(float));
+			}
+			Key.Data[3] = Normal[i].Data & 0xFFFFFF;
+			Key.Data[4] = Extra[i];
+			Key.Index = i;
 		}
+		Keys.Sort(CompareWeldKeys);
 
-		// compute tangent
-		CVecT tang;
-		float U0 = V[0]->UV.U;
-		float V0 = V[0]->UV.V;
-		float U1 = V[1]->UV.U;
-		float V1 = V[1]->UV.V;
-		float U2 = V[2]->UV.U;
-		float V2 = V[2]->UV.V;
-
-		if (V0 == V2)
-		{
-			// W[0] -> W[2] -- axis for tangent
-			VectorSubtract(V[2]->Position, V[0]->Position, tang);
-			// we should make 'tang' to look in direction of growing 'U'
-			if (U2 < U0) tang.Negate();
+		// FirstWedge[i] is the first wedge identical to 'i', LastWedge is valid for the first wedge only
+		TArray<int> FirstWedge, LastWedge;
+		FirstWedge.AddUninitialized(NumVerts);
+		LastWedge.AddUninitialized(NumVerts);
+		for (int i = 0; i < NumVerts; )
+		{
+			int First = Keys[i].Index;
+			int j;
+			for (j = i; j < NumVerts && !memcmp(Keys[j].Data, Keys[i].Data, sizeof(Keys[i].Data)); j++)
+				FirstWedge[Keys[j].Index] = First;
+			LastWedge[First] = Keys[j - 1].Index;
+			i = j;
 		}
-		else
-		{
-			float pos = (V1 - V0) / (V2 - V0);			// fraction, where W[1] is placed between W[0] and W[2] (may be < 0 or > 1)
-			CVecT tmp;
-			Lerp(V[0]->Position, V[2]->Position, pos, tmp);
-			VectorSubtract(tmp, V[1]->Position, tang);
-			// tang.V == W[1].V; but tang.U may be greater or smaller than W[1].U
-			// we should make tang to look in side of growing U
-			float tU = Lerp(U0, U2, pos);
-			if (tU < U1) tang.Negate();
+
+		WedgeToVert.Empty(NumVerts);
+		VertToWedge.Empty(NumVerts);
+		PointToWedge.Empty(NumVerts);
+		for (int i = 0; i < NumVerts; i++)
+		{
+			if (FirstWedge[i] == i)
+			{
+				WedgeToVert.Add(PointToWedge.Num());
+				VertToWedge.Add(LastWedge[i]);
+				PointToWedge.Add(i);
+			}
+			else
+			{
+				WedgeToVert.Add(WedgeToVert[FirstWedge[i]]);
+			}
 		}
-		// now, tang is on triangle plane
-		// now we should place tangent orthogonal to normal, then normalize vector
-		float binormalScale = 1.0f;
-		for (j = 0; j < 3; j++)
-		{
-			CMeshVertex &DW = *V[j];
-			CVecT normal;
-			Unpack(normal, DW.Normal);
-			float pos = dot(normal, tang);
-
-			CVecT tangent;
-			VectorMA(tang, -pos, normal, tangent);
-			tangent.Normalize();
-			Pack(DW.Tangent, tangent);		// store
-
-			CVecT binormal;
-			cross(normal, tangent, binormal);
-			binormal.Normalize();
-			if (j == 0)		// do this only once per triangle
+	}
+
+	bool Verify(const CVertexShare& Share) const
+	{
+		int NumPoints = PointToWedge.Num();
+		if (Share.Points.Num() != NumPoints || Share.WedgeToVert.Num() != WedgeToVert.Num())
+			return false;
+		if (memcmp(Share.WedgeToVert.GetData(), WedgeToVert.GetData(), WedgeToVert.Num() * sizeof(int)) != 0)
+			return false;
+		if (memcmp(Share.VertToWedge.GetData(), VertToWedge.GetData(), NumPoints * sizeof(int)) != 0)
+			return false;
+		for (int i = 0; i < NumPoints; i++)
+		{
+			int Wedge = PointToWedge[i];
+			if (memcmp(&Share.Points[i], &Pos[Wedge], sizeof(CVec3)) != 0 ||
+				Share.Normals[i].Data != (Normal[Wedge].Data & 0xFFFFFF) || Share.ExtraInfos[i] != Extra[Wedge])
 			{
-				// check binormal sign
-				// find two points with different V
-				int W1 = 0;
-				int W2 = (V1 != V0) ? 1 : 2;
-				// check projections of these points to binormal
-				float p1 = dot(V[W1]->Position, binormal);
-				float p2 = dot(V[W2]->Position, binormal);
-				if ((p1 - p2) * (V[W1]->UV.V - V[W2]->UV.V) < 0)
-					binormalScale = -1.0f;
+				return false;
 			}
-#if !STRIP_BINORMAL
-			binormal.Scale(binormalScale);
-			Pack(DW.Binormal, binormal);	// store
+		}
+		return true;
+	}
+};
+
+bool BenchmarkVertexShare()
+{
+	guard(BenchmarkVertexShare);
+
+	enum { NumMeshes = 4 };
+	CWeldTestMesh Meshes[NumMeshes];
+	uint32 Seed = 1;
+	auto Random = [&Seed]() -> uint32
+	{
+		Seed = Seed * 1103515245 + 12345;
+		return Seed >> 8;
+	};
+
+	// Smooth surface, all vertices are unique
+	const int GridSize = 1024;
+	CWeldTestMesh* Mesh = &Meshes[0];
+	Mesh->Name = "grid";
+	for (int y = 0; y < GridSize; y++)
+	{
+		for (int x = 0; x < GridSize; x++)
+		{
+			CVec3 Pos;
+			Pos.Set(x, y, sinf(x * 0.1f) * cosf(y * 0.13f) * 5);
+			Mesh->Pos.Add(Pos);
+			Mesh->Normal.AddZeroed();
+			Mesh->Extra.Add(0);
+		}
+	}
+
+	// Quads with separate wedges for every corner: positions are shared, but some wedges have different normal
+	// or extra info. Positions have both -0 and +0, normals have random W component.
+	Mesh = &Meshes[1];
+	Mesh->Name = "split";
+	for (int y = 0; y < GridSize / 2; y++)
+	{
+		for (int x = 0; x < GridSize / 2; x++)
+		{
+			for (int k = 0; k < 4; k++)
+			{
+				int px = x + (k & 1), py = y + (k >> 1);
+				CVec3 Pos;
+				Pos.Set(px ? px : -0.0f, py, ((px + py) % 7) ? 0.0f : -0.0f);
+				CPackedNormal Normal;
+				Normal.Data = (Random() % 4) | (Random() << 24);
+				Mesh->Pos.Add(Pos);
+				Mesh->Normal.Add(Normal);
+				Mesh->Extra.Add(Random() % 2);
+			}
+		}
+	}
+
+	// Random points with many duplicates, and a small mesh with the same data
+	for (int MeshIndex = 2; MeshIndex < 4; MeshIndex++)
+	{
+		Mesh = &Meshes[MeshIndex];
+		Mesh->Name = (MeshIndex == 2) ? "cloud" : "small";
+		int NumVerts = (MeshIndex == 2) ? 1 << 20 : 5000;
+		for (int i = 0; i < NumVerts; i++)
+		{
+			int s = Random() % (NumVerts / 4);
+			CVec3 Pos;
+			Pos.Set((s % 997) * 0.37f, (s / 997) * 1.1f, s * 0.001f);
+			CPackedNormal Normal;
+			Normal.Data = s & 1;
+			Mesh->Pos.Add(Pos);
+			Mesh->Normal.Add(Normal);
+			Mesh->Extra.Add(0);
+		}
+	}
+
+	appPrintf("Verifying CVertexShare with reference welder\n");
+	appPrintf("%-6s %8s %8s %10s %10s %10s\n", "Mesh", "Verts", "Points", "reference", "AddVertex", "parallel");
+
+	bool bResult = true;
+	for (CWeldTestMesh& M : Meshes)
+	{
+		int NumVerts = M.Pos.Num();
+		char Result[3][32];
+
+		int StartTime = appMilliseconds();
+		M.WeldReference();
+		appSprintf(ARRAY_ARG(Result[0]), "%d ms", appMilliseconds() - StartTime);
+
+		CVertexShare* Share = new CVertexShare;
+		StartTime = appMilliseconds();
+		Share->Prepare(NumVerts);
+		for (int i = 0; i < NumVerts; i++)
+			Share->AddVertex(M.Pos[i], M.Normal[i], M.Extra[i]);
+		appSprintf(ARRAY_ARG(Result[1]), "%d ms", appMilliseconds() - StartTime);
+		if (!M.Verify(*Share))
+		{
+			appStrncpyz(Result[1], "MISMATCH", ARRAY_COUNT(Result[1]));
+			bResult = false;
+		}
+		delete Share;
+
+#if USE_HASHING && THREADING
+		// Call AddVerticesParallel() directly, AddVertices() uses it for large meshes with enough threads only
+		Share = new CVertexShare;
+		StartTime = appMilliseconds();
+		Share->Prepare(NumVerts);
+		auto GetVertex = [&M](int Index, CVec3& Pos, CPackedNormal& Normal, uint32& ExtraInfo)
+		{
+			Pos = M.Pos[Index];
+			Normal = M.Normal[Index];
+			ExtraInfo = M.Extra[Index];
+		};
+		Share->AddVerticesParallel(NumVerts, GetVertex);
+		appSprintf(ARRAY_ARG(Result[2]), "%d ms", appMilliseconds() - StartTime);
+		if (!M.Verify(*Share))
+		{
+			appStrncpyz(Result[2], "MISMATCH", ARRAY_COUNT(Result[2]));
+			bResult = false;
+		}
+		delete Share;
 #else
-			DW.Normal.SetW(binormalScale);
-#endif
+		appStrncpyz(Result[2], "-", ARRAY_COUNT(Result[2]));
+#endif // USE_HASHING && THREADING
+
+		appPrintf("%-6s %8d %8d %10s %10s %10s\n", M.Name, NumVerts, M.PointToWedge.Num(), Result[0], Result[1], Result[2]);
+	}
+
+	appPrintf(bResult ? "CVertexShare: all results are identical to reference\n" : "CVertexShare: MISMATCH found\n");
+	return bResult;
+
+	unguard;
+}
+
+// Index passes of BuildNormalsCommon() and BuildTangentsCommon(): find the last corner referencing every vertex,
+// and gather positions of triangle corners. Index is either CIndexAccessorRef or a typed pointer.
+template<typename T>
+static void IndexPasses(const T& Index, int NumTris, const CVec3* Pos, int* LastCorner, CVec3& Sum)
+{
+	for (int i = 0; i < NumTris * 3; i++)
+		LastCorner[Index[i]] = i;
+	Sum.Set(0, 0, 0);
+	for (int i = 0; i < NumTris; i++)
+	{
+		for (int j = 0; j < 3; j++)
+			VectorAdd(Sum, Pos[Index[i * 3 + j]], Sum);
+	}
+}
+
+// Adapter for using IndexAccessor_t with IndexPasses()
+struct CIndexAccessorRef
+{
+	mutable CIndexBuffer::IndexAccessor_t Accessor;
+	FORCEINLINE int operator[](int i) const
+	{
+		return Accessor(i);
+	}
+};
+
+bool BenchmarkIndexAccess()
+{
+	guard(BenchmarkIndexAccess);
+
+	const int NumRounds = 10;
+	appPrintf("Verifying typed index access with IndexAccessor_t\n");
+	appPrintf("%-6s %8s %8s %10s %10s %10s\n", "Index", "Verts", "Tris", "accessor", "typed", "normals");
+
+	bool bResult = true;
+	for (int Pass = 0; Pass < 2; Pass++)
+	{
+		// 32-bit: single grid with 1M vertices, 16-bit: 256x256 grid repeated to get the same number of triangles
+		bool b32Bit = (Pass == 1);
+		int GridSize = b32Bit ? 1001 : 256;
+		int NumVerts = GridSize * GridSize;
+		int NumGridTris = (GridSize - 1) * (GridSize - 1) * 2;
+		int NumCopies = (2000000 + NumGridTris - 1) / NumGridTris;
+		int NumTris = NumGridTris * NumCopies;
+
+		CMeshVertex* Verts = (CMeshVertex*)appMalloc(sizeof(CMeshVertex) * NumVerts, 16);
+		TArray<CVec3> Pos;
+		Pos.AddUninitialized(NumVerts);
+		for (int y = 0; y < GridSize; y++)
+		{
+			for (int x = 0; x < GridSize; x++)
+			{
+				int i = y * GridSize + x;
+				Pos[i].Set(x, y, sinf(x * 0.1f) * cosf(y * 0.13f) * 5);
+				Verts[i].Position = Pos[i];
+				Verts[i].UV.U = x / float(GridSize);
+				Verts[i].UV.V = y / float(GridSize);
+			}
 		}
+
+		CIndexBuffer Indices;
+		for (int Copy = 0; Copy < NumCopies; Copy++)
+		{
+			for (int y = 0; y < GridSize - 1; y++)
+			{
+				for (int x = 0; x < GridSize - 1; x++)
+				{
+					int v = y * GridSize + x;
+					int Quad[6] = { v, v + GridSize, v + 1, v + 1, v + GridSize, v + GridSize + 1 };
+					for (int k = 0; k < 6; k++)
+					{
+						if (b32Bit)
+							Indices.Indices32.Add(Quad[k]);
+						else
+							Indices.Indices16.Add(Quad[k]);
+					}
+				}
+			}
+		}
+
+		char Result[3][32];
+		TArray<int> LastCorner[2];
+		CVec3 Sum[2];
+		for (int Method = 0; Method < 2; Method++)
+		{
+			LastCorner[Method].AddUninitialized(NumVerts);
+			int StartTime = appMilliseconds();
+			for (int Round = 0; Round < NumRounds; Round++)
+			{
+				if (Method == 0)
+				{
+					CIndexAccessorRef Index;
+					Index.Accessor = Indices.GetAccessor();
+					IndexPasses(Index, NumTris, Pos.GetData(), LastCorner[0].GetData(), Sum[0]);
+				}
+				else
+				{
+					Indices.ForEach16or32([&](const auto* Index)
+					{
+						IndexPasses(Index, NumTris, Pos.GetData(), LastCorner[1].GetData(), Sum[1]);
+					});
+				}
+			}
+			appSprintf(ARRAY_ARG(Result[Method]), "%d ms", appMilliseconds() - StartTime);
+		}
+		if (memcmp(LastCorner[0].GetData(), LastCorner[1].GetData(), NumVerts * sizeof(int)) != 0 ||
+			memcmp(&Sum[0], &Sum[1], sizeof(CVec3)) != 0)
+		{
+			appStrncpyz(Result[1], "MISMATCH", ARRAY_COUNT(Result[1]));
+			bResult = false;
+		}
+
+		// Whole normals and tangents computation for comparison
+		int StartTime = appMilliseconds();
+		BuildNormalsCommon(Verts, sizeof(CMeshVertex), NumVerts, Indices);
+		BuildTangentsCommon(Verts, sizeof(CMeshVertex), NumVerts, Indices);
+		appSprintf(ARRAY_ARG(Result[2]), "%d ms", appMilliseconds() - StartTime);
+		appFree(Verts);
+
+		appPrintf("%-6s %8d %8d %10s %10s %10s\n", b32Bit ? "32-bit" : "16-bit", NumVerts, NumTris, Result[0], Result[1], Result[2]);
 	}
 
+	appPrintf(bResult ? "Index access: all results are identical to IndexAccessor_t\n" : "Index access: MISMATCH found\n");
+	return bResult;
+
 	unguard;
 }
 
@@ -52,6 +52,18 @@ struct CIndexBuffer
 		return result;
 	}
 
+	// Call Func with a pointer to index data, typed as 'const uint16*' or 'const uint32*'. This resolves
+	// index type once per buffer instead of doing an indirect call per index (as IndexAccessor_t does).
+	// Usage: Indices.ForEach16or32([&](const auto* Index) { ... Index[i] ... });
+	template<typename F>
+	FORCEINLINE void ForEach16or32(F&& Func) const
+	{
+		if (Is32Bit())
+			Func(Indices32.GetData());
+		else
+			Func(Indices16.GetData());
+	}
+
 	void Initialize(const TArray<uint16> *Idx16, const TArray<uint32> *Idx32 = NULL)
 	{
 		if (Idx32 && Idx32->Num())
@@ -206,7 +218,10 @@ struct CBaseMeshLod
 };
 
 void BuildNormalsCommon(CMeshVertex *Verts, int VertexSize, int NumVerts, const CIndexBuffer &Indices);
-void BuildTangentsCommon(CMeshVertex *Verts, int VertexSize, const CIndexBuffer &Indices);
+void BuildTangentsCommon(CMeshVertex *Verts, int VertexSize, int NumVerts, const CIndexBuffer &Indices);
+
+// Compare index passes done with IndexAccessor_t and CIndexBuffer::ForEach16or32()
+bool BenchmarkIndexAccess();
 
 
 #endif // __MESH_COMMON_H__
@@ -286,7 +286,7 @@ void CSkeletalMesh::FinalizeMesh()
 
 #define MAX_LINEAR_KEYS		4
 
-static int FindTimeKey(const TArray<float> &KeyTime, float Frame)
+static int FindTimeKey(const TAnimKeyView<float> &KeyTime, float Frame)
 {
 	guard(FindTimeKey);
 
@@ -322,7 +322,7 @@ static int FindTimeKey(const TArray<float> &KeyTime, float Frame)
 
 // In:  KeyTime, Frame, NumFrames, Loop
 // Out: X - previous key index, Y - next key index, F - fraction between keys
-static void GetKeyParams(const TArray<float> &KeyTime, float Frame, float NumFrames, bool Loop, int &X, int &Y, float &F)
+static void GetKeyParams(const TAnimKeyView<float> &KeyTime, float Frame, float NumFrames, bool Loop, int &X, int &Y, float &F)
 {
 	guard(GetKeyParams);
 	X = FindTimeKey(KeyTime, Frame);
@@ -353,9 +353,9 @@ static void GetKeyParams(const TArray<float> &KeyTime, float Frame, float NumFra
 
 
 // not 'static', because used in ExportPsa()
-void CAnimTrack::GetBonePosition(float Frame, float NumFrames, bool Loop, CVec3 &DstPos, CQuat &DstQuat) const
+void CAnimTrackView::GetBonePosition(float Frame, float NumFrames, bool Loop, CVec3 &DstPos, CQuat &DstQuat) const
 {
-	guard(CAnimTrack::GetBonePosition);
+	guard(CAnimTrackView::GetBonePosition);
 
 	// fast case: 1 frame only
 	if (KeyTime.Num() == 1 || NumFrames == 1 || Frame == 0)
@@ -482,3 +482,60 @@ void CAnimTrack::CopyFrom(const CAnimTrack &Src)
 	CopyArray(KeyScaleTime, Src.KeyScaleTime);
 #endif
 }
+
+
+template<typename T>
+static FORCEINLINE void CopyKeys(byte*& Dst, const TArray<T>& Src, int& NumKeys)
+{
+	NumKeys = Src.Num();
+	memcpy(Dst, Src.GetData(), NumKeys * sizeof(T));
+	Dst += NumKeys * sizeof(T);
+}
+
+void CAnimSequence::Pack()
+{
+	guard(CAnimSequence::Pack);
+
+	int NumSrcTracks = Tracks.Num();
+	if (!NumSrcTracks) return;
+	assert(!KeyData);
+
+	// Compute size of data block
+	int DataSize = NumSrcTracks * sizeof(CAnimTrackInfo);
+	for (const CAnimTrack* Track : Tracks)
+	{
+		DataSize += Track->KeyQuat.Num() * sizeof(CQuat) + Track->KeyPos.Num() * sizeof(CVec3)
+			+ (Track->KeyTime.Num() + Track->KeyQuatTime.Num() + Track->KeyPosTime.Num()) * sizeof(float);
+#if SUPPORT_SCALE_KEYS
+		DataSize += Track->KeyScale.Num() * sizeof(CVec3) + Track->KeyScaleTime.Num() * sizeof(float);
+#endif
+	}
+
+	// Copy keys, order of arrays should match CAnimSequence::GetTrack()
+	KeyData = (byte*)appMallocNoInit(DataSize);
+	CAnimTrackInfo* Info = (CAnimTrackInfo*)KeyData;
+	byte* Dst = KeyData + NumSrcTracks * sizeof(CAnimTrackInfo);
+	for (int i = 0; i < NumSrcTracks; i++, Info++)
+	{
+		CAnimTrack* Track = Tracks[i];
+		Info->Offset = Dst - KeyData;
+		CopyKeys(Dst, Track->KeyQuat, Info->NumQuatKeys);
+		CopyKeys(Dst, Track->KeyPos, Info->NumPosKeys);
+#if SUPPORT_SCALE_KEYS
+		CopyKeys(Dst, Track->KeyScale, Info->NumScaleKeys);
+#endif
+		CopyKeys(Dst, Track->KeyTime, Info->NumTimeKeys);
+		CopyKeys(Dst, Track->KeyQuatTime, Info->NumQuatTimeKeys);
+		CopyKeys(Dst, Track->KeyPosTime, Info->NumPosTimeKeys);
+#if SUPPORT_SCALE_KEYS
+		CopyKeys(Dst, Track->KeyScaleTime, Info->NumScaleTimeKeys);
+#endif
+		delete Track;
+	}
+	assert(Dst == KeyData + DataSize);
+
+	Tracks.Empty();
+	NumPackedTracks = NumSrcTracks;
+
+	unguard;
+}
@@ -75,7 +75,7 @@ struct CSkelMeshLod : public CBaseMeshLod
 	void BuildTangents()
 	{
 		if (HasTangents) return;
-		BuildTangentsCommon(Verts, sizeof(CSkelMeshVertex), Indices);
+		BuildTangentsCommon(Verts, sizeof(CSkelMeshVertex), NumVerts, Indices);
 		HasTangents = true;
 	}
 
@@ -232,12 +232,14 @@ private:
 	  - UAnimSequence is always has at least one key for excluded bone (there is no empty arrays)
 */
 
-/*!!
-	Warning: very unoptimal data format. Each CAnimSequence has NumBones CAnimTrack's, each CAnimTrack has up to 5 arrays.
-	Ideally should put all the data into CAnimSequence as a single data block (like was done for UAnimSequence).
+/*
+	Animation data storage.
+	Animation loaders fill CAnimTrack for every bone, then CAnimSequence::Pack() moves all keys of the sequence
+	into a single memory block, and CAnimTrack objects are released. Loaded animation is accessed with
+	CAnimSequence::GetTrack(), which returns CAnimTrackView pointing to that block.
 */
 
-
+// Animation track used while loading CAnimSequence
 struct CAnimTrack
 {
 	TStaticArray<CQuat, 1>	KeyQuat;
@@ -254,6 +256,61 @@ struct CAnimTrack
 	TStaticArray<float, 1>	KeyScaleTime;
 #endif
 
+	inline bool HasKeys() const
+	{
+#if !SUPPORT_SCALE_KEYS
+		return (KeyQuat.Num() + KeyPos.Num()) > 0;
+#else
+		return (KeyQuat.Num() + KeyPos.Num() + KeyScale.Num()) > 0;
+#endif
+	}
+
+	void CopyFrom(const CAnimTrack &Src);
+};
+
+// Read-only array of keys located in CAnimSequence's key block
+template<typename T>
+struct TAnimKeyView
+{
+	const T*				Data;
+	int						Count;
+
+	FORCEINLINE int Num() const
+	{
+		return Count;
+	}
+	FORCEINLINE const T* GetData() const
+	{
+		return Data;
+	}
+	FORCEINLINE const T& operator[](int Index) const
+	{
+		return Data[Index];
+	}
+	// Point to Num keys at Ptr, return pointer to data following these keys
+	FORCEINLINE const byte* Set(const byte* Ptr, int Num)
+	{
+		Data = (const T*)Ptr;
+		Count = Num;
+		return Ptr + Num * sizeof(T);
+	}
+};
+
+// Packed animation track, has the same arrays as CAnimTrack
+struct CAnimTrackView
+{
+	TAnimKeyView<CQuat>		KeyQuat;
+	TAnimKeyView<CVec3>		KeyPos;
+#if SUPPORT_SCALE_KEYS
+	TAnimKeyView<CVec3>		KeyScale;
+#endif
+	TAnimKeyView<float>		KeyTime;
+	TAnimKeyView<float>		KeyQuatTime;
+	TAnimKeyView<float>		KeyPosTime;
+#if SUPPORT_SCALE_KEYS
+	TAnimKeyView<float>		KeyScaleTime;
+#endif
+
 	// DstPos and/or DstQuat will not be changed when KeyPos and/or KeyQuat are empty.
 	void GetBonePosition(float Frame, float NumFrames, bool Loop, CVec3 &DstPos, CQuat &DstQuat) const;
 
@@ -265,8 +322,24 @@ struct CAnimTrack
 		return (KeyQuat.Num() + KeyPos.Num() + KeyScale.Num()) > 0;
 #endif
 	}
+};
 
-	void CopyFrom(const CAnimTrack &Src);
+// Location of track data inside of CAnimSequence's key block. Key arrays are stored one after another,
+// in the same order as they're declared in CAnimTrackView.
+struct CAnimTrackInfo
+{
+	uint32					Offset;
+	int						NumQuatKeys;
+	int						NumPosKeys;
+#if SUPPORT_SCALE_KEYS
+	int						NumScaleKeys;
+#endif
+	int						NumTimeKeys;
+	int						NumQuatTimeKeys;
+	int						NumPosTimeKeys;
+#if SUPPORT_SCALE_KEYS
+	int						NumScaleTimeKeys;
+#endif
 };
 
 // Local analog of FTransform
@@ -282,7 +355,7 @@ public:
 	FName					Name;					// sequence's name
 	int						NumFrames;
 	float					Rate;
-	TArray<CAnimTrack*>		Tracks;					// for each CAnimSet.TrackBoneNames
+	TArray<CAnimTrack*>		Tracks;					// for each CAnimSet.TrackBoneNames; used only while loading, see Pack()
 	bool					bAdditive;				// used just for on-screen information
 	const UObject*			OriginalSequence;
 	TArray<CSkeletonBonePosition> RetargetBasePose;
@@ -293,6 +366,8 @@ public:
 	CAnimSequence(const UObject* Original = NULL)
 	: bAdditive(false)
 	, OriginalSequence(Original)
+	, KeyData(NULL)
+	, NumPackedTracks(0)
 	{}
 
 	~CAnimSequence()
@@ -301,7 +376,41 @@ public:
 		{
 			delete Tracks[i];
 		}
+		if (KeyData) appFree(KeyData);
 	}
+
+	// Move keys of all Tracks into a single memory block and release Tracks. Should be called by animation
+	// loader when sequence is complete. Calling it for already packed sequence does nothing.
+	void Pack();
+
+	FORCEINLINE int NumTracks() const
+	{
+		return NumPackedTracks;
+	}
+
+	FORCEINLINE CAnimTrackView GetTrack(int TrackIndex) const
+	{
+		assert(unsigned(TrackIndex) < unsigned(NumPackedTracks));
+		const CAnimTrackInfo& Info = ((const CAnimTrackInfo*)KeyData)[TrackIndex];
+		const byte* Data = KeyData + Info.Offset;
+		CAnimTrackView Track;
+		Data = Track.KeyQuat.Set(Data, Info.NumQuatKeys);
+		Data = Track.KeyPos.Set(Data, Info.NumPosKeys);
+#if SUPPORT_SCALE_KEYS
+		Data = Track.KeyScale.Set(Data, Info.NumScaleKeys);
+#endif
+		Data = Track.KeyTime.Set(Data, Info.NumTimeKeys);
+		Data = Track.KeyQuatTime.Set(Data, Info.NumQuatTimeKeys);
+		Data = Track.KeyPosTime.Set(Data, Info.NumPosTimeKeys);
+#if SUPPORT_SCALE_KEYS
+		Data = Track.KeyScaleTime.Set(Data, Info.NumScaleTimeKeys);
+#endif
+		return Track;
+	}
+
+private:
+	byte*					KeyData;				// CAnimTrackInfo[NumPackedTracks] followed by keys of all tracks
+	int						NumPackedTracks;
 };
 
 
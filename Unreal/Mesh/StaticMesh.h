@@ -36,7 +36,7 @@ struct CStaticMeshLod : public CBaseMeshLod
 	void BuildTangents()
 	{
 		if (HasTangents) return;
-		BuildTangentsCommon(Verts, sizeof(CStaticMeshVertex), Indices);
+		BuildTangentsCommon(Verts, sizeof(CStaticMeshVertex), NumVerts, Indices);
 		HasTangents = true;
 	}
 
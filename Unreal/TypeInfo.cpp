@@ -4,6 +4,8 @@
 
 #include "UnObject.h"		// dumping UObject in a few places
 
+#include "Parallel.h"
+
 #define MAX_CLASSES		256
 #define MAX_ENUMS		32
 #define MAX_SUPPRESSED_CLASSES 32
@@ -20,26 +22,79 @@ static int GClassCount = 0;
 static const char* GSuppressedClasses[MAX_SUPPRESSED_CLASSES];
 static int GSuppressedClassCount = 0;
 
+// Hash tables with indices of GClasses entries, with open addressing. Entries with the same name are
+// placed in probe order matching GClasses order, so lookup returns the same class as a linear search.
+// Tables are updated when classes are registered or unregistered, and only read after that, so lookups
+// could be done from any thread.
+#define CLASS_HASH_SIZE		(MAX_CLASSES * 2)
+static int16 GClassHash[CLASS_HASH_SIZE];			// by full name (structure lookup)
+static int16 GClassShortHash[CLASS_HASH_SIZE];		// by name without 'U'/'F' prefix (class lookup)
+
+static uint32 GetClassNameHash(const char* Name)
+{
+	// Case-insensitive FNV-1a
+	uint32 Hash = 0x811C9DC5;
+	while (char c = *Name++)
+	{
+		if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+		Hash = (Hash ^ c) * 0x01000193;
+	}
+	return Hash;
+}
+
+static void AddClassToHash(int16* Hash, const char* Name, int ClassIndex)
+{
+	uint32 Index = GetClassNameHash(Name) & (CLASS_HASH_SIZE - 1);
+	while (Hash[Index] >= 0)
+		Index = (Index + 1) & (CLASS_HASH_SIZE - 1);
+	Hash[Index] = ClassIndex;
+}
+
+static void RebuildClassHash()
+{
+	memset(GClassHash, -1, sizeof(GClassHash));
+	memset(GClassShortHash, -1, sizeof(GClassShortHash));
+	for (int i = 0; i < GClassCount; i++)
+	{
+		AddClassToHash(GClassHash, GClasses[i].Name, i);
+		AddClassToHash(GClassShortHash, GClasses[i].Name + 1, i);
+	}
+}
+
+// Find first GClasses entry with matching name. 'NameOffset' is 1 for search by class name
+// without prefix, or 0 for the full name.
+static int FindClassIndex(const char* Name, int NameOffset, bool CaseSensitive)
+{
+	if (!GClassCount) return -1;
+	const int16* Hash = NameOffset ? GClassShortHash : GClassHash;
+	for (uint32 Index = GetClassNameHash(Name) & (CLASS_HASH_SIZE - 1); /* empty */; Index = (Index + 1) & (CLASS_HASH_SIZE - 1))
+	{
+		int ClassIndex = Hash[Index];
+		if (ClassIndex < 0) return -1;
+		const char* ClassName = GClasses[ClassIndex].Name + NameOffset;
+		if ((CaseSensitive ? strcmp(ClassName, Name) : stricmp(ClassName, Name)) == 0)
+			return ClassIndex;
+	}
+}
+
 void RegisterClasses(const CClassInfo* Table, int Count)
 {
 	if (Count <= 0) return;
 	assert(GClassCount + Count < ARRAY_COUNT(GClasses));
+	if (!GClassCount) RebuildClassHash();
 	for (int i = 0; i < Count; i++)
 	{
 		const char* ClassName = Table[i].Name;
-		bool duplicate = false;
-		for (int j = 0; j < GClassCount; j++)
+		int j = FindClassIndex(ClassName, 0, true);
+		if (j >= 0)
 		{
-			if (!strcmp(GClasses[j].Name, ClassName))
-			{
-				// Overriding class with a different typeinfo (for example, overriding UE3 class with UE4 one)
-				GClasses[j] = Table[i];
-				duplicate = true;
-				break;
-			}
+			// Overriding class with a different typeinfo (for example, overriding UE3 class with UE4 one)
+			GClasses[j] = Table[i];
 		}
-		if (!duplicate)
+		else
 		{
+			AddClassToHash(GClassHash, ClassName, GClassCount);
+			AddClassToHash(GClassShortHash, ClassName + 1, GClassCount);
 			GClasses[GClassCount++] = Table[i];
 		}
 	}
@@ -53,6 +108,7 @@ void RegisterClasses(const CClassInfo* Table, int Count)
 
 void UnregisterClass(const char* Name, bool WholeTree)
 {
+	bool bRemoved = false;
 	for (int i = 0; i < GClassCount; i++)
 		if (!strcmp(GClasses[i].Name + 1, Name) ||
 			(WholeTree && (GClasses[i].TypeInfo()->IsA(Name))))
@@ -61,16 +117,19 @@ void UnregisterClass(const char* Name, bool WholeTree)
 			appPrintf("Unregister %s\n", GClasses[i].Name);
 #endif
 			// class was found
+			bRemoved = true;
 			if (i == GClassCount-1)
 			{
 				// last table entry
 				GClassCount--;
-				return;
+				break;
 			}
 			memcpy(GClasses+i, GClasses+i+1, (GClassCount-i-1) * sizeof(GClasses[0]));
 			GClassCount--;
 			i--;
 		}
+	// Class indices were changed
+	if (bRemoved) RebuildClassHash();
 }
 
 
@@ -91,18 +150,10 @@ const CTypeInfo* FindClassType(const char* Name, bool ClassType)
 #if DEBUG_TYPES
 	appPrintf("--- find %s %s ... ", ClassType ? "class" : "struct", Name);
 #endif
-	for (int i = 0; i < GClassCount; i++)
+	// skip 1st char only for ClassType==true?
+	int i = FindClassIndex(Name, ClassType ? 1 : 0, false);
+	if (i >= 0)
 	{
-		// skip 1st char only for ClassType==true?
-		if (ClassType)
-		{
-			if (stricmp(GClasses[i].Name + 1, Name) != 0) continue;
-		}
-		else
-		{
-			if (stricmp(GClasses[i].Name, Name) != 0) continue;
-		}
-
 		if (!GClasses[i].TypeInfo) appError("No typeinfo for class");
 		const CTypeInfo *Type = GClasses[i].TypeInfo();
 		// FindUnversionedProp() calls FindStructType for classes and structs, so disable the comparison for now
@@ -217,12 +268,16 @@ struct PropPatch
 
 static TArray<PropPatch> Patches;
 
+// Incremented when FindProperty() results could change, makes all CPropCache tables obsolete
+static int GPropCacheGeneration = 0;
+
 /*static*/ void CTypeInfo::RemapProp(const char *ClassName, const char *OldName, const char *NewName)
 {
 	PropPatch *p = new (Patches) PropPatch;
 	p->ClassName = ClassName;
 	p->OldName   = OldName;
 	p->NewName   = NewName;
+	GPropCacheGeneration++;
 }
 
 const CPropInfo *CTypeInfo::FindProperty(const char *Name) const
@@ -275,6 +330,195 @@ const CPropInfo *CTypeInfo::FindProperty(const char *Name) const
 }
 
 
+// Open addressing hash table which maps pooled property name pointer to FindProperty() result,
+// including NULL results for unknown properties. Lookups are lock-free: entries are never removed,
+// and a table is never modified except adding entries, a larger table replaces the current one
+// when it becomes too full. Replaced tables are kept alive because other threads may still use them.
+struct CPropCache
+{
+	struct Entry
+	{
+		const char* volatile Key;
+		const CPropInfo* Value;
+	};
+
+	CPropCache*		Prev;
+	int				Generation;
+	int				Mask;
+	volatile int32	Count;
+	Entry			Entries[1];
+
+	static FORCEINLINE uint32 GetHash(const char* Key)
+	{
+		// Pooled strings are aligned, drop low bits
+		size_t Value = (size_t)Key;
+		return (uint32)((Value >> 3) ^ (Value >> 13));
+	}
+
+	FORCEINLINE const Entry* Find(const char* Key) const
+	{
+		for (uint32 Index = GetHash(Key) & Mask; /* empty */; Index = (Index + 1) & Mask)
+		{
+			const Entry& E = Entries[Index];
+			const char* EntryKey = E.Key;
+			if (EntryKey == Key) return &E;
+			if (!EntryKey) return NULL;
+		}
+	}
+};
+
+#if THREADING
+static CMutex GPropCacheMutex;
+#endif
+
+const CPropInfo *CTypeInfo::FindProperty(const FName& Name) const
+{
+	const char* Key = Name.Str;
+
+	const CPropCache* Cache = *(CPropCache* volatile*)&PropCache;
+	if (Cache && Cache->Generation == GPropCacheGeneration)
+	{
+		if (const CPropCache::Entry* E = Cache->Find(Key))
+			return E->Value;
+	}
+
+	const CPropInfo* Prop = FindProperty(Key);
+
+#if THREADING
+	CMutex::ScopedLock Lock(GPropCacheMutex);
+#endif
+	CPropCache* Current = PropCache;
+	if (Current && Current->Generation != GPropCacheGeneration)
+	{
+		Current = NULL;
+	}
+	if (Current && Current->Find(Key))
+	{
+		// Added by another thread
+		return Prop;
+	}
+	if (!Current || (Current->Count + 1) * 2 > Current->Mask + 1)
+	{
+		// Create a new table, copy existing entries
+		int Size = Current ? (Current->Mask + 1) * 2 : 64;
+		CPropCache* NewCache = (CPropCache*)appMalloc(sizeof(CPropCache) + (Size - 1) * sizeof(CPropCache::Entry));
+		NewCache->Prev = PropCache;
+		NewCache->Generation = GPropCacheGeneration;
+		NewCache->Mask = Size - 1;
+		NewCache->Count = 0;
+		if (Current)
+		{
+			for (int i = 0; i <= Current->Mask; i++)
+			{
+				const CPropCache::Entry& E = Current->Entries[i];
+				if (!E.Key) continue;
+				uint32 Index = CPropCache::GetHash(E.Key) & NewCache->Mask;
+				while (NewCache->Entries[Index].Key)
+					Index = (Index + 1) & NewCache->Mask;
+				NewCache->Entries[Index] = E;
+				NewCache->Count++;
+			}
+		}
+		Current = NewCache;
+	}
+
+	// Add the entry
+	uint32 Index = CPropCache::GetHash(Key) & Current->Mask;
+	while (Current->Entries[Index].Key)
+		Index = (Index + 1) & Current->Mask;
+	CPropCache::Entry& E = Current->Entries[Index];
+	E.Value = Prop;
+	// InterlockedIncrement is a memory barrier: the entry value and contents of a new table become visible
+	// to other threads before the entry key and the table pointer.
+	InterlockedIncrement(&Current->Count);
+	E.Key = Key;
+	PropCache = Current;
+
+	return Prop;
+}
+
+
+// Compare FindProperty(FName) with linear FindProperty(const char*) for names of all properties of all
+// registered classes, plus names which are not found. Each class is looked up with names of its parents too,
+// this is what ReadUnrealProperty() is doing for serialized tags.
+bool BenchmarkFindProperty()
+{
+	guard(BenchmarkFindProperty);
+
+	struct CPropLookup
+	{
+		const CTypeInfo* Type;
+		FName Name;
+		const CPropInfo* Result;
+	};
+
+	TArray<CPropLookup> Lookups;
+	for (int ClassIndex = 0; ClassIndex < GClassCount; ClassIndex++)
+	{
+		const CTypeInfo* Type = GClasses[ClassIndex].TypeInfo();
+		for (const CTypeInfo* Type2 = Type; Type2; Type2 = Type2->Parent)
+		{
+			for (int i = 0; i < Type2->NumProps; i++)
+			{
+				CPropLookup* L = new (Lookups) CPropLookup;
+				L->Type = Type;
+				L->Name = Type2->Props[i].Name;
+			}
+		}
+		CPropLookup* L = new (Lookups) CPropLookup;
+		L->Type = Type;
+		L->Name = "UnknownProperty";
+	}
+
+	const int NumRounds = 1000;
+	appPrintf("Verifying FindProperty: %d classes, %d lookups x %d rounds\n", GClassCount, Lookups.Num(), NumRounds);
+	appPrintf("%10s %10s %10s\n", "linear", "cached", "parallel");
+
+	char Result[3][32];
+	int StartTime = appMilliseconds();
+	for (int Round = 0; Round < NumRounds; Round++)
+	{
+		for (CPropLookup& L : Lookups)
+			L.Result = L.Type->FindProperty(*L.Name);
+	}
+	appSprintf(ARRAY_ARG(Result[0]), "%d ms", appMilliseconds() - StartTime);
+
+	int NumErrors = 0;
+	StartTime = appMilliseconds();
+	for (int Round = 0; Round < NumRounds; Round++)
+	{
+		for (const CPropLookup& L : Lookups)
+		{
+			if (L.Type->FindProperty(L.Name) != L.Result) NumErrors++;
+		}
+	}
+	appSprintf(ARRAY_ARG(Result[1]), "%d ms", appMilliseconds() - StartTime);
+	if (NumErrors) appStrncpyz(Result[1], "MISMATCH", ARRAY_COUNT(Result[1]));
+
+	// Start with empty tables, so threads are filling them concurrently
+	GPropCacheGeneration++;
+	volatile int32 NumParallelErrors = 0;
+	StartTime = appMilliseconds();
+	ParallelFor(NumRounds, [&Lookups, &NumParallelErrors](int Round)
+		{
+			for (const CPropLookup& L : Lookups)
+			{
+				if (L.Type->FindProperty(L.Name) != L.Result) InterlockedIncrement(&NumParallelErrors);
+			}
+		});
+	appSprintf(ARRAY_ARG(Result[2]), "%d ms", appMilliseconds() - StartTime);
+	if (NumParallelErrors) appStrncpyz(Result[2], "MISMATCH", ARRAY_COUNT(Result[2]));
+
+	appPrintf("%10s %10s %10s\n", Result[0], Result[1], Result[2]);
+
+	bool bResult = (NumErrors == 0 && NumParallelErrors == 0);
+	appPrintf(bResult ? "FindProperty: all results are identical to linear search\n" : "FindProperty: MISMATCH found\n");
+	return bResult;
+
+	unguard;
+}
+
+
 /*-----------------------------------------------------------------------------
 	CTypeInfo dump functionality
 -----------------------------------------------------------------------------*/
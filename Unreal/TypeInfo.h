@@ -131,6 +131,8 @@ struct CTypeInfo
 	uint32			TypeFlags;
 	void (*Constructor)(void*);
 	void (*NativeSerializer)(FArchive&, void*);
+	// Lazily created FindProperty(FName) lookup table
+	mutable struct CPropCache* PropCache;
 	// methods
 	constexpr FORCEINLINE CTypeInfo(const char *AName, const CTypeInfo *AParent, int DataSize,
 					 const CPropInfo *AProps, int PropCount, uint32 Flags,
@@ -143,6 +145,7 @@ struct CTypeInfo
 	,	TypeFlags(Flags)
 	,	Constructor(AConstructor)
 	,	NativeSerializer(ASerializer)
+	,	PropCache(NULL)
 	{}
 	inline bool IsClass() const
 	{
@@ -150,6 +153,8 @@ struct CTypeInfo
 	}
 	bool IsA(const char *TypeName) const;
 	const CPropInfo *FindProperty(const char *Name) const;
+	// Faster version for pooled names: results are cached by string pointer
+	const CPropInfo *FindProperty(const FName& Name) const;
 	static void RemapProp(const char *Class, const char *OldName, const char *NewName);
 
 	// Serialize Unreal engine UObject property block
@@ -320,6 +325,8 @@ void SuppressUnknownClass(const char* ClassNameWildcard);
 const CTypeInfo* FindClassType(const char* Name, bool ClassType = true);
 bool IsSuppressedClass(const char* Name);
 
+bool BenchmarkFindProperty();
+
 FORCEINLINE const CTypeInfo *FindStructType(const char *Name)
 {
 	return FindClassType(Name, false);
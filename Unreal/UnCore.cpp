@@ -14,11 +14,19 @@ byte GForcePlatform       = PLATFORM_UNKNOWN;
 
 uint32 GNumSerialize = 0;
 uint32 GSerializeBytes = 0;
+uint32 GNumDecompressBlocks = 0;
+uint64 GDecompressBytes = 0;
+uint32 GDecompressTime = 0;
+uint32 GBlockCacheHits = 0;
+uint32 GBlockCacheMisses = 0;
 static int ProfileStartTime = -1;
 
 void appResetProfiler()
 {
 	GNumAllocs = GNumSerialize = GSerializeBytes = 0;
+	GNumDecompressBlocks = GDecompressTime = 0;
+	GBlockCacheHits = GBlockCacheMisses = 0;
+	GDecompressBytes = 0;
 	ProfileStartTime = appMilliseconds();
 }
 
@@ -32,6 +40,17 @@ void appPrintProfiler(const char* label)
 	appPrintf("%s in %.1f sec, %d allocs, %.2f MBytes serialized in %d calls.\n",
 		label ? label : "Loaded",
 		timeDelta, GNumAllocs, GSerializeBytes / (1024.0f * 1024.0f), GNumSerialize);
+	if (GNumDecompressBlocks)
+	{
+		float decompressMb = GDecompressBytes / (1024.0f * 1024.0f);
+		appPrintf("... %.2f MBytes decompressed in %d blocks (%.1f MBytes/sec)\n",
+			decompressMb, GNumDecompressBlocks, decompressMb / max(GDecompressTime / 1000.0f, 0.001f));
+	}
+	if (GBlockCacheHits + GBlockCacheMisses)
+	{
+		appPrintf("... block cache: %d hits, %d misses (%.1f%% hit rate)\n",
+			GBlockCacheHits, GBlockCacheMisses, GBlockCacheHits * 100.0f / (GBlockCacheHits + GBlockCacheMisses));
+	}
 	appResetProfiler();
 }
 
@@ -497,20 +516,46 @@ void FString::TrimStartAndEndInline()
 -----------------------------------------------------------------------------*/
 
 #define STRING_HASH_SIZE		(65536*4)		// 1Mb of 32-bit pointers
+#define STRING_POOL_SHARDS		64				// number of independent locks and memory pools
 
 struct CStringPoolEntry
 {
-	CStringPoolEntry*	HashNext;
+	CStringPoolEntry* volatile HashNext;
 	uint16				Length;
 	char				Str[1];
 };
 
-static CStringPoolEntry* StringHashTable[STRING_HASH_SIZE];
-static CMemoryChain* StringPool;
-
+// Lookups are lock-free: a new entry is fully initialized before it is linked into the hash chain, and
+// entries are never removed. Insertion locks only the shard which owns the hash chain, so threads adding
+// different strings rarely wait for each other.
+struct CStringPoolShard
+{
 #if THREADING
-static CMutex GStrdupPoolMutex;
+	CMutex				Mutex;
 #endif
+	CMemoryChain*		Pool;
+	volatile int32		NumStrings;
+};
+
+static CStringPoolEntry* volatile StringHashTable[STRING_HASH_SIZE];
+static CStringPoolShard StringPoolShards[STRING_POOL_SHARDS];
+
+static FORCEINLINE const char* FindPoolString(CStringPoolEntry* volatile*& prevPoint, const char* str, int len)
+{
+	while (true)
+	{
+		CStringPoolEntry* current = *prevPoint;
+		// Keep items sorted by string length - it is almost free, but will
+		// allow faster rejection during search.
+		if (!current || current->Length > len) return NULL;
+		if (current->Length == len && !memcmp(str, current->Str, len))
+		{
+			// Found a string
+			return current->Str;
+		}
+		prevPoint = &current->HashNext;
+	}
+}
 
 const char* appStrdupPool(const char* str)
 {
@@ -538,118 +583,72 @@ const char* appStrdupPool(const char* str)
 #endif
 	hash &= (STRING_HASH_SIZE - 1);
 
+	// Find existing string in a pool, without locking
+	CStringPoolEntry* volatile* prevPoint = &StringHashTable[hash];
+	if (const char* found = FindPoolString(prevPoint, str, len))
+		return found;
+
+	CStringPoolShard& Shard = StringPoolShards[hash & (STRING_POOL_SHARDS - 1)];
 #if THREADING
-	// Make appStrdupPool thread-safe
-	CMutex::ScopedLock Lock(GStrdupPoolMutex);
+	CMutex::ScopedLock Lock(Shard.Mutex);
+	// The string could be added by another thread after the search above. Only threads holding this
+	// shard's lock could modify this chain, so repeat the search from the beginning.
+	prevPoint = &StringHashTable[hash];
+	if (const char* found = FindPoolString(prevPoint, str, len))
+		return found;
 #endif
 
-	// Find existing string in a pool
-	CStringPoolEntry** prevPoint = &StringHashTable[hash];
-	while (true)
-	{
-		CStringPoolEntry* current = *prevPoint;
-		// Keep items sorted by string length - it is almost free, but will
-		// allow faster rejection during search.
-		if (!current || current->Length > len) break;
-		if (current->Length == len && !memcmp(str, current->Str, len))
-		{
-			// Found a string
-			return current->Str;
-		}
-		prevPoint = &current->HashNext;
-	}
-
-	if (!StringPool) StringPool = new CMemoryChain();
+	if (!Shard.Pool) Shard.Pool = new CMemoryChain();
 
 	// Allocate new string from pool
-	CStringPoolEntry* n = (CStringPoolEntry*)StringPool->Alloc(sizeof(CStringPoolEntry) + len);	// note: null byte is taken into account in CStringPoolEntry
+	CStringPoolEntry* n = (CStringPoolEntry*)Shard.Pool->Alloc(sizeof(CStringPoolEntry) + len);	// note: null byte is taken into account in CStringPoolEntry
 	n->Length = len;
 	memcpy(n->Str, str, len+1);
-	// Insert into the hash collision chain
 	n->HashNext = *prevPoint;
+	// InterlockedIncrement is a full memory barrier: entry contents become visible to other threads
+	// before the entry is linked into the chain.
+	InterlockedIncrement(&Shard.NumStrings);
+	// Insert into the hash collision chain
 	*prevPoint = n;
 
 	return n->Str;
 }
 
-#if 0
-void PrintStringHashDistribution()
+void appPrintStringPoolStats()
 {
-	int totalCount = 0;
-	uint32 memoryUsed = sizeof(StringHashTable);
-	int hashCounts[1024];
-	int* bucketSizes = new int[STRING_HASH_SIZE];
-	memset(hashCounts, 0, sizeof(hashCounts));
-	memset(bucketSizes, 0, sizeof(bucketSizes));
+	int NumStrings = 0;
+	size_t MemoryUsed = sizeof(StringHashTable);
+	for (const CStringPoolShard& Shard : StringPoolShards)
+	{
+		NumStrings += Shard.NumStrings;
+		if (Shard.Pool) MemoryUsed += Shard.Pool->GetSize();
+	}
 
-	// Collect statistics
+	// Collect chain length distribution
+	int ChainCounts[16];
+	memset(ChainCounts, 0, sizeof(ChainCounts));
+	int UsedBuckets = 0, MaxChain = 0;
 	for (int hash = 0; hash < STRING_HASH_SIZE; hash++)
 	{
 		int count = 0;
 		for (CStringPoolEntry* info = StringHashTable[hash]; info; info = info->HashNext)
-		{
 			count++;
-			memoryUsed += sizeof(CStringPoolEntry) + info->Length;
-		}
-		assert(count < ARRAY_COUNT(hashCounts));
-		hashCounts[count]++;
-		bucketSizes[hash] = count;
-		totalCount += count;
+		if (count) UsedBuckets++;
+		if (count > MaxChain) MaxChain = count;
+		ChainCounts[min(count, ARRAY_COUNT(ChainCounts) - 1)]++;
 	}
 
-	// Print statistics
-	FILE* f = fopen("StringTableInfo.txt", "w");
-	fprintf(f, "%d strings, %.2f Mb used\n", totalCount, memoryUsed / (1024.0f * 1024.0f));
-	fprintf(f, "String hash distribution: collision count -> num chains\n");
-	int totalCount2 = 0;
-	for (int i = 0; i < ARRAY_COUNT(hashCounts); i++)
+	appPrintf("String pool: %d strings, %.2f MBytes, %d/%d buckets used (%.1f%%), %.2f average and %d max chain length\n",
+		NumStrings, MemoryUsed / (1024.0f * 1024.0f), UsedBuckets, STRING_HASH_SIZE, UsedBuckets * 100.0f / STRING_HASH_SIZE,
+		UsedBuckets ? (float)NumStrings / UsedBuckets : 0.0f, MaxChain);
+	appPrintf("Chain length -> buckets:");
+	for (int i = 1; i < ARRAY_COUNT(ChainCounts); i++)
 	{
-		int count = hashCounts[i];
-		if (count > 0)
-		{
-			totalCount2 += count * i;
-			float percent = totalCount2 * 100.0f / totalCount;
-			fprintf(f, "%d -> %d [%.1f%%]\n", i, count, percent);
-		}
+		if (ChainCounts[i])
+			appPrintf(" %d%s:%d", i, (i == ARRAY_COUNT(ChainCounts) - 1) ? "+" : "", ChainCounts[i]);
 	}
-	fclose(f);
-	assert(totalCount == totalCount2);
-
-	// Store string table to a file
-	f = fopen("StringTable.txt", "w");
-	// Sort by bucket sizes
-	for (int i = ARRAY_COUNT(hashCounts) - 1; i > 0; i--)
-	{
-		if (hashCounts[i] == 0) continue; // no buckets of this size
-
-		for (int hash = 0; hash < STRING_HASH_SIZE; hash++)
-		{
-			if (bucketSizes[hash] != i) continue;
-			fprintf(f, "# bucket %d items\n", i);
-			TStaticArray<const CStringPoolEntry*, 1024> Entries;
-			for (CStringPoolEntry* info = StringHashTable[hash]; info; info = info->HashNext)
-			{
-				Entries.Add(info);
-			}
-			Entries.Sort([](const CStringPoolEntry* const& A, const CStringPoolEntry* const& B) -> int
-				{
-					int Diff = A->Length - B->Length;
-					if (Diff) return Diff; // note: already have items sorted by string length
-					return stricmp(A->Str, B->Str);
-				});
-			for (const CStringPoolEntry* info : Entries)
-			{
-				fprintf(f, "%s\n", info->Str);
-			}
-			fprintf(f, "\n");
-		}
-	}
-	fclose(f);
-
-	// Cleanup
-	delete[] bucketSizes;
+	appPrintf("\n");
 }
-#endif
 
 
 /*-----------------------------------------------------------------------------
@@ -63,6 +63,13 @@ class UnPackage;
 #if PROFILE
 extern uint32 GNumSerialize;
 extern uint32 GSerializeBytes;
+// Decompression of compressed container blocks
+extern uint32 GNumDecompressBlocks;
+extern uint64 GDecompressBytes;
+extern uint32 GDecompressTime;
+// Cache of decompressed blocks
+extern uint32 GBlockCacheHits;
+extern uint32 GBlockCacheMisses;
 
 void appResetProfiler();
 void appPrintProfiler(const char* label = NULL);
@@ -83,6 +90,16 @@ void appSetRootDirectory(const char *dir, bool recurse = true);
 // Set root directory from package file name
 void appSetRootDirectory2(const char *filename);
 const char *appGetRootDirectory();
+// Compare parallel directory listing with serial one, used by -bench=scan
+bool BenchmarkDirectoryScanner(const char *dir);
+
+#if UNREAL4
+// Directory for persistent game file index cache: pak directories and package scan results are stored
+// there, one file per game root. Empty string disables the cache.
+extern char GGameIndexCacheDir[];
+// Write the game file index cache, should be called when package scan results were updated
+void appSaveGameIndex();
+#endif
 
 // forwards
 class FString;
@@ -251,6 +268,8 @@ extern const char *GStartupPackage;
 -----------------------------------------------------------------------------*/
 
 const char* appStrdupPool(const char* str);
+// Print string pool occupancy statistics
+void appPrintStringPoolStats();
 
 class FName
 {
@@ -633,6 +652,14 @@ public:
 	virtual void Serialize(void *data, int size) = 0;
 	void ByteOrderSerialize(void *data, int size);
 
+	// Zero-copy access to archive data. Returns a pointer to 'Size' bytes at position 'Pos' when archive
+	// data is already in memory, or NULL - in this case data should be read with Serialize(). Does not
+	// change the archive position.
+	virtual const byte* GetDirectPointer(int64 Pos, int Size)
+	{
+		return NULL;
+	}
+
 	// "Stopper" is used to check for overrun serialization.
 	// Note: there's no 64-bit "stopper" - large files are used only as containers for smaller
 	// files, so stopper validation is performed on upper level, with 32-bit values.
@@ -855,6 +882,8 @@ protected:
 	int64		FilePos;		// where 'f' position points to (when reading, it usually equals to 'BufferPos + BufferSize')
 
 	bool OpenFile();
+	// Report file open error according to Options
+	void OpenFailed();
 };
 
 
@@ -894,6 +923,41 @@ protected:
 };
 
 
+// File reader which maps the whole file into memory. Serialize() copies data directly from the mapping,
+// and GetDirectPointer() provides access to file data without copying.
+class FMappedFileReader : public FFileArchive
+{
+	DECLARE_ARCHIVE(FMappedFileReader, FFileArchive);
+public:
+	FMappedFileReader(const char *Filename, EFileArchiveOptions InOptions = EFileArchiveOptions::Default);
+	virtual ~FMappedFileReader();
+
+	virtual void Serialize(void *data, int size);
+	virtual const byte* GetDirectPointer(int64 Pos, int Size);
+	virtual bool IsOpen() const;
+	virtual bool Open();
+	virtual void Close();
+	virtual void Seek(int Pos);
+	virtual void Seek64(int64 Pos);
+	virtual int Tell() const;
+	virtual int64 Tell64() const;
+	virtual int64 GetFileSize64() const;
+	virtual bool IsEof() const;
+
+protected:
+	const byte*	Data;
+	int64		DataSize;
+	int64		ArPos64;
+};
+
+// Files of this size or larger are opened with FMappedFileReader by appCreateFileReader()
+#define MAPPED_FILE_MIN_SIZE	(1 << 20)
+
+// Create a reader for a file: large files are memory-mapped (on 64-bit platforms), other files are read
+// with FFileReader. FileSize is used to choose a reader without touching the file, pass -1 if not known.
+FArchive* appCreateFileReader(const char *Filename, EFileArchiveOptions Options = EFileArchiveOptions::Default, int64 FileSize = -1);
+
+
 class FFileWriter : public FFileArchive
 {
 	DECLARE_ARCHIVE(FFileWriter, FFileArchive);
@@ -1019,6 +1083,11 @@ public:
 		unguard;
 	}
 
+	virtual const byte* GetDirectPointer(int64 Pos, int Size)
+	{
+		return (Pos >= 0 && Pos + Size <= DataSize) ? DataPtr + Pos : NULL;
+	}
+
 	// FMemReader doesn't have name table, so FName is serialized as a string
 	virtual FArchive& operator<<(FName& N);
 
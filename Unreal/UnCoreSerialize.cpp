@@ -587,6 +587,13 @@ bool FFileArchive::OpenFile()
 	}
 
 	// Failed to open the file
+	OpenFailed();
+	return false;
+	unguard;
+}
+
+void FFileArchive::OpenFailed()
+{
 	if (EnumHasAnyFlags(Options, EFileArchiveOptions::OpenWarning))
 	{
 		// Display an error message
@@ -597,9 +604,6 @@ bool FFileArchive::OpenFile()
 		// Throw fatal error
 		appError("Can't open file (%s) %s", strerror(errno), FullName);
 	}
-
-	return false;
-	unguard;
 }
 
 FFileReader::FFileReader(const char *Filename, EFileArchiveOptions InOptions)
@@ -788,6 +792,143 @@ bool FFileReader::IsEof() const
 	return (BufferBytesLeft == 0) && (FilePos == GetFileSize64());
 }
 
+FMappedFileReader::FMappedFileReader(const char *Filename, EFileArchiveOptions InOptions)
+:	FFileArchive(Filename, InOptions)
+,	Data(NULL)
+,	DataSize(0)
+,	ArPos64(0)
+{
+	guard(FMappedFileReader::FMappedFileReader);
+	IsLoading = true;
+	Open();
+	unguardf("%s", Filename);
+}
+
+FMappedFileReader::~FMappedFileReader()
+{
+	// Can't call virtual 'Close' from destructor, so use fully qualified name
+	FMappedFileReader::Close();
+}
+
+void FMappedFileReader::Serialize(void *data, int size)
+{
+	PROFILE_IF(size >= 1024);
+	guard(FMappedFileReader::Serialize);
+
+	assert(Data);
+	if (ArStopper > 0 && ArPos64 + size > ArStopper)
+		appError("Serializing behind stopper (%llX+%X > %X)", ArPos64, size, ArStopper);
+	if (ArPos64 + size > DataSize)
+		appError("Unable to read %d bytes at pos=0x%llX", size, ArPos64);
+
+	const byte* Src = Data + ArPos64;
+	switch (size)
+	{
+	case 1:
+		*(byte*)data = *Src;
+		break;
+	case 2:
+		*(uint16*)data = *(uint16*)Src;
+		break;
+	case 4:
+		*(uint32*)data = *(uint32*)Src;
+		break;
+	default:
+		memcpy(data, Src, size);
+	}
+	ArPos64 += size;
+#if PROFILE
+	GNumSerialize++;
+	GSerializeBytes += size;
+#endif
+
+	unguardf("File=%s", ShortName);
+}
+
+const byte* FMappedFileReader::GetDirectPointer(int64 Pos, int Size)
+{
+	if (!Data || Pos < 0 || Pos + Size > DataSize)
+		return NULL;
+	return Data + Pos;
+}
+
+bool FMappedFileReader::IsOpen() const
+{
+	return (Data != NULL);
+}
+
+bool FMappedFileReader::Open()
+{
+	guard(FMappedFileReader::Open);
+	if (Data) return true;
+
+	Data = appMapFile(FullName, DataSize);
+	if (Data) return true;
+
+	OpenFailed();
+	return false;
+	unguard;
+}
+
+void FMappedFileReader::Close()
+{
+	if (Data)
+	{
+		appUnmapFile(Data, DataSize);
+		Data = NULL;
+	}
+}
+
+void FMappedFileReader::Seek(int Pos)
+{
+	Seek64(Pos);
+}
+
+void FMappedFileReader::Seek64(int64 Pos)
+{
+	ArPos64 = Pos;
+}
+
+int FMappedFileReader::Tell() const
+{
+	assert((ArPos64 >> 31) == 0);
+	return (int)ArPos64;
+}
+
+int64 FMappedFileReader::Tell64() const
+{
+	return ArPos64;
+}
+
+int64 FMappedFileReader::GetFileSize64() const
+{
+	return DataSize;
+}
+
+bool FMappedFileReader::IsEof() const
+{
+	return ArPos64 >= DataSize;
+}
+
+FArchive* appCreateFileReader(const char *Filename, EFileArchiveOptions Options, int64 FileSize)
+{
+	guard(appCreateFileReader);
+
+	// Don't waste address space of 32-bit process, and don't map text files (FFileReader handles line endings there)
+	if (sizeof(void*) >= 8 && !EnumHasAnyFlags(Options, EFileArchiveOptions::TextFile) &&
+		(FileSize < 0 || FileSize >= MAPPED_FILE_MIN_SIZE))
+	{
+		FMappedFileReader* Reader = new FMappedFileReader(Filename, EFileArchiveOptions::NoOpenError);
+		if (Reader->IsOpen() && Reader->GetFileSize64() >= MAPPED_FILE_MIN_SIZE)
+			return Reader;
+		// Small file, or mapping failed: fall back to regular reader which will also report errors
+		delete Reader;
+	}
+	return new FFileReader(Filename, Options);
+
+	unguardf("%s", Filename);
+}
+
 static TArray<FFileWriter*> GFileWriters;
 
 #if THREADING
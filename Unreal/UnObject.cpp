@@ -6,6 +6,8 @@
 
 #include "GameDatabase.h"		// for GetGameTag()
 
+#include "Parallel.h"
+
 
 //#define DEBUG_PROPS				1
 //#define PROFILE_LOADING			1
@@ -136,7 +138,13 @@ int UObject::GetLicenseeVer() const
 int              UObject::GObjBeginLoadCount = 0;
 TArray<UObject*> UObject::GObjLoaded;
 TArray<UObject*> UObject::GObjObjects;
-UObject         *UObject::GLoadingObj = NULL;
+thread_local UObject* UObject::GLoadingObj = NULL;
+
+bool GParallelObjectLoading = false;
+
+#if THREADING
+CMutex GObjectLoadMutex;
+#endif
 
 
 void UObject::BeginLoad()
@@ -146,6 +154,352 @@ void UObject::BeginLoad()
 }
 
 
+static void SerializeObject(UObject* Obj, bool bSetNotify)
+{
+	UnPackage *Package = Obj->Package;
+
+	guard(LoadObject);
+	PROFILE_LABEL(Obj->GetClassName());
+
+	Package->SetupReader(Obj->PackageIndex);
+	if (!(Obj->GetTypeinfo()->TypeFlags & TYPE_SilentLoad))
+	{
+		appPrintf("Loading %s %s from package %s\n", Obj->GetClassName(), Obj->Name, *Package->GetFilename());
+	}
+	// setup NotifyInfo to describe object
+	if (bSetNotify)
+		appSetNotifyHeader("Loading object %s'%s.%s'", Obj->GetClassName(), Package->Name, Obj->Name);
+#if PROFILE_LOADING
+	appResetProfiler();
+#endif
+	UObject::GLoadingObj = Obj;
+	Obj->Serialize(*Package);
+	UObject::GLoadingObj = NULL;
+#if PROFILE_LOADING
+	appPrintProfiler();
+#endif
+	// check for unread bytes
+	if (!Package->IsStopper())
+		appError("%s::Serialize(%s): %d unread bytes",
+			Obj->GetClassName(), Obj->Name,
+			Package->GetStopper() - Package->Tell());
+
+#if UNREAL4
+	#define UNVERS_STR		(Package->Game >= GAME_UE4_BASE && Package->Summary.IsUnversioned) ? " (unversioned)" : ""
+	#define EDITOR_STR		(Package->ContainsEditorData()) ? " (editor)" : ""
+#else
+	#define UNVERS_STR		""
+	#define EDITOR_STR		""
+#endif
+
+	unguardf("%s'%s.%s', pos=%X, ver=%d/%d%s%s, game=%s", Obj->GetClassName(), Package->Name, Obj->Name, Package->Tell(),
+		Package->ArVer, Package->ArLicenseeVer, UNVERS_STR, EDITOR_STR, GetGameTag(Package->Game));
+}
+
+
+#if THREADING
+
+// Objects created and referenced by the current thread during parallel serialization, NULL when not recording
+static thread_local TArray<UObject*>* GObjectRefs = NULL;
+
+// Objects created during parallel serialization, with objects referenced during their creation
+struct CCreatedObjectRefs
+{
+	UObject* Obj;
+	TArray<UObject*>* Refs;
+};
+static TArray<CCreatedObjectRefs> GCreatedObjectRefs;
+
+CObjectRefRecorder::CObjectRefRecorder(UObject* Obj)
+:	SavedRefs(GObjectRefs)
+{
+	if (!SavedRefs) return;
+	CCreatedObjectRefs Created;
+	Created.Obj = Obj;
+	Created.Refs = new TArray<UObject*>;
+	GCreatedObjectRefs.Add(Created);
+	GObjectRefs = Created.Refs;
+}
+
+CObjectRefRecorder::~CObjectRefRecorder()
+{
+	GObjectRefs = SavedRefs;
+}
+
+void CObjectRefRecorder::Add(UObject* Obj)
+{
+	if (GObjectRefs) GObjectRefs->Add(Obj);
+}
+
+static void FreeCreatedObjectRefs()
+{
+	for (const CCreatedObjectRefs& Created : GCreatedObjectRefs)
+		delete Created.Refs;
+	GCreatedObjectRefs.Empty();
+}
+
+static void SerializeObjectInThread(UObject* Obj, FArchive* Reader)
+{
+	if (!Reader)
+		appError("Unable to open package %s", *Obj->Package->GetFilename());
+	Obj->Package->SetThreadLoader(Reader);
+	SerializeObject(Obj, false);
+	Obj->Package->SetThreadLoader(NULL);
+}
+
+// Returns false in a case of error. Error shouldn't leave the pool thread, otherwise it will terminate
+// the application.
+static bool TrySerializeObjectInThread(UObject* Obj, FArchive* Reader, TArray<UObject*>& Refs)
+{
+	GObjectRefs = &Refs;
+	TRY {
+		SerializeObjectInThread(Obj, Reader);
+		GObjectRefs = NULL;
+		return true;
+	} CATCH {
+		Obj->Package->SetThreadLoader(NULL);
+		GObjectRefs = NULL;
+		return false;
+	}
+}
+
+// Serialize a batch of objects using all available threads. Every thread reads package data with its own
+// reader, so objects from the same package could be serialized at the same time. Objects created or referenced
+// while serializing Objects[i] are recorded to Refs[i].
+static void SerializeObjectsParallel(const TArray<UObject*>& Objects, TArray<TArray<UObject*>>& Refs)
+{
+	guard(SerializeObjectsParallel);
+
+	FreeCreatedObjectRefs();
+	Refs.Empty(Objects.Num());
+	for (int Index = 0; Index < Objects.Num(); Index++)
+		new (Refs) TArray<UObject*>;
+
+	// Packages which can't be read concurrently are serialized in this thread first
+	TArray<int> ParallelObjects;
+	ParallelObjects.Empty(Objects.Num());
+	for (int Index = 0; Index < Objects.Num(); Index++)
+	{
+		UObject* Obj = Objects[Index];
+		if (Obj->Package->SupportsThreadLoader())
+		{
+			ParallelObjects.Add(Index);
+			continue;
+		}
+		GObjectRefs = &Refs[Index];
+		TRY {
+			SerializeObject(Obj, true);
+		} CATCH {
+			GObjectRefs = NULL;
+			THROW_AGAIN;
+		}
+		GObjectRefs = NULL;
+	}
+	appSetNotifyHeader(NULL);
+
+	// Errors are stored here and raised after all threads have finished. When several objects have failed,
+	// report the first one which has an error message (messages of threads failed at the same time could be
+	// lost, see CErrorContext::ShouldLogThisThread).
+	struct FLoadError
+	{
+		int Index;
+		bool bHasMessage;
+		CErrorContext Context;
+	};
+	FLoadError Error;
+	Error.Index = -1;
+	Error.bHasMessage = false;
+	CMutex ErrorMutex;
+
+	// Split objects into chunks, so every chunk could reuse readers for objects from the same package
+	int NumChunks = min(ParallelObjects.Num(), (ThreadPool::GetNumThreads() + 1) * 4);
+	ParallelFor(NumChunks, [&Objects, &Refs, &ParallelObjects, NumChunks, &Error, &ErrorMutex](int Chunk)
+		{
+			struct FThreadReader
+			{
+				const UnPackage* Package;
+				FArchive* Reader;
+			};
+			TArray<FThreadReader> Readers;
+
+			int First = ParallelObjects.Num() * Chunk / NumChunks;
+			int Last = ParallelObjects.Num() * (Chunk + 1) / NumChunks;
+			for (int Index = First; Index < Last; Index++)
+			{
+				int ObjIndex = ParallelObjects[Index];
+				UObject* Obj = Objects[ObjIndex];
+				FArchive* Reader = NULL;
+				for (const FThreadReader& R : Readers)
+				{
+					if (R.Package == Obj->Package)
+					{
+						Reader = R.Reader;
+						break;
+					}
+				}
+				if (!Reader)
+				{
+					Reader = Obj->Package->CreateThreadLoader();
+					if (Reader)
+					{
+						FThreadReader R = { Obj->Package, Reader };
+						Readers.Add(R);
+					}
+				}
+				if (!TrySerializeObjectInThread(Obj, Reader, Refs[ObjIndex]))
+				{
+					CMutex::ScopedLock Lock(ErrorMutex);
+					CErrorContext Context;
+					bool bHasMessage = GError.DetachThreadError(Context);
+					if (Error.Index < 0 || (bHasMessage && !Error.bHasMessage) || (bHasMessage == Error.bHasMessage && Index < Error.Index))
+					{
+						Error.Index = Index;
+						Error.bHasMessage = bHasMessage;
+						Error.Context = Context;
+					}
+				}
+			}
+
+			for (const FThreadReader& R : Readers)
+			{
+				delete R.Reader;
+			}
+		});
+
+	if (Error.Index >= 0)
+	{
+		// Raise the error in the calling thread
+		if (!Error.bHasMessage)
+		{
+			const UObject* Obj = Objects[ParallelObjects[Error.Index]];
+			appError("Error loading %s'%s.%s'", Obj->GetClassName(), Obj->Package->Name, Obj->Name);
+		}
+		GError.AttachThreadError(Error.Context);
+		THROW;
+	}
+
+	unguard;
+}
+
+// Order of objects created by parallel serialization depends on thread timing. Serial loading creates an object
+// when it is referenced first time: batch objects are serialized one by one, and an object's outer is created
+// right after the object itself. Recorded references are replayed in this order to put new objects in GObjObjects
+// and GObjLoaded the same way as serial loading does.
+struct CNewObject
+{
+	UObject* Obj;
+	const TArray<UObject*>* Refs;
+	bool bPlaced;
+	bool bLoaded;
+};
+
+static int CompareNewObjects(const CNewObject& A, const CNewObject& B)
+{
+	if (A.Obj == B.Obj) return 0;
+	return (A.Obj < B.Obj) ? -1 : 1;
+}
+
+struct CLoadOrder
+{
+	TArray<CNewObject> NewObjects;			// sorted by pointer
+	TArray<UObject*> ObjectsOrder;
+	TArray<UObject*> LoadedOrder;
+
+	CNewObject* Find(const UObject* Obj)
+	{
+		int Lo = 0, Hi = NewObjects.Num() - 1;
+		while (Lo <= Hi)
+		{
+			int Mid = (Lo + Hi) / 2;
+			CNewObject& N = NewObjects[Mid];
+			if (N.Obj == Obj) return &N;
+			if (N.Obj < Obj)
+				Lo = Mid + 1;
+			else
+				Hi = Mid - 1;
+		}
+		return NULL;
+	}
+
+	void Place(UObject* Obj)
+	{
+		CNewObject* N = Find(Obj);
+		if (!N || N->bPlaced) return;		// not created in this batch, or already placed
+		N->bPlaced = true;
+		ObjectsOrder.Add(Obj);
+		if (N->Refs)
+		{
+			for (UObject* Ref : *N->Refs)
+				Place(Ref);
+		}
+		if (N->bLoaded)
+			LoadedOrder.Add(Obj);
+	}
+};
+
+static void RestoreLoadOrder(const TArray<TArray<UObject*>>& Refs, int FirstNewObject)
+{
+	guard(RestoreLoadOrder);
+
+	TArray<UObject*>& Objects = UObject::GObjObjects;
+	TArray<UObject*>& Loaded = UObject::GObjLoaded;
+	int NumNewObjects = Objects.Num() - FirstNewObject;
+	if (NumNewObjects <= 0)
+	{
+		FreeCreatedObjectRefs();
+		return;
+	}
+
+	CLoadOrder Order;
+	Order.NewObjects.Empty(NumNewObjects);
+	for (int Index = FirstNewObject; Index < Objects.Num(); Index++)
+	{
+		CNewObject* N = new (Order.NewObjects) CNewObject;
+		N->Obj = Objects[Index];
+		N->Refs = NULL;
+		N->bPlaced = false;
+		N->bLoaded = false;
+	}
+	Order.NewObjects.Sort(CompareNewObjects);
+	for (const CCreatedObjectRefs& Created : GCreatedObjectRefs)
+	{
+		CNewObject* N = Order.Find(Created.Obj);
+		if (N) N->Refs = Created.Refs;
+	}
+	for (UObject* Obj : Loaded)
+	{
+		CNewObject* N = Order.Find(Obj);
+		if (N) N->bLoaded = true;
+	}
+
+	Order.ObjectsOrder.Empty(NumNewObjects);
+	Order.LoadedOrder.Empty(Loaded.Num());
+	for (const TArray<UObject*>& ItemRefs : Refs)
+	{
+		for (UObject* Obj : ItemRefs)
+			Order.Place(Obj);
+	}
+	// Objects which were not recorded keep their relative order
+	for (int Index = FirstNewObject; Index < Objects.Num(); Index++)
+		Order.Place(Objects[Index]);
+	for (UObject* Obj : Loaded)
+	{
+		if (!Order.Find(Obj))
+			Order.LoadedOrder.Add(Obj);
+	}
+
+	assert(Order.ObjectsOrder.Num() == NumNewObjects && Order.LoadedOrder.Num() == Loaded.Num());
+	memcpy(Objects.GetData() + FirstNewObject, Order.ObjectsOrder.GetData(), NumNewObjects * sizeof(UObject*));
+	memcpy(Loaded.GetData(), Order.LoadedOrder.GetData(), Loaded.Num() * sizeof(UObject*));
+
+	FreeCreatedObjectRefs();
+
+	unguard;
+}
+
+#endif // THREADING
+
+
 void UObject::EndLoad()
 {
 	assert(GObjBeginLoadCount > 0);
@@ -165,46 +519,26 @@ void UObject::EndLoad()
 		TArray<UObject*> LoadedObjects;
 		while (GObjLoaded.Num())
 		{
-			UObject *Obj = GObjLoaded[0];
-			GObjLoaded.RemoveAt(0);
-			UnPackage *Package = Obj->Package;
-
-			guard(LoadObject);
-			PROFILE_LABEL(Obj->GetClassName());
-
-			Package->SetupReader(Obj->PackageIndex);
-			if (!(Obj->GetTypeinfo()->TypeFlags & TYPE_SilentLoad))
+#if THREADING
+			if (GParallelObjectLoading && GObjLoaded.Num() > 1)
 			{
-				appPrintf("Loading %s %s from package %s\n", Obj->GetClassName(), Obj->Name, *Package->GetFilename());
+				// Objects created during serialization are added to GObjLoaded and processed in the next iteration
+				TArray<UObject*> Batch;
+				CopyArray(Batch, GObjLoaded);
+				GObjLoaded.Empty();
+				int FirstNewObject = GObjObjects.Num();
+				TArray<TArray<UObject*>> Refs;
+				SerializeObjectsParallel(Batch, Refs);
+				RestoreLoadOrder(Refs, FirstNewObject);
+				for (UObject* Obj : Batch)
+					LoadedObjects.Add(Obj);
+				continue;
 			}
-			// setup NotifyInfo to describe object
-			appSetNotifyHeader("Loading object %s'%s.%s'", Obj->GetClassName(), Package->Name, Obj->Name);
-#if PROFILE_LOADING
-			appResetProfiler();
-#endif
-			GLoadingObj = Obj;
-			Obj->Serialize(*Package);
-			GLoadingObj = NULL;
-#if PROFILE_LOADING
-			appPrintProfiler();
-#endif
-			// check for unread bytes
-			if (!Package->IsStopper())
-				appError("%s::Serialize(%s): %d unread bytes",
-					Obj->GetClassName(), Obj->Name,
-					Package->GetStopper() - Package->Tell());
+#endif // THREADING
+			UObject *Obj = GObjLoaded[0];
+			GObjLoaded.RemoveAt(0);
+			SerializeObject(Obj, true);
 			LoadedObjects.Add(Obj);
-
-#if UNREAL4
-	#define UNVERS_STR		(Package->Game >= GAME_UE4_BASE && Package->Summary.IsUnversioned) ? " (unversioned)" : ""
-	#define EDITOR_STR		(Package->ContainsEditorData()) ? " (editor)" : ""
-#else
-	#define UNVERS_STR		""
-	#define EDITOR_STR		""
-#endif
-
-			unguardf("%s'%s.%s', pos=%X, ver=%d/%d%s%s, game=%s", Obj->GetClassName(), Package->Name, Obj->Name, Package->Tell(),
-				Package->ArVer, Package->ArLicenseeVer, UNVERS_STR, EDITOR_STR, GetGameTag(Package->Game));
 		}
 		// postload objects
 		for (UObject* Obj : LoadedObjects)
@@ -1974,6 +2308,10 @@ UObject *CreateClass(const char *Name)
 {
 	guard(CreateClass);
 
+#if THREADING
+	CMutex::ScopedLock Lock(GObjectLoadMutex);
+#endif
+
 	const CTypeInfo *Type = FindClassType(Name);
 	if (!Type) return NULL;
 
@@ -1985,6 +2323,9 @@ UObject *CreateClass(const char *Name)
 	// Really, should add to this list after loading from package
 	// (in CreateExport/Import or after serialization)
 	UObject::GObjObjects.Add(Obj);
+#if THREADING
+	CObjectRefRecorder::Add(Obj);
+#endif
 	return Obj;
 
 	unguardf("%s", Name);
@@ -84,7 +84,8 @@ public:
 	static int				GObjBeginLoadCount;
 	static TArray<UObject*>	GObjLoaded;
 	static TArray<UObject*> GObjObjects;
-	static UObject*			GLoadingObj;
+	// Object which is being serialized by the current thread
+	static thread_local UObject* GLoadingObj;
 
 	static void BeginLoad();
 	static void EndLoad();
@@ -117,4 +118,31 @@ void RegisterCoreClasses();
 // false, serialization function will not be called.
 extern bool (*GBeforeLoadObjectCallback)(UObject*);
 
+// When set, UObject::EndLoad() serializes queued objects using multiple threads. Each thread reads package data
+// with its own reader, PostLoad() is still called from the main thread in the order objects were queued.
+extern bool GParallelObjectLoading;
+
+#if THREADING
+// Protects object creation and package loading when objects are serialized in parallel
+extern class CMutex GObjectLoadMutex;
+
+// Records objects created and referenced while objects are serialized in parallel. UObject::EndLoad() uses
+// this to put created objects into the same order as serial loading does. Does nothing outside of parallel
+// serialization.
+class CObjectRefRecorder
+{
+public:
+	// Collect references made while creating Obj into a separate list. Should be called with GObjectLoadMutex
+	// locked.
+	CObjectRefRecorder(UObject* Obj);
+	~CObjectRefRecorder();
+
+	// Record that object was created or referenced by the current thread
+	static void Add(UObject* Obj);
+
+private:
+	TArray<UObject*>* SavedRefs;
+};
+#endif
+
 #endif // __UNOBJECT_H__
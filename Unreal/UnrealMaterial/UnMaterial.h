@@ -260,6 +260,12 @@ public:
 
 	byte* Decompress(int MipLevel = 0, int Slice = -1);		// may return NULL in a case of error
 
+	// Find the largest mip which fits MaxSize x MaxSize, or the smallest mip when all of them are larger.
+	// Mip sizes are computed from the size of the first mip. MaxSize <= 0 selects the first mip.
+	static int FindMipForSize(int USize, int VSize, int NumMips, int MaxSize);
+	// Remove all mips except the one selected with MaxSize as described above
+	void KeepSingleMip(int MaxSize);
+
 #if SUPPORT_XBOX360
 	bool DecodeXBox360(int MipLevel);
 #endif
@@ -271,6 +277,10 @@ public:
 #endif
 };
 
+// Decode random DXT/BC blocks with native decoder (both scalar and SSE2 code) and with nvtt, compare results
+// and print timings. Returns false when results are different.
+bool BenchmarkBCDecoder();
+
 // There's no such class in Unreal Engine, we use it as common base for UE1/UE2/UE3
 class UUnrealMaterial : public UObject
 {
@@ -287,6 +297,16 @@ public:
 	{
 		return false;
 	}
+	// Same as GetTextureData(), but fills CTextureData with a single mip: the largest one which fits
+	// MaxSize x MaxSize, or the first mip with data when MaxSize is 0. Textures with external bulk data
+	// will read only the selected mip.
+	virtual bool GetTextureMip(CTextureData &TexData, int MaxSize = 0) const
+	{
+		if (!GetTextureData(TexData))
+			return false;
+		TexData.KeepSingleMip(MaxSize);
+		return true;
+	}
 	// Release data cached with GetTextureData().
 	virtual void ReleaseTextureData() const
 	{}
@@ -497,7 +497,12 @@ public:
 	bool LoadBulkTexture(const TArray<FTexture2DMipMap> &MipsArray, int MipIndex, const char* tfcSuffix, bool verbose) const;
 	virtual ETexturePixelFormat GetTexturePixelFormat() const;
 	virtual bool GetTextureData(CTextureData &TexData) const;
+	virtual bool GetTextureMip(CTextureData &TexData, int MaxSize = 0) const;
 	virtual void ReleaseTextureData() const;
+protected:
+	// Common code for GetTextureData() and GetTextureMip(), MaxSize < 0 means "all mips"
+	bool LoadTextureData(CTextureData &TexData, int MaxSize) const;
+public:
 #if RENDERING
 	virtual void SetupGL();
 	virtual bool Upload();
@@ -18,6 +18,15 @@
 
 #include <detex.h>
 
+#include "Parallel.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#	define DXT_USE_SSE2			1
+#	include <emmintrin.h>
+#else
+#	define DXT_USE_SSE2			0
+#endif
+
 #if 0
 #	define PROFILE_DDS(cmd)		cmd
 #else
@@ -26,6 +35,36 @@
 
 //#define DEBUG_PLATFORM_TEX		1
 
+// Textures with this number of blocks or more are decoded and untiled using multiple threads
+#define PARALLEL_DECODE_MIN_BLOCKS	16384
+// Minimal number of blocks processed by a single task
+#define PARALLEL_DECODE_TASK_BLOCKS	2048
+
+/*-----------------------------------------------------------------------------
+	Parallel processing of texture blocks
+-----------------------------------------------------------------------------*/
+
+// Split image into ranges of block rows and call Func(FirstRow, LastRow) for each range. Large images
+// are processed with ParallelFor, so the function should process ranges independently.
+template<typename F>
+static void ForEachBlockRowRange(int NumRows, int BlocksPerRow, F&& Func)
+{
+	if (NumRows > 1 && NumRows * BlocksPerRow >= PARALLEL_DECODE_MIN_BLOCKS)
+	{
+		int RowsPerTask = max(PARALLEL_DECODE_TASK_BLOCKS / max(BlocksPerRow, 1), 1);
+		int NumTasks = (NumRows + RowsPerTask - 1) / RowsPerTask;
+		ParallelFor(NumTasks, [&Func, RowsPerTask, NumRows](int Task)
+			{
+				int FirstRow = Task * RowsPerTask;
+				Func(FirstRow, min(FirstRow + RowsPerTask, NumRows));
+			});
+	}
+	else
+	{
+		Func(0, NumRows);
+	}
+}
+
 /*-----------------------------------------------------------------------------
 	Texture decompression
 -----------------------------------------------------------------------------*/
@@ -45,6 +84,445 @@ static void PostProcessAlpha(byte *pic, int width, int height)
 	unguard;
 }
 
+/*-----------------------------------------------------------------------------
+	BC1-BC5 block decompression
+-----------------------------------------------------------------------------*/
+
+// Native decoder for DXT1/DXT3/DXT5/BC4/BC5 formats, writes RGBA pixels directly to the destination buffer.
+// Results are bit-exact with nvtt, including its quirks: DXT3/DXT5 color blocks could use 3-color mode, and
+// BC5 is always decoded as normal map with reconstructed Z.
+
+// Z component of normal map for each X and Y pair, computed exactly like nvtt's buildNormal() does
+static struct CNormalZTable
+{
+	byte Z[256][256];
+
+	CNormalZTable()
+	{
+		for (int x = 0; x < 256; x++)
+		{
+			for (int y = 0; y < 256; y++)
+			{
+				float nx = 2 * (x / 255.0f) - 1;
+				float ny = 2 * (y / 255.0f) - 1;
+				float nz = 0.0f;
+				if (1 - nx*nx - ny*ny > 0) nz = sqrtf(1 - nx*nx - ny*ny);
+				Z[x][y] = (byte) bound(int(255.0f * (nz + 1) / 2.0f), 0, 255);
+			}
+		}
+	}
+} GNormalZ;
+
+union CBlockPixels
+{
+#if DXT_USE_SSE2
+	__m128i		Rows[4];
+#endif
+	uint32		Pixels[16];
+};
+
+// Convert RGB565 color to RGBA8 (red in lowest byte), alpha is set to 255
+static FORCEINLINE uint32 Expand565(unsigned c)
+{
+	unsigned r = (c >> 11) & 31;
+	unsigned g = (c >> 5) & 63;
+	unsigned b = c & 31;
+	r = (r << 3) | (r >> 2);
+	g = (g << 2) | (g >> 4);
+	b = (b << 3) | (b >> 2);
+	return r | (g << 8) | (b << 16) | 0xFF000000;
+}
+
+static void DecodeColorPalette(const byte* Block, uint32* Palette)
+{
+	unsigned c0 = Block[0] | (Block[1] << 8);
+	unsigned c1 = Block[2] | (Block[3] << 8);
+	uint32 e0 = Expand565(c0);
+	uint32 e1 = Expand565(c1);
+	Palette[0] = e0;
+	Palette[1] = e1;
+	if (c0 > c1)
+	{
+		// 4-color block
+		uint32 p2 = 0xFF000000, p3 = 0xFF000000;
+		for (int Shift = 0; Shift < 24; Shift += 8)
+		{
+			unsigned v0 = (e0 >> Shift) & 0xFF;
+			unsigned v1 = (e1 >> Shift) & 0xFF;
+			p2 |= ((2 * v0 + v1) / 3) << Shift;
+			p3 |= ((2 * v1 + v0) / 3) << Shift;
+		}
+		Palette[2] = p2;
+		Palette[3] = p3;
+	}
+	else
+	{
+		// 3-color block with transparent black
+		uint32 p2 = 0xFF000000;
+		for (int Shift = 0; Shift < 24; Shift += 8)
+		{
+			unsigned v0 = (e0 >> Shift) & 0xFF;
+			unsigned v1 = (e1 >> Shift) & 0xFF;
+			p2 |= ((v0 + v1) / 2) << Shift;
+		}
+		Palette[2] = p2;
+		Palette[3] = 0;
+	}
+}
+
+// Decode BC4 block (DXT5 alpha uses the same encoding) to 16 values
+static void DecodeAlphaValues(const byte* Block, byte* Values)
+{
+	byte Palette[8];
+	unsigned a0 = Block[0];
+	unsigned a1 = Block[1];
+	Palette[0] = a0;
+	Palette[1] = a1;
+	if (a0 > a1)
+	{
+		for (int i = 1; i < 7; i++)
+			Palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+	}
+	else
+	{
+		for (int i = 1; i < 5; i++)
+			Palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+		Palette[6] = 0;
+		Palette[7] = 255;
+	}
+	uint64 Bits = 0;
+	memcpy(&Bits, Block + 2, 6);
+	for (int i = 0; i < 16; i++, Bits >>= 3)
+		Values[i] = Palette[Bits & 7];
+}
+
+static void DecodeColorIndices(const byte* Block, const uint32* Palette, uint32* Pixels)
+{
+	uint32 Indices = Block[4] | (Block[5] << 8) | (Block[6] << 16) | (Block[7] << 24);
+	for (int i = 0; i < 16; i++, Indices >>= 2)
+		Pixels[i] = Palette[Indices & 3];
+}
+
+#if DXT_USE_SSE2
+
+static FORCEINLINE __m128i SelectSSE(__m128i Mask, __m128i A, __m128i B)
+{
+	return _mm_or_si128(_mm_and_si128(Mask, A), _mm_andnot_si128(Mask, B));
+}
+
+// Returns 4 palette colors of BC1 block
+static FORCEINLINE __m128i DecodeColorPaletteSSE(const byte* Block)
+{
+	unsigned c0 = Block[0] | (Block[1] << 8);
+	unsigned c1 = Block[2] | (Block[3] << 8);
+	__m128i Zero = _mm_setzero_si128();
+	__m128i v0 = _mm_unpacklo_epi8(_mm_cvtsi32_si128(Expand565(c0)), Zero);
+	__m128i v1 = _mm_unpacklo_epi8(_mm_cvtsi32_si128(Expand565(c1)), Zero);
+	__m128i p2, p3;
+	if (c0 > c1)
+	{
+		// x * 21846 >> 16 is exact division by 3 for x < 768
+		__m128i OneThird = _mm_set1_epi16(21846);
+		__m128i Sum = _mm_add_epi16(v0, v1);
+		p2 = _mm_mulhi_epu16(_mm_add_epi16(Sum, v0), OneThird);
+		p3 = _mm_mulhi_epu16(_mm_add_epi16(Sum, v1), OneThird);
+	}
+	else
+	{
+		p2 = _mm_srli_epi16(_mm_add_epi16(v0, v1), 1);
+		p3 = Zero;
+	}
+	return _mm_packus_epi16(_mm_unpacklo_epi64(v0, v1), _mm_unpacklo_epi64(p2, p3));
+}
+
+static FORCEINLINE void DecodeColorIndicesSSE(const byte* Block, __m128i Palette, __m128i* Rows)
+{
+	const __m128i LoMask = _mm_setr_epi32(1, 4, 16, 64);
+	const __m128i HiMask = _mm_setr_epi32(2, 8, 32, 128);
+	__m128i c0 = _mm_shuffle_epi32(Palette, 0x00);
+	__m128i c1 = _mm_shuffle_epi32(Palette, 0x55);
+	__m128i c2 = _mm_shuffle_epi32(Palette, 0xAA);
+	__m128i c3 = _mm_shuffle_epi32(Palette, 0xFF);
+	uint32 Indices;
+	memcpy(&Indices, Block + 4, 4);
+	__m128i Bits = _mm_set1_epi32(Indices);
+	for (int j = 0; j < 4; j++, Bits = _mm_srli_epi32(Bits, 8))
+	{
+		__m128i Lo = _mm_cmpeq_epi32(_mm_and_si128(Bits, LoMask), LoMask);
+		__m128i Hi = _mm_cmpeq_epi32(_mm_and_si128(Bits, HiMask), HiMask);
+		Rows[j] = SelectSSE(Hi, SelectSSE(Lo, c3, c2), SelectSSE(Lo, c1, c0));
+	}
+}
+
+// Replace alpha of pixels with 16 values from Alpha vector
+static FORCEINLINE void MergeAlphaSSE(__m128i Alpha, __m128i* Rows)
+{
+	__m128i Zero = _mm_setzero_si128();
+	__m128i ColorMask = _mm_set1_epi32(0x00FFFFFF);
+	__m128i A0 = _mm_unpacklo_epi8(Zero, Alpha);
+	__m128i A1 = _mm_unpackhi_epi8(Zero, Alpha);
+	Rows[0] = _mm_or_si128(_mm_and_si128(Rows[0], ColorMask), _mm_unpacklo_epi16(Zero, A0));
+	Rows[1] = _mm_or_si128(_mm_and_si128(Rows[1], ColorMask), _mm_unpackhi_epi16(Zero, A0));
+	Rows[2] = _mm_or_si128(_mm_and_si128(Rows[2], ColorMask), _mm_unpacklo_epi16(Zero, A1));
+	Rows[3] = _mm_or_si128(_mm_and_si128(Rows[3], ColorMask), _mm_unpackhi_epi16(Zero, A1));
+}
+
+// Make pixels from separate 16-byte R, G, B vectors, alpha is set to 255
+static FORCEINLINE void MergeChannelsSSE(__m128i R, __m128i G, __m128i B, __m128i* Rows)
+{
+	__m128i BA = _mm_unpacklo_epi8(B, _mm_set1_epi8(-1));
+	__m128i BA1 = _mm_unpackhi_epi8(B, _mm_set1_epi8(-1));
+	__m128i RG = _mm_unpacklo_epi8(R, G);
+	__m128i RG1 = _mm_unpackhi_epi8(R, G);
+	Rows[0] = _mm_unpacklo_epi16(RG, BA);
+	Rows[1] = _mm_unpackhi_epi16(RG, BA);
+	Rows[2] = _mm_unpacklo_epi16(RG1, BA1);
+	Rows[3] = _mm_unpackhi_epi16(RG1, BA1);
+}
+
+static FORCEINLINE __m128i LoadValuesSSE(const byte* Values)
+{
+	return _mm_loadu_si128((const __m128i*)Values);
+}
+
+// Decode a single block. Format is a template parameter, so the compiler will generate a separate
+// loop for every format.
+template<ETexturePixelFormat Format>
+static FORCEINLINE void DecodeBCBlockSSE(const byte* Block, CBlockPixels& Out)
+{
+	if (Format == TPF_DXT1)
+	{
+		DecodeColorIndicesSSE(Block, DecodeColorPaletteSSE(Block), Out.Rows);
+	}
+	else if (Format == TPF_DXT3)
+	{
+		DecodeColorIndicesSSE(Block + 8, DecodeColorPaletteSSE(Block + 8), Out.Rows);
+		// 4-bit alpha values, expand them to 8 bits
+		__m128i Packed = _mm_loadl_epi64((const __m128i*)Block);
+		__m128i NibbleMask = _mm_set1_epi8(0x0F);
+		__m128i Alpha = _mm_unpacklo_epi8(_mm_and_si128(Packed, NibbleMask), _mm_and_si128(_mm_srli_epi16(Packed, 4), NibbleMask));
+		Alpha = _mm_or_si128(Alpha, _mm_slli_epi16(Alpha, 4));
+		MergeAlphaSSE(Alpha, Out.Rows);
+	}
+	else if (Format == TPF_DXT5)
+	{
+		DecodeColorIndicesSSE(Block + 8, DecodeColorPaletteSSE(Block + 8), Out.Rows);
+		byte Alpha[16];
+		DecodeAlphaValues(Block, Alpha);
+		MergeAlphaSSE(LoadValuesSSE(Alpha), Out.Rows);
+	}
+	else if (Format == TPF_BC4)
+	{
+		byte Values[16];
+		DecodeAlphaValues(Block, Values);
+		__m128i V = LoadValuesSSE(Values);
+		MergeChannelsSSE(V, V, V, Out.Rows);
+	}
+	else if (Format == TPF_BC5 || Format == TPF_DXT5N)
+	{
+		// Normal map: X and Y are stored in separate channels, Z is reconstructed
+		byte X[16], Y[16], Z[16];
+		if (Format == TPF_BC5)
+		{
+			DecodeAlphaValues(Block, X);
+			DecodeAlphaValues(Block + 8, Y);
+		}
+		else
+		{
+			// X is in alpha channel, Y is in green
+			uint32 Palette[4], Pixels[16];
+			DecodeAlphaValues(Block, X);
+			DecodeColorPalette(Block + 8, Palette);
+			DecodeColorIndices(Block + 8, Palette, Pixels);
+			for (int i = 0; i < 16; i++)
+				Y[i] = (Pixels[i] >> 8) & 0xFF;
+		}
+		for (int i = 0; i < 16; i++)
+			Z[i] = GNormalZ.Z[X[i]][Y[i]];
+		MergeChannelsSSE(LoadValuesSSE(X), LoadValuesSSE(Y), LoadValuesSSE(Z), Out.Rows);
+	}
+}
+
+#endif // DXT_USE_SSE2
+
+// Scalar version of DecodeBCBlockSSE(), used on platforms without SSE2, and for verification of SSE2 code
+template<ETexturePixelFormat Format>
+static FORCEINLINE void DecodeBCBlockScalar(const byte* Block, CBlockPixels& Out)
+{
+	uint32* Pixels = Out.Pixels;
+	if (Format == TPF_DXT1)
+	{
+		uint32 Palette[4];
+		DecodeColorPalette(Block, Palette);
+		DecodeColorIndices(Block, Palette, Pixels);
+	}
+	else if (Format == TPF_DXT3 || Format == TPF_DXT5)
+	{
+		uint32 Palette[4];
+		DecodeColorPalette(Block + 8, Palette);
+		DecodeColorIndices(Block + 8, Palette, Pixels);
+		byte Alpha[16];
+		if (Format == TPF_DXT3)
+		{
+			for (int i = 0; i < 8; i++)
+			{
+				Alpha[i * 2]     = (Block[i] & 0x0F) * 17;
+				Alpha[i * 2 + 1] = (Block[i] >> 4) * 17;
+			}
+		}
+		else
+		{
+			DecodeAlphaValues(Block, Alpha);
+		}
+		for (int i = 0; i < 16; i++)
+			Pixels[i] = (Pixels[i] & 0x00FFFFFF) | (Alpha[i] << 24);
+	}
+	else if (Format == TPF_BC4)
+	{
+		byte Values[16];
+		DecodeAlphaValues(Block, Values);
+		for (int i = 0; i < 16; i++)
+			Pixels[i] = Values[i] * 0x010101 | 0xFF000000;
+	}
+	else if (Format == TPF_BC5 || Format == TPF_DXT5N)
+	{
+		byte X[16], Y[16];
+		if (Format == TPF_BC5)
+		{
+			DecodeAlphaValues(Block, X);
+			DecodeAlphaValues(Block + 8, Y);
+		}
+		else
+		{
+			uint32 Palette[4];
+			DecodeAlphaValues(Block, X);
+			DecodeColorPalette(Block + 8, Palette);
+			DecodeColorIndices(Block + 8, Palette, Pixels);
+			for (int i = 0; i < 16; i++)
+				Y[i] = (Pixels[i] >> 8) & 0xFF;
+		}
+		for (int i = 0; i < 16; i++)
+			Pixels[i] = X[i] | (Y[i] << 8) | (GNormalZ.Z[X[i]][Y[i]] << 16) | 0xFF000000;
+	}
+}
+
+template<ETexturePixelFormat Format, bool bUseSSE2>
+static void DecodeBCBlocks(const byte* Data, int USize, int VSize, byte* Dst)
+{
+	const int BytesPerBlock = (Format == TPF_DXT1 || Format == TPF_BC4) ? 8 : 16;
+	int Pitch = USize * 4;
+
+	for (int y = 0; y < VSize; y += 4)
+	{
+		int NumRows = min(VSize - y, 4);
+		byte* DstRow = Dst + y * Pitch;
+		for (int x = 0; x < USize; x += 4, Data += BytesPerBlock)
+		{
+			CBlockPixels Block;
+#if DXT_USE_SSE2
+			if (bUseSSE2)
+				DecodeBCBlockSSE<Format>(Data, Block);
+			else
+#endif
+				DecodeBCBlockScalar<Format>(Data, Block);
+			byte* d = DstRow + x * 4;
+			if (NumRows == 4 && x + 4 <= USize)
+			{
+				// Whole block is inside the image
+#if DXT_USE_SSE2
+				if (bUseSSE2)
+				{
+					for (int j = 0; j < 4; j++, d += Pitch)
+						_mm_storeu_si128((__m128i*)d, Block.Rows[j]);
+					continue;
+				}
+#endif
+				for (int j = 0; j < 4; j++, d += Pitch)
+					memcpy(d, &Block.Pixels[j * 4], 16);
+			}
+			else
+			{
+				// Clip block for images which size is not multiple of 4
+				int RowSize = min(USize - x, 4) * 4;
+				for (int j = 0; j < NumRows; j++, d += Pitch)
+					memcpy(d, &Block.Pixels[j * 4], RowSize);
+			}
+		}
+	}
+}
+
+typedef void (*DecodeBCFunc_t)(const byte* Data, int USize, int VSize, byte* Dst);
+
+template<bool bUseSSE2>
+static DecodeBCFunc_t GetDecodeBCFunc(ETexturePixelFormat Format)
+{
+	switch (Format)
+	{
+	case TPF_DXT1:
+		return DecodeBCBlocks<TPF_DXT1, bUseSSE2>;
+	case TPF_DXT3:
+		return DecodeBCBlocks<TPF_DXT3, bUseSSE2>;
+	case TPF_DXT5:
+		return DecodeBCBlocks<TPF_DXT5, bUseSSE2>;
+	case TPF_DXT5N:
+		return DecodeBCBlocks<TPF_DXT5N, bUseSSE2>;
+	case TPF_BC4:
+		return DecodeBCBlocks<TPF_BC4, bUseSSE2>;
+	case TPF_BC5:
+		return DecodeBCBlocks<TPF_BC5, bUseSSE2>;
+	default:
+		return NULL;
+	}
+}
+
+// Returns false when the format is not supported by this decoder. bForceScalar disables SSE2 code.
+static bool DecodeBC(const byte* Data, int USize, int VSize, ETexturePixelFormat Format, byte* Dst, bool bForceScalar = false)
+{
+	guard(DecodeBC);
+
+	DecodeBCFunc_t DecodeFunc = bForceScalar ? GetDecodeBCFunc<false>(Format) : GetDecodeBCFunc<DXT_USE_SSE2 != 0>(Format);
+	if (!DecodeFunc)
+		return false;
+
+	int BytesPerBlock = (Format == TPF_DXT1 || Format == TPF_BC4) ? 8 : 16;
+	int BlocksX = (USize + 3) / 4;
+	int BlocksY = (VSize + 3) / 4;
+	ForEachBlockRowRange(BlocksY, BlocksX, [=](int FirstRow, int LastRow)
+		{
+			DecodeFunc(Data + FirstRow * BlocksX * BytesPerBlock, USize, min(VSize - FirstRow * 4, (LastRow - FirstRow) * 4),
+				Dst + FirstRow * 4 * USize * 4);
+		});
+	return true;
+
+	unguard;
+}
+
+
+// Decompress texture using detex library. Partial blocks at right and bottom edges are not decoded.
+static void DecodeDetex(const byte* Data, int USize, int VSize, uint32 TextureFormat, byte* Dst, uint32 PixelFormat)
+{
+	guard(DecodeDetex);
+
+	int BlocksX = USize / 4;
+	int BlocksY = VSize / 4;
+	int BytesPerBlock = detexGetCompressedBlockSize(TextureFormat);
+	int PixelSize = detexGetPixelSize(PixelFormat);
+	ForEachBlockRowRange(BlocksY, BlocksX, [=](int FirstRow, int LastRow)
+		{
+			detexTexture tex;
+			tex.format = TextureFormat;
+			tex.data = const_cast<byte*>(Data) + FirstRow * BlocksX * BytesPerBlock;	// will be used as 'const' anyway
+			tex.width = USize;
+			tex.height = (LastRow == BlocksY) ? VSize - FirstRow * 4 : (LastRow - FirstRow) * 4;
+			tex.width_in_blocks = BlocksX;
+			tex.height_in_blocks = LastRow - FirstRow;
+			detexDecompressTextureLinear(&tex, Dst + FirstRow * 4 * USize * PixelSize, PixelFormat);
+		});
+
+	unguard;
+}
+
+
 // Some references:
 // https://msdn.microsoft.com/en-us/library/windows/desktop/hh308955.aspx
 // https://msdn.microsoft.com/en-us/library/bb694531.aspx
@@ -96,6 +574,38 @@ unsigned CTextureData::GetFourCC() const
 	return PixelFormatInfo[Format].FourCC;
 }
 
+// Decompress DXT/BC texture using nvtt library
+static void DecodeNVTT(const byte* Data, int USize, int VSize, ETexturePixelFormat Format, byte* Dst)
+{
+	guard(DecodeNVTT);
+
+	unsigned fourCC = PixelFormatInfo[Format].FourCC;
+	nv::DDSHeader header;
+	nv::Image image;
+	header.setFourCC(fourCC & 0xFF, (fourCC >> 8) & 0xFF, (fourCC >> 16) & 0xFF, (fourCC >> 24) & 0xFF);
+	header.setWidth(USize);
+	header.setHeight(VSize);
+	header.setNormalFlag(Format == TPF_DXT5N || Format == TPF_BC5);	// flag to restore normalmap from 2 colors
+	DecodeDDS(Data, USize, VSize, header, image);
+
+	byte *s = (byte*)image.pixels();
+	byte *d = Dst;
+
+	for (int i = 0; i < USize * VSize; i++, s += 4, d += 4)
+	{
+		// BGRA -> RGBA
+		d[0] = s[2];
+		d[1] = s[1];
+		d[2] = s[0];
+		d[3] = s[3];
+	}
+
+	if (Format == TPF_DXT1)
+		PostProcessAlpha(Dst, USize, VSize);	//??
+
+	unguard;
+}
+
 
 byte* CTextureData::Decompress(int MipLevel, int Slice)
 {
@@ -303,32 +813,14 @@ byte* CTextureData::Decompress(int MipLevel, int Slice)
 #endif
 		return dst;
 	case TPF_ETC2_RGB:
-		{
-			detexTexture tex;
-			tex.format = DETEX_TEXTURE_FORMAT_ETC2;
-			tex.data = const_cast<byte*>(Data);	// will be used as 'const' anyway
-			tex.width = USize;
-			tex.height = VSize;
-			tex.width_in_blocks = USize / 4;
-			tex.height_in_blocks = VSize / 4;
-			PROFILE_DDS(appResetProfiler());
-			detexDecompressTextureLinear(&tex, dst, DETEX_PIXEL_FORMAT_RGBA8);
-			PROFILE_DDS(appPrintProfiler());
-		}
+		PROFILE_DDS(appResetProfiler());
+		DecodeDetex(Data, USize, VSize, DETEX_TEXTURE_FORMAT_ETC2, dst, DETEX_PIXEL_FORMAT_RGBA8);
+		PROFILE_DDS(appPrintProfiler());
 		return dst;
 	case TPF_ETC2_RGBA:
-		{
-			detexTexture tex;
-			tex.format = DETEX_TEXTURE_FORMAT_ETC2_EAC;
-			tex.data = const_cast<byte*>(Data);	// will be used as 'const' anyway
-			tex.width = USize;
-			tex.height = VSize;
-			tex.width_in_blocks = USize / 4;
-			tex.height_in_blocks = VSize / 4;
-			PROFILE_DDS(appResetProfiler());
-			detexDecompressTextureLinear(&tex, dst, DETEX_PIXEL_FORMAT_RGBA8);
-			PROFILE_DDS(appPrintProfiler());
-		}
+		PROFILE_DDS(appResetProfiler());
+		DecodeDetex(Data, USize, VSize, DETEX_TEXTURE_FORMAT_ETC2_EAC, dst, DETEX_PIXEL_FORMAT_RGBA8);
+		PROFILE_DDS(appPrintProfiler());
 		return dst;
 	case TPF_ASTC_4x4:
 	case TPF_ASTC_6x6:
@@ -336,37 +828,54 @@ byte* CTextureData::Decompress(int MipLevel, int Slice)
 	case TPF_ASTC_10x10:
 	case TPF_ASTC_12x12:
 		{
-			static bool initialized = false;
-			if (!initialized)
-			{
-				build_quantization_mode_table();
-				initialized = true;
-			}
 			int blockDim = PixelFormatInfo[Format].BlockSizeX;
 			assert(PixelFormatInfo[Format].BlockSizeY == blockDim);
 			int xBlocks = (USize + blockDim - 1) / blockDim;
 			int yBlocks = (VSize + blockDim - 1) / blockDim;
 			const int xdim = blockDim, ydim = blockDim, zdim = 1, z = 0;
+
+			{
+			#if THREADING
+				// Textures could be decoded from different threads
+				static CMutex InitMutex;
+				CMutex::ScopedLock Lock(InitMutex);
+			#endif
+				static bool initialized = false;
+				if (!initialized)
+				{
+					build_quantization_mode_table();
+					initialized = true;
+				}
+				// astc creates block size descriptors and partition tables on first use, and this is not
+				// thread-safe. Create them here, so decoder threads will only read these tables.
+				get_block_size_descriptor(xdim, ydim, zdim);
+				for (int partitionCount = 1; partitionCount <= 4; partitionCount++)
+					get_partition_table(xdim, ydim, zdim, partitionCount);
+			}
 			const astc_decode_mode decode_mode = DECODE_LDR;
 			static const swizzlepattern swz_decode = { 0, 1, 2, 3 };
-			imageblock pb;
 
 			astc_codec_image* img = allocate_image(8 /*bitness*/, USize, VSize, 1 /*zsize*/, 0);
 			initialize_image(img);
 
-			for (int y = 0; y < yBlocks; y++)
-			{
-				for (int x = 0; x < xBlocks; x++)
+			// Every block writes its own region of the image, so rows of blocks could be decoded in parallel
+			ForEachBlockRowRange(yBlocks, xBlocks, [=](int FirstRow, int LastRow)
 				{
-					int offset = ((y * xBlocks) + x) * 16;
-					const byte* bp = Data + offset;
-					physical_compressed_block pcb = *(physical_compressed_block *) bp;
-					symbolic_compressed_block scb;
-					physical_to_symbolic(xdim, ydim, zdim, pcb, &scb);
-					decompress_symbolic_block(decode_mode, xdim, ydim, zdim, x * xdim, y * ydim, z * zdim, &scb, &pb);
-					write_imageblock(img, &pb, xdim, ydim, zdim, x * xdim, y * ydim, z * zdim, swz_decode);
-				}
-			}
+					imageblock pb;
+					for (int y = FirstRow; y < LastRow; y++)
+					{
+						for (int x = 0; x < xBlocks; x++)
+						{
+							int offset = ((y * xBlocks) + x) * 16;
+							const byte* bp = Data + offset;
+							physical_compressed_block pcb = *(physical_compressed_block *) bp;
+							symbolic_compressed_block scb;
+							physical_to_symbolic(xdim, ydim, zdim, pcb, &scb);
+							decompress_symbolic_block(decode_mode, xdim, ydim, zdim, x * xdim, y * ydim, z * zdim, &scb, &pb);
+							write_imageblock(img, &pb, xdim, ydim, zdim, x * xdim, y * ydim, z * zdim, swz_decode);
+						}
+					}
+				});
 
 			memcpy(dst, img->imagedata8[0][0], size);
 
@@ -395,33 +904,15 @@ byte* CTextureData::Decompress(int MipLevel, int Slice)
 		return dst;
 #endif // SUPPORT_ANDROID
 	case TPF_BC6H:
-		{
-			// decompress HDR image as float[w*h*4]
-			detexTexture tex;
-			tex.format = DETEX_TEXTURE_FORMAT_BPTC_FLOAT;
-			tex.data = const_cast<byte*>(Data);
-			tex.width = USize;
-			tex.height = VSize;
-			tex.width_in_blocks = USize / 4;
-			tex.height_in_blocks = VSize / 4;
-			PROFILE_DDS(appResetProfiler());
-			detexDecompressTextureLinear(&tex, dst, DETEX_PIXEL_FORMAT_FLOAT_RGBX32);
-			PROFILE_DDS(appPrintProfiler());
-		}
+		// decompress HDR image as float[w*h*4]
+		PROFILE_DDS(appResetProfiler());
+		DecodeDetex(Data, USize, VSize, DETEX_TEXTURE_FORMAT_BPTC_FLOAT, dst, DETEX_PIXEL_FORMAT_FLOAT_RGBX32);
+		PROFILE_DDS(appPrintProfiler());
 		return dst;
 	case TPF_BC7:
-		{
-			detexTexture tex;
-			tex.format = DETEX_TEXTURE_FORMAT_BPTC;
-			tex.data = const_cast<byte*>(Data);	// will be used as 'const' anyway
-			tex.width = USize;
-			tex.height = VSize;
-			tex.width_in_blocks = USize / 4;
-			tex.height_in_blocks = VSize / 4;
-			PROFILE_DDS(appResetProfiler());
-			detexDecompressTextureLinear(&tex, dst, DETEX_PIXEL_FORMAT_RGBA8);
-			PROFILE_DDS(appPrintProfiler());
-		}
+		PROFILE_DDS(appResetProfiler());
+		DecodeDetex(Data, USize, VSize, DETEX_TEXTURE_FORMAT_BPTC, dst, DETEX_PIXEL_FORMAT_RGBA8);
+		PROFILE_DDS(appPrintProfiler());
 		return dst;
 	case TPF_PNG_BGRA:
 	case TPF_PNG_RGBA:
@@ -443,33 +934,145 @@ byte* CTextureData::Decompress(int MipLevel, int Slice)
 
 	PROFILE_DDS(appResetProfiler());
 
-	nv::DDSHeader header;
-	nv::Image image;
-	header.setFourCC(fourCC & 0xFF, (fourCC >> 8) & 0xFF, (fourCC >> 16) & 0xFF, (fourCC >> 24) & 0xFF);
-	header.setWidth(USize);
-	header.setHeight(VSize);
-	header.setNormalFlag(Format == TPF_DXT5N || Format == TPF_BC5);	// flag to restore normalmap from 2 colors
-	DecodeDDS(Data, USize, VSize, header, image);
+	if (!DecodeBC(Data, USize, VSize, Format, dst))
+		DecodeNVTT(Data, USize, VSize, Format, dst);
 
-	byte *s = (byte*)image.pixels();
-	byte *d = dst;
+	PROFILE_DDS(appPrintProfiler());
 
-	for (int i = 0; i < USize * VSize; i++, s += 4, d += 4)
+	return dst;
+	unguardf("fmt=%s(%d)", OriginalFormatName, OriginalFormatEnum);
+}
+
+
+/*-----------------------------------------------------------------------------
+	BC decoder benchmark
+-----------------------------------------------------------------------------*/
+
+bool BenchmarkBCDecoder()
+{
+	guard(BenchmarkBCDecoder);
+
+	static const ETexturePixelFormat Formats[] = { TPF_DXT1, TPF_DXT3, TPF_DXT5, TPF_DXT5N, TPF_BC4, TPF_BC5 };
+	// Sizes which are not multiple of 4 are used to check block clipping. 1x1 images are not verified:
+	// nvtt reads only USize*VSize*4 bytes of input, which is less than a block.
+	static const int Sizes[][2] = { { 2, 2 }, { 4, 4 }, { 5, 7 }, { 13, 9 }, { 64, 36 }, { 256, 256 }, { 1023, 517 }, { 2048, 2048 } };
+	// Number of decode calls for timing, with the largest size only
+	const int NumRuns = 8;
+
+	const int MaxSize = 2048 * 2048;
+	byte* Data = (byte*)appMallocNoInit(MaxSize);		// 1 byte per pixel is enough for any BC format
+	byte* Ref  = (byte*)appMallocNoInit(MaxSize * 4);
+	byte* Dst  = (byte*)appMallocNoInit(MaxSize * 4);
+
+	// Random data covers all block modes: 3- and 4-color DXT1 blocks, 6- and 8-value alpha blocks
+	uint32 Seed = 1;
+	for (int i = 0; i < MaxSize; i++)
 	{
-		// BGRA -> RGBA
-		d[0] = s[2];
-		d[1] = s[1];
-		d[2] = s[0];
-		d[3] = s[3];
+		Seed = Seed * 1103515245 + 12345;
+		Data[i] = Seed >> 16;
 	}
 
-	PROFILE_DDS(appPrintProfiler());
+	appPrintf("Verifying BC decoder with nvtt (SSE2 %s)\n", DXT_USE_SSE2 ? "enabled" : "not available");
+	appPrintf("%-6s %-11s %10s %10s %10s\n", "Format", "Size", "nvtt", "scalar", "SSE2");
 
-	if (Format == TPF_DXT1)
-		PostProcessAlpha(dst, USize, VSize);	//??
+	bool bResult = true;
+	for (ETexturePixelFormat Format : Formats)
+	{
+		for (int SizeIndex = 0; SizeIndex < ARRAY_COUNT(Sizes); SizeIndex++)
+		{
+			int USize = Sizes[SizeIndex][0];
+			int VSize = Sizes[SizeIndex][1];
+			int Size = USize * VSize * 4;
+			int Runs = (SizeIndex == ARRAY_COUNT(Sizes) - 1) ? NumRuns : 1;
+
+			int Time[3] = { 0, 0, 0 };
+			bool bMatch[2] = { true, true };
+			int StartTime = appMilliseconds();
+			for (int Run = 0; Run < Runs; Run++)
+				DecodeNVTT(Data, USize, VSize, Format, Ref);
+			Time[0] = appMilliseconds() - StartTime;
+
+			for (int Mode = 0; Mode < 2; Mode++)
+			{
+				// Mode 0 is scalar code, mode 1 is SSE2
+				if (Mode == 1 && !DXT_USE_SSE2) break;
+				memset(Dst, 0xCC, Size);
+				StartTime = appMilliseconds();
+				for (int Run = 0; Run < Runs; Run++)
+					DecodeBC(Data, USize, VSize, Format, Dst, Mode == 0);
+				Time[Mode + 1] = appMilliseconds() - StartTime;
+				bMatch[Mode] = (memcmp(Ref, Dst, Size) == 0);
+				if (!bMatch[Mode]) bResult = false;
+			}
 
-	return dst;
-	unguardf("fmt=%s(%d)", OriginalFormatName, OriginalFormatEnum);
+			char SizeStr[32], Result[3][32];
+			appSprintf(ARRAY_ARG(SizeStr), "%dx%d", USize, VSize);
+			for (int i = 0; i < 3; i++)
+			{
+				if (i == 2 && !DXT_USE_SSE2)
+					appStrncpyz(Result[i], "-", ARRAY_COUNT(Result[i]));
+				else if (i == 0 && Runs == 1)
+					appStrncpyz(Result[i], "ref", ARRAY_COUNT(Result[i]));
+				else if (i > 0 && !bMatch[i - 1])
+					appStrncpyz(Result[i], "MISMATCH", ARRAY_COUNT(Result[i]));
+				else if (Runs > 1)
+					appSprintf(ARRAY_ARG(Result[i]), "%d ms", Time[i]);
+				else
+					appStrncpyz(Result[i], "ok", ARRAY_COUNT(Result[i]));
+			}
+			appPrintf("%-6s %-11s %10s %10s %10s\n", PixelFormatInfo[Format].Name, SizeStr, Result[0], Result[1], Result[2]);
+		}
+	}
+	appFree(Data);
+	appFree(Ref);
+	appFree(Dst);
+
+	appPrintf(bResult ? "BC decoder: all results are identical to nvtt\n" : "BC decoder: MISMATCH found\n");
+	return bResult;
+
+	unguard;
+}
+
+
+/*static*/ int CTextureData::FindMipForSize(int USize, int VSize, int NumMips, int MaxSize)
+{
+	if (MaxSize <= 0) return 0;
+	for (int MipLevel = 0; MipLevel < NumMips; MipLevel++)
+	{
+		if (max(USize >> MipLevel, 1) <= MaxSize && max(VSize >> MipLevel, 1) <= MaxSize)
+			return MipLevel;
+	}
+	return NumMips - 1;
+}
+
+void CTextureData::KeepSingleMip(int MaxSize)
+{
+	guard(CTextureData::KeepSingleMip);
+
+	if (Mips.Num() <= 1) return;
+
+	// Mips could be already filtered, so check real sizes
+	int MipLevel = Mips.Num() - 1;
+	if (MaxSize <= 0)
+	{
+		MipLevel = 0;
+	}
+	else
+	{
+		for (int i = 0; i < Mips.Num(); i++)
+		{
+			if (Mips[i].USize <= MaxSize && Mips[i].VSize <= MaxSize)
+			{
+				MipLevel = i;
+				break;
+			}
+		}
+	}
+	Mips.RemoveAt(MipLevel + 1, Mips.Num() - MipLevel - 1);
+	if (MipLevel > 0)
+		Mips.RemoveAt(0, MipLevel);
+
+	unguard;
 }
 
 
@@ -608,21 +1211,24 @@ static void UntileCompressedXbox360Texture(const byte *src, byte *dst, int origi
 
 	// Iterate over image blocks
 	int bytesPerBlock = info.BytesPerBlock;
-	for (int dy = 0; dy < originalBlockHeight; dy++)
-	{
-		for (int dx = 0; dx < originalBlockWidth; dx++)
+	ForEachBlockRowRange(originalBlockHeight, originalBlockWidth, [=](int FirstRow, int LastRow)
 		{
-			// Unswizzle only once for a whole block
-			unsigned swzAddr = GetXbox360TiledOffset(dx + sxOffset, dy + syOffset, tiledBlockWidth, logBpp);
-			assert(swzAddr < numImageBlocks);
-			int sy = swzAddr / tiledBlockWidth;
-			int sx = swzAddr % tiledBlockWidth;
-
-			byte       *pDst = dst + (dy * originalBlockWidth + dx) * bytesPerBlock;
-			const byte *pSrc = src + (sy * tiledBlockWidth    + sx) * bytesPerBlock;
-			memcpy(pDst, pSrc, bytesPerBlock);
-		}
-	}
+			for (int dy = FirstRow; dy < LastRow; dy++)
+			{
+				for (int dx = 0; dx < originalBlockWidth; dx++)
+				{
+					// Unswizzle only once for a whole block
+					unsigned swzAddr = GetXbox360TiledOffset(dx + sxOffset, dy + syOffset, tiledBlockWidth, logBpp);
+					assert(swzAddr < numImageBlocks);
+					int sy = swzAddr / tiledBlockWidth;
+					int sx = swzAddr % tiledBlockWidth;
+
+					byte       *pDst = dst + (dy * originalBlockWidth + dx) * bytesPerBlock;
+					const byte *pSrc = src + (sy * tiledBlockWidth    + sx) * bytesPerBlock;
+					memcpy(pDst, pSrc, bytesPerBlock);
+				}
+			}
+		});
 	unguard;
 }
 
@@ -769,26 +1375,30 @@ static void UntileCompressedPS4Texture(const byte *src, byte *dst, int width, in
 	int blockWidth2 = max(blockWidth, 8);
 	int blockHeight2 = max(blockHeight, 8);
 
-	// Iterate over image blocks
-	for (int sy = 0; sy < blockHeight2; sy++)
-	{
-		for (int sx = 0; sx < blockWidth2; sx++)
+	// Iterate over image blocks. Tiling is a permutation of blocks, so every destination block
+	// is written once, and rows of source blocks could be processed in parallel.
+	ForEachBlockRowRange(blockHeight2, blockWidth2, [=](int FirstRow, int LastRow)
 		{
-			unsigned swzAddr = GetPS4TiledOffset(sx, sy, blockWidth2);	// do once for whole block
-			int dy = swzAddr / blockWidth2;
-			int dx = swzAddr % blockWidth2;
-			if (dx >= blockWidth || dy >= blockHeight)
+			for (int sy = FirstRow; sy < LastRow; sy++)
 			{
-				// We're sampling over source image coordinates which could be
-				// larger than target image, so perform clamping
-				continue;
+				for (int sx = 0; sx < blockWidth2; sx++)
+				{
+					unsigned swzAddr = GetPS4TiledOffset(sx, sy, blockWidth2);	// do once for whole block
+					int dy = swzAddr / blockWidth2;
+					int dx = swzAddr % blockWidth2;
+					if (dx >= blockWidth || dy >= blockHeight)
+					{
+						// We're sampling over source image coordinates which could be
+						// larger than target image, so perform clamping
+						continue;
+					}
+
+					byte       *pDst = dst + (dy * blockWidth + dx) * bytesPerBlock;
+					const byte *pSrc = src + (sy * blockWidth2 + sx) * bytesPerBlock;
+					memcpy(pDst, pSrc, bytesPerBlock);
+				}
 			}
-
-			byte       *pDst = dst + (dy * blockWidth + dx) * bytesPerBlock;
-			const byte *pSrc = src + (sy * blockWidth2 + sx) * bytesPerBlock;
-			memcpy(pDst, pSrc, bytesPerBlock);
-		}
-	}
+		});
 
 	unguard;
 }
@@ -887,38 +1497,45 @@ static bool UntileCompressedNSWTexture(const byte *src, int dataSize, byte *dst,
 //		blockWidth, blockHeight, width, blockSizeX, height, blockSizeY,
 //		blockWidth * blockHeight * bytesPerBlock, dataSize);
 	// Iterate over image blocks
-	for (int dy = 0; dy < blockHeight; dy++)
-	{
-		for (int dx = 0; dx < blockWidth; dx++)
-		{
-			int x_coord_in_block = dx * bytesPerBlock;
-			int y_coord_in_block = dy;
-			unsigned gobOffset =
-				(x_coord_in_block / bytes_per_gob_x) * bytes_per_gob_y +
-				y_coord_in_block / (bytes_per_gob_y * 8) * bytes_per_gob_y * gobs_per_block_x +
-				(y_coord_in_block % (bytes_per_gob_y * 8) >> 3);
-			gobOffset = gobOffset * 512; // should be gob_bytes, but this won't work for (bytes_per_gob_y != 8), so we'll use a constant here
-
-			unsigned offset =
-				(((x_coord_in_block & 0x3f) >> 5) << 8) + //?? 0011.1111 >> 5 -> 0001, i.e. mask 1 bit and shift it to appropriate position
-				(((y_coord_in_block &    7) >> 1) << 6) +
-				(((x_coord_in_block & 0x1f) >> 4) << 5) +
-				( (y_coord_in_block &    1)       << 4) +
-				(  x_coord_in_block &  0xf            );
-
-			unsigned swzAddr = gobOffset + offset;
-//			if (swzAddr >= dataSize) appPrintf("x=%d/%d, y=%d/%d, sy=%d, swzAddr=%d+%d->%d >= %d\n",
-//				dx, blockWidth, dy, blockHeight, bytes_per_gob_y, gobOffset, offset, swzAddr, dataSize);
-			if (swzAddr >= dataSize)
-				return false; // failed, something's wrong with parameters or decoder
-
-			byte       *pDst = dst + (dy * blockWidth + dx) * bytesPerBlock;
-			const byte *pSrc = src + swzAddr;
-			memcpy(pDst, pSrc, bytesPerBlock);
-		}
-	}
+	volatile bool Failed = false;
+	ForEachBlockRowRange(blockHeight, blockWidth, [=, &Failed](int FirstRow, int LastRow)
+		{
+			for (int dy = FirstRow; dy < LastRow && !Failed; dy++)
+			{
+				for (int dx = 0; dx < blockWidth; dx++)
+				{
+					int x_coord_in_block = dx * bytesPerBlock;
+					int y_coord_in_block = dy;
+					unsigned gobOffset =
+						(x_coord_in_block / bytes_per_gob_x) * bytes_per_gob_y +
+						y_coord_in_block / (bytes_per_gob_y * 8) * bytes_per_gob_y * gobs_per_block_x +
+						(y_coord_in_block % (bytes_per_gob_y * 8) >> 3);
+					gobOffset = gobOffset * 512; // should be gob_bytes, but this won't work for (bytes_per_gob_y != 8), so we'll use a constant here
+
+					unsigned offset =
+						(((x_coord_in_block & 0x3f) >> 5) << 8) + //?? 0011.1111 >> 5 -> 0001, i.e. mask 1 bit and shift it to appropriate position
+						(((y_coord_in_block &    7) >> 1) << 6) +
+						(((x_coord_in_block & 0x1f) >> 4) << 5) +
+						( (y_coord_in_block &    1)       << 4) +
+						(  x_coord_in_block &  0xf            );
+
+					unsigned swzAddr = gobOffset + offset;
+//					if (swzAddr >= dataSize) appPrintf("x=%d/%d, y=%d/%d, sy=%d, swzAddr=%d+%d->%d >= %d\n",
+//						dx, blockWidth, dy, blockHeight, bytes_per_gob_y, gobOffset, offset, swzAddr, dataSize);
+					if (swzAddr >= dataSize)
+					{
+						Failed = true; // failed, something's wrong with parameters or decoder
+						break;
+					}
+
+					byte       *pDst = dst + (dy * blockWidth + dx) * bytesPerBlock;
+					const byte *pSrc = src + swzAddr;
+					memcpy(pDst, pSrc, bytesPerBlock);
+				}
+			}
+		});
 
-	return true;
+	return !Failed;
 	unguard;
 }
 
@@ -949,7 +949,19 @@ ETexturePixelFormat UTexture2D::GetTexturePixelFormat() const
 
 bool UTexture2D::GetTextureData(CTextureData &TexData) const
 {
-	guard(UTexture2D::GetTextureData);
+	return LoadTextureData(TexData, -1);
+}
+
+bool UTexture2D::GetTextureMip(CTextureData &TexData, int MaxSize) const
+{
+	return LoadTextureData(TexData, max(MaxSize, 0));
+}
+
+bool UTexture2D::LoadTextureData(CTextureData &TexData, int MaxSize) const
+{
+	guard(UTexture2D::LoadTextureData);
+
+	bool SingleMip = (MaxSize >= 0);
 
 	TexData.SetObject(this);
 	TexData.OriginalFormatEnum = Format;
@@ -1003,8 +1015,13 @@ bool UTexture2D::GetTextureData(CTextureData &TexData) const
 		bool dataLoaded = false;
 		int OrigUSize = (*MipsArray)[0].SizeX;
 		int OrigVSize = (*MipsArray)[0].SizeY;
-		for (int mipLevel = 0; mipLevel < MipsArray->Num(); mipLevel++)
+		int NumMips = MipsArray->Num();
+		// When a single mip is requested, start from the selected mip and continue with smaller ones,
+		// then check larger mips if none of them has data. Bulk data is loaded only for the returned mip.
+		int FirstMip = SingleMip ? CTextureData::FindMipForSize(OrigUSize, OrigVSize, NumMips, MaxSize) : 0;
+		for (int i = 0; i < NumMips; i++)
 		{
+			int mipLevel = (i < NumMips - FirstMip) ? FirstMip + i : NumMips - 1 - i;
 			// find 1st mipmap with non-null data array
 			const FTexture2DMipMap &Mip = (*MipsArray)[mipLevel];
 			const FByteBulkData &Bulk = Mip.Data;
@@ -1037,6 +1054,7 @@ bool UTexture2D::GetTextureData(CTextureData &TexData) const
 			DstMip->VSize = max(1, OrigVSize >> mipLevel);
 //			printf("+%d: %d x %d (%X)\n", mipLevel, DstMip->USize, DstMip->VSize, DstMip->DataSize);
 			TexData.Platform = Package->Platform;
+			if (SingleMip) break;
 		}
 	}
 
@@ -1052,6 +1070,10 @@ bool UTexture2D::GetTextureData(CTextureData &TexData) const
 //		printf("Source png texture %dx%d\n", Source.SizeX, Source.SizeY);
 	}
 
+	// Mips could be provided by game-specific code above
+	if (SingleMip)
+		TexData.KeepSingleMip(MaxSize);
+
 	// Decode console textures
 
 #if SUPPORT_XBOX360
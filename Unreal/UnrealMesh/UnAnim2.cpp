@@ -69,6 +69,7 @@ void UMeshAnimation::ConvertAnims()
 					T->KeyTime[k] *= TimeScale;
 			}
 		}
+		S.Pack();
 	}
 
 	unguard;
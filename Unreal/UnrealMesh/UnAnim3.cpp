@@ -1313,6 +1313,11 @@ void UAnimSet::ConvertAnims()
 		}
 	}
 
+	// Move keys of every sequence into a single memory block. Done as a separate pass because
+	// some game-specific decoders are leaving the sequence loop early.
+	for (CAnimSequence* Seq : AnimSet->Sequences)
+		Seq->Pack();
+
 	unguard;
 }
 
@@ -1105,6 +1105,9 @@ void USkeleton::ConvertAnims(UAnimSequence4* Seq)
 	AdjustSequenceBySkeleton(this, RetargetTransforms ? *RetargetTransforms : ReferenceSkeleton.RefBonePose, Dst);
 #endif
 
+	// Move all keys into a single memory block
+	Dst->Pack();
+
 	unguardf("Skel=%s Anim=%s", Name, Seq->Name);
 }
 
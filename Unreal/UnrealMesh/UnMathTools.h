@@ -2,6 +2,7 @@
 #define __UNMATH_TOOLS_H__
 
 #include "Mesh/MeshCommon.h"	// types for CVertexShare
+#include "Parallel.h"			// for CVertexShare::AddVertices
 
 inline void RotatorToAxis(const FRotator& Rot, CAxis& Axis)
 {
@@ -103,6 +104,11 @@ inline void ComputeBounds(const T *Data, int NumVerts, int Stride, CVec3 &Mins,
 
 #define USE_HASHING	1		// can disable this to compare performance
 
+// Meshes with this number of vertices or more are welded using multiple threads by CVertexShare::AddVertices()
+#define PARALLEL_WELD_MIN_VERTS		65536
+// Number of vertices processed by a single task
+#define PARALLEL_WELD_TASK_VERTS	16384
+
 // structure which helps to share vertices between wedges
 //?? rename to "CVertexWelder"?
 struct CVertexShare
@@ -115,14 +121,13 @@ struct CVertexShare
 	int				WedgeIndex;
 
 #if USE_HASHING
-	// hashing
-	CVec3			Mins, Maxs;
-	CVec3			Extents;
-	int				Hash[16384];
+	// hashing: table size is a power of 2 and depends on number of vertices
+	TArray<int>		Hash;
 	TArray<int>		HashNext;
+	int				HashShift;
 #endif // USE_HASHING
 
-	void Prepare(const CMeshVertex *Verts, int NumVerts, int VertexSize)
+	void Prepare(int NumVerts)
 	{
 		WedgeIndex = 0;
 		Points.Empty(NumVerts);
@@ -132,16 +137,34 @@ struct CVertexShare
 		VertToWedge.Empty(NumVerts);
 		VertToWedge.AddZeroed(NumVerts);
 #if USE_HASHING
-		// compute bounds for better hashing
-		ComputeBounds(&Verts->Position, NumVerts, VertexSize, Mins, Maxs);
-		VectorSubtract(Maxs, Mins, Extents);
-		Extents[0] += 1; Extents[1] += 1; Extents[2] += 1; // avoid zero divide
+		int HashBits = 8;
+		while ((1 << HashBits) < NumVerts && HashBits < 24)
+			HashBits++;
+		HashShift = 32 - HashBits;
 		// initialize Hash and HashNext with -1
+		Hash.Init(-1, 1 << HashBits);
 		HashNext.Init(-1, NumVerts);
-		memset(Hash, -1, sizeof(Hash));
 #endif // USE_HASHING
 	}
 
+#if USE_HASHING
+	// Hash exact position, normal and extra info, so only identical vertices are guaranteed to share
+	// a hash chain. Fibonacci hashing is used: the top bits of result depend on all input bits.
+	FORCEINLINE int GetHash(const CVec3 &Pos, CPackedNormal Normal, uint32 ExtraInfo) const
+	{
+		uint32 h = ExtraInfo;
+		for (int i = 0; i < 3; i++)
+		{
+			float f = Pos[i] + 0.0f;		// convert -0 to +0, these values are equal when compared as floats
+			uint32 Bits;
+			memcpy(&Bits, &f, sizeof(Bits));
+			h = (h ^ Bits) * 0x9E3779B1;
+		}
+		h = (h ^ Normal.Data) * 0x9E3779B1;
+		return h >> HashShift;
+	}
+#endif // USE_HASHING
+
 	int AddVertex(const CVec3 &Pos, CPackedNormal Normal, uint32 ExtraInfo = 0)
 	{
 		int PointIndex = -1;
@@ -150,10 +173,7 @@ struct CVertexShare
 
 #if USE_HASHING
 		// compute hash
-		int h = appFloor(
-			( (Pos[0] - Mins[0]) / Extents[0] + (Pos[1] - Mins[1]) / Extents[1] + (Pos[2] - Mins[2]) / Extents[2] ) // 0..3
-			* (ARRAY_COUNT(Hash) / 3.0f * 16)			// multiply to 16 for better spreading inside Hash array
-		) % ARRAY_COUNT(Hash);
+		int h = GetHash(Pos, Normal, ExtraInfo);
 		// find point with the same position and normal
 		for (PointIndex = Hash[h]; PointIndex >= 0; PointIndex = HashNext[PointIndex])
 		{
@@ -188,6 +208,205 @@ struct CVertexShare
 
 		return PointIndex;
 	}
+
+	// Add NumVerts vertices to the empty (just prepared) CVertexShare. Result is the same as calling AddVertex()
+	// for every vertex in order, but large meshes are processed using multiple threads. GetVertex(Index, Pos,
+	// Normal, ExtraInfo) should fill vertex data, it is called once per vertex, possibly from different threads.
+	template<typename F>
+	void AddVertices(int NumVerts, F&& GetVertex)
+	{
+		guard(CVertexShare::AddVertices);
+		assert(WedgeIndex == 0);
+
+#if USE_HASHING && THREADING
+		// Parallel welding does about twice more work than sequential one, so use it only with enough threads
+		if (NumVerts >= PARALLEL_WELD_MIN_VERTS && ThreadPool::GetNumThreads() >= 3)
+		{
+			AddVerticesParallel(NumVerts, GetVertex);
+			return;
+		}
+#endif // USE_HASHING && THREADING
+
+		for (int i = 0; i < NumVerts; i++)
+		{
+			CVec3 Pos;
+			CPackedNormal Normal;
+			uint32 ExtraInfo = 0;
+			GetVertex(i, Pos, Normal, ExtraInfo);
+			AddVertex(Pos, Normal, ExtraInfo);
+		}
+
+		unguard;
+	}
+
+#if USE_HASHING && THREADING
+protected:
+	friend bool BenchmarkVertexShare();		// uses AddVerticesParallel() directly
+
+	// Vertices are split into partitions by the top bits of hash value, so every partition owns its own range
+	// of Hash[] and could be welded independently. Inside of partition vertices are processed in original order
+	// exactly like AddVertex() does, but using vertex indices in place of point indices. Points are numbered
+	// after that, and hash chains are converted to point indices.
+	template<typename F>
+	void AddVerticesParallel(int NumVerts, F& GetVertex)
+	{
+		enum { PartitionBits = 8, NumPartitions = 1 << PartitionBits };
+		int PartitionShift = 32 - PartitionBits - HashShift;	// bucket -> partition
+		int NumChunks = (NumVerts + PARALLEL_WELD_TASK_VERTS - 1) / PARALLEL_WELD_TASK_VERTS;
+
+		TArray<CVec3> Pos;
+		TArray<CPackedNormal> Norm;
+		TArray<uint32> Extra;
+		TArray<int> VertHash;
+		Pos.AddUninitialized(NumVerts);
+		Norm.AddUninitialized(NumVerts);
+		Extra.AddUninitialized(NumVerts);
+		VertHash.AddUninitialized(NumVerts);
+		TArray<int> ChunkCount;						// [Chunk * NumPartitions + Partition]
+		ChunkCount.AddZeroed(NumChunks * NumPartitions);
+
+		auto ForEachChunk = [NumVerts, NumChunks](auto&& Func)
+		{
+			ParallelFor(NumChunks, [&Func, NumVerts](int Chunk)
+				{
+					int First = Chunk * PARALLEL_WELD_TASK_VERTS;
+					Func(Chunk, First, min(First + PARALLEL_WELD_TASK_VERTS, NumVerts));
+				});
+		};
+
+		// Collect vertex data, compute hashes and partition sizes
+		ForEachChunk([&](int Chunk, int First, int Last)
+			{
+				int* Count = &ChunkCount[Chunk * NumPartitions];
+				for (int i = First; i < Last; i++)
+				{
+					Extra[i] = 0;
+					GetVertex(i, Pos[i], Norm[i], Extra[i]);
+					Norm[i].Data &= 0xFFFFFF;		// clear W component, as AddVertex() does
+					int h = GetHash(Pos[i], Norm[i], Extra[i]);
+					VertHash[i] = h;
+					Count[h >> PartitionShift]++;
+				}
+			});
+
+		// Compute placement of every chunk inside of partitions
+		TArray<int> PartitionStart;
+		PartitionStart.AddUninitialized(NumPartitions + 1);
+		int Offset = 0;
+		for (int Part = 0; Part < NumPartitions; Part++)
+		{
+			PartitionStart[Part] = Offset;
+			for (int Chunk = 0; Chunk < NumChunks; Chunk++)
+			{
+				int& Count = ChunkCount[Chunk * NumPartitions + Part];
+				int Start = Offset;
+				Offset += Count;
+				Count = Start;
+			}
+		}
+		PartitionStart[NumPartitions] = Offset;
+
+		// Put vertices into partitions, keeping original order
+		TArray<int> PartVerts;
+		PartVerts.AddUninitialized(NumVerts);
+		ForEachChunk([&](int Chunk, int First, int Last)
+			{
+				int* Start = &ChunkCount[Chunk * NumPartitions];
+				for (int i = First; i < Last; i++)
+					PartVerts[Start[VertHash[i] >> PartitionShift]++] = i;
+			});
+
+		// Weld vertices. FirstVert[i] is the first vertex identical to 'i', LastVert[j] is the last vertex identical
+		// to 'j' (valid only for FirstVert[j] == j). Hash and VertNext are chains of "first" vertices.
+		TArray<int> FirstVert, LastVert, VertNext;
+		FirstVert.AddUninitialized(NumVerts);
+		LastVert.AddUninitialized(NumVerts);
+		VertNext.AddUninitialized(NumVerts);
+		ParallelFor(NumPartitions, [&](int Part)
+			{
+				for (int k = PartitionStart[Part]; k < PartitionStart[Part + 1]; k++)
+				{
+					int i = PartVerts[k];
+					int h = VertHash[i];
+					int j;
+					for (j = Hash[h]; j >= 0; j = VertNext[j])
+					{
+						if (Pos[j] == Pos[i] && Norm[j] == Norm[i] && Extra[j] == Extra[i])
+							break;
+					}
+					if (j < 0)
+					{
+						j = i;
+						VertNext[i] = Hash[h];
+						Hash[h] = i;
+					}
+					FirstVert[i] = j;
+					LastVert[j] = i;
+				}
+			});
+
+		// Allocate points in vertex order, the same way as AddVertex() does
+		TArray<int> ChunkPoints;
+		ChunkPoints.AddZeroed(NumChunks);
+		ForEachChunk([&](int Chunk, int First, int Last)
+			{
+				for (int i = First; i < Last; i++)
+					if (FirstVert[i] == i) ChunkPoints[Chunk]++;
+			});
+		int NumPoints = 0;
+		for (int Chunk = 0; Chunk < NumChunks; Chunk++)
+		{
+			int Count = ChunkPoints[Chunk];
+			ChunkPoints[Chunk] = NumPoints;
+			NumPoints += Count;
+		}
+		Points.AddUninitialized(NumPoints);
+		Normals.AddUninitialized(NumPoints);
+		ExtraInfos.AddUninitialized(NumPoints);
+		WedgeToVert.AddUninitialized(NumVerts);
+		ForEachChunk([&](int Chunk, int First, int Last)
+			{
+				int PointIndex = ChunkPoints[Chunk];
+				for (int i = First; i < Last; i++)
+				{
+					if (FirstVert[i] != i) continue;
+					Points[PointIndex] = Pos[i];
+					Normals[PointIndex] = Norm[i];
+					ExtraInfos[PointIndex] = Extra[i];
+					VertToWedge[PointIndex] = LastVert[i];
+					WedgeToVert[i] = PointIndex++;
+				}
+			});
+		ForEachChunk([&](int Chunk, int First, int Last)
+			{
+				for (int i = First; i < Last; i++)
+					WedgeToVert[i] = WedgeToVert[FirstVert[i]];
+			});
+
+		// Convert hash chains to point indices, so AddVertex() could be used after this call
+		ParallelFor(NumPartitions, [&](int Part)
+			{
+				int FirstBucket = Part << PartitionShift;
+				int LastBucket = (Part + 1) << PartitionShift;
+				for (int h = FirstBucket; h < LastBucket; h++)
+				{
+					for (int i = Hash[h]; i >= 0; i = VertNext[i])
+					{
+						int Next = VertNext[i];
+						HashNext[WedgeToVert[i]] = (Next >= 0) ? WedgeToVert[Next] : -1;
+					}
+					if (Hash[h] >= 0)
+						Hash[h] = WedgeToVert[Hash[h]];
+				}
+			});
+
+		WedgeIndex = NumVerts;
+	}
+#endif // USE_HASHING && THREADING
 };
 
+// Weld several generated meshes with CVertexShare (sequentially and in parallel) and with a simple reference
+// algorithm, compare results and print timings. Returns false when results are different.
+bool BenchmarkVertexShare();
+
 #endif // __UNMATH_TOOLS_H__
@@ -778,7 +778,7 @@ struct FGPUVert3Common
 	}
 };
 
-static int GNumGPUUVSets = 1;
+static thread_local int GNumGPUUVSets = 1;
 
 struct FGPUVert3Half : FGPUVert3Common
 {
@@ -2827,9 +2827,10 @@ struct FStaticMeshVertexStream3
 };
 
 
-static int  GNumStaticUVSets    = 1;
-static bool GUseStaticFloatUVs  = true;
-static bool GStripStaticNormals = false;
+// Serialization context is thread-local, because objects could be serialized in parallel
+static thread_local int  GNumStaticUVSets    = 1;
+static thread_local bool GUseStaticFloatUVs  = true;
+static thread_local bool GStripStaticNormals = false;
 
 struct FStaticMeshUVItem3
 {
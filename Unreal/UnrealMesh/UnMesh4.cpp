@@ -136,9 +136,10 @@ struct FPositionVertexBuffer4
 };
 
 //?? TODO: rename, because these vars are now used for both mesh types (see FStaticMeshVertexBuffer4)
-static int  GNumStaticUVSets   = 1;
-static bool GUseStaticFloatUVs = true;
-static bool GUseHighPrecisionTangents = false;
+// Serialization context is thread-local, because objects could be serialized in parallel
+static thread_local int  GNumStaticUVSets   = 1;
+static thread_local bool GUseStaticFloatUVs = true;
+static thread_local bool GUseHighPrecisionTangents = false;
 
 struct FStaticMeshUVItem4
 {
@@ -358,7 +359,7 @@ struct FOverlappingVerticesCustomVersion
 	}
 };
 
-static int GNumSkelInfluences = 4;
+static thread_local int GNumSkelInfluences = 4;
 
 // Bone influence mapping for skeletal mesh vertex
 struct FSkinWeightInfo
@@ -499,7 +500,7 @@ struct FRigidVertex4 : public FSoftVertex4
 	}
 };
 
-static int GNumSkelUVSets = 1;
+static thread_local int GNumSkelUVSets = 1;
 
 // GPU vertex with float16 UV data
 struct FGPUVert4Half : public FSkelMeshVertexBase
@@ -89,6 +89,76 @@ void ReleaseAllObjects()
 }
 
 
+#if THREADING
+
+static void LoadPackagesForBenchmark(const TArray<UnPackage*>& Packages, TArray<FString>& Objects)
+{
+	UObject::BeginLoad();
+	for (UnPackage* Package : Packages)
+		LoadWholePackage(Package);
+	UObject::EndLoad();
+
+	Objects.Empty(UObject::GObjObjects.Num());
+	for (const UObject* Obj : UObject::GObjObjects)
+	{
+		char Buffer[1024];
+		appSprintf(ARRAY_ARG(Buffer), "%s'%s.%s' (%d)", Obj->GetClassName(), Obj->Package ? Obj->Package->Name : "None",
+			Obj->Name, Obj->PackageIndex);
+		new (Objects) FString(Buffer);
+	}
+	ReleaseAllObjects();
+}
+
+bool BenchmarkParallelLoading(const TArray<UnPackage*>& Packages)
+{
+	guard(BenchmarkParallelLoading);
+
+	const int NumRounds = 5;
+	appPrintf("Verifying parallel loading: %d packages, %d rounds\n", Packages.Num(), NumRounds);
+
+	bool bSavedParallelLoading = GParallelObjectLoading;
+	TArray<FString> SerialObjects;
+	GParallelObjectLoading = false;
+	int StartTime = appMilliseconds();
+	LoadPackagesForBenchmark(Packages, SerialObjects);
+	int SerialTime = appMilliseconds() - StartTime;
+
+	GParallelObjectLoading = true;
+	int ParallelTime = 0;
+	int NumMismatches = 0;
+	for (int Round = 0; Round < NumRounds; Round++)
+	{
+		TArray<FString> ParallelObjects;
+		StartTime = appMilliseconds();
+		LoadPackagesForBenchmark(Packages, ParallelObjects);
+		ParallelTime += appMilliseconds() - StartTime;
+
+		int NumObjects = max(SerialObjects.Num(), ParallelObjects.Num());
+		for (int Index = 0; Index < NumObjects; Index++)
+		{
+			const char* Serial = Index < SerialObjects.Num() ? *SerialObjects[Index] : "(none)";
+			const char* Parallel = Index < ParallelObjects.Num() ? *ParallelObjects[Index] : "(none)";
+			if (strcmp(Serial, Parallel) != 0)
+			{
+				appPrintf("Round %d: object %d is %s, serial loading has %s\n", Round, Index, Parallel, Serial);
+				NumMismatches++;
+				break;
+			}
+		}
+	}
+	GParallelObjectLoading = bSavedParallelLoading;
+
+	appPrintf("%d objects, serial: %d ms, parallel: %d ms per round\n", SerialObjects.Num(), SerialTime, ParallelTime / NumRounds);
+	bool bResult = (NumMismatches == 0);
+	appPrintf(bResult ? "Parallel loading: object order is identical to serial loading\n" : "Parallel loading: MISMATCH found\n");
+	return bResult;
+
+	unguard;
+}
+
+#endif // THREADING
+
+
 /*-----------------------------------------------------------------------------
 	Package version scanner
 -----------------------------------------------------------------------------*/
@@ -241,6 +311,9 @@ static void ScanPackageExports(UnPackage* package, CGameFileInfo* file)
 	} */
 }
 
+// Number of packages loaded in parallel between progress updates
+#define SCAN_BATCH_SIZE		256
+
 bool ScanContent(const TArray<const CGameFileInfo*>& Packages, IProgressCallback* Progress)
 {
 	guard(ScanContent);
@@ -254,50 +327,72 @@ bool ScanContent(const TArray<const CGameFileInfo*>& Packages, IProgressCallback
 	// Preallocate PackageMap
 	UnPackage::ReservePackageMap(Packages.Num());
 
-	for (int i = 0; i < Packages.Num(); i++)
-	{
-		CGameFileInfo* file = const_cast<CGameFileInfo*>(Packages[i]);		// we'll modify this structure here
-		if (file->IsPackageScanned) continue;
+	TArray<const CGameFileInfo*> Batch;
+	TArray<int> BatchIndices;
+	Batch.Reserve(SCAN_BATCH_SIZE);
+	BatchIndices.Reserve(SCAN_BATCH_SIZE);
 
-		// Update progress dialog
-		FStaticString<MAX_PACKAGE_PATH> RelativeName;
-		file->GetRelativeName(RelativeName);
-		if (Progress && !Progress->Progress(*RelativeName, i, Packages.Num()))
+	int i = 0;
+	while (i < Packages.Num() && !cancelled)
+	{
+		// Collect next portion of not scanned packages
+		Batch.Reset();
+		BatchIndices.Reset();
+		for ( ; i < Packages.Num() && Batch.Num() < SCAN_BATCH_SIZE; i++)
 		{
-			cancelled = true;
-			break;
+			if (Packages[i]->IsPackageScanned) continue;
+			Batch.Add(Packages[i]);
+			BatchIndices.Add(i);
 		}
+		if (!Batch.Num()) break;
 
-		file->IsPackageScanned = true;
+		// Load package tables using all threads. Progress callback is called from this thread only,
+		// so it's safe to update UI from it.
+		UnPackage::LoadPackages(Batch, /*silent=*/ true);
 
-		if (file->Package)
+		for (int j = 0; j < Batch.Num(); j++)
 		{
-			// package already loaded
-			ScanPackageExports(file->Package, file);
+			CGameFileInfo* file = const_cast<CGameFileInfo*>(Batch[j]);		// we'll modify this structure here
+
+			// Update progress dialog
+			FStaticString<MAX_PACKAGE_PATH> RelativeName;
+			file->GetRelativeName(RelativeName);
+			if (Progress && !Progress->Progress(*RelativeName, BatchIndices[j], Packages.Num()))
+			{
+				// Packages which are already loaded remain loaded, however they're not marked as scanned
+				cancelled = true;
+				break;
+			}
+
+			file->IsPackageScanned = true;
+
+			// Package could be NULL if it failed to load (should not happen)
+			if (file->Package)
+			{
+				ScanPackageExports(file->Package, file);
+			#if 0
+				// this code is disabled: it works, however we're going to use ScanContent not just to get objects counts,
+				// but also for collecting object references
+
+				// now unload package to not waste memory
+				UnPackage::UnloadPackage(file->Package);
+				assert(file->Package == NULL);
+			#endif
+			}
+			scanned = true;
 		}
-		else
-		{
-			UnPackage* package = UnPackage::LoadPackage(file, /*silent=*/ true);	// should always return non-NULL
-			if (!package) continue;		// should not happen
-			// Don't keep the package's reader open
-			package->CloseReader();
-
-			ScanPackageExports(package, file);
-		#if 0
-			// this code is disabled: it works, however we're going to use ScanContent not just to get objects counts,
-			// but also for collecting object references
-
-			// now unload package to not waste memory
-			UnPackage::UnloadPackage(package);
-			assert(file->Package == NULL);
-		#endif
-		}
-		scanned = true;
 	}
 #if PROFILE
 	if (scanned)
 		appPrintProfiler("Scanned packages");
 #endif
+#if UNREAL4
+	if (scanned)
+	{
+		// Store scan results in the game index cache
+		appSaveGameIndex();
+	}
+#endif
 #if 0
 	void PrintStringHashDistribution();
 	PrintStringHashDistribution();
@@ -24,6 +24,11 @@ public:
 bool LoadWholePackage(UnPackage* Package, IProgressCallback* progress = NULL);
 void ReleaseAllObjects();
 
+#if THREADING
+// Load packages serially and in parallel, and verify that objects are created in the same order
+bool BenchmarkParallelLoading(const TArray<UnPackage*>& Packages);
+#endif
+
 
 // Package scanner
 
@@ -5,9 +5,12 @@
 #include "UnPackage.h"
 #include "UnPackageUE3Reader.h"
 #include "UE4Version.h"			// for VER_UE4_NON_OUTER_PACKAGE_IMPORT
+#include "FileSystem/GameFileSystem.h"	// for FVirtualFileSystem
 
 #include "GameDatabase.h"		// for GetGameTag()
 
+#include "Parallel.h"
+
 //#define PROFILE_PACKAGE_TABLES	1
 
 /*-----------------------------------------------------------------------------
@@ -256,11 +259,14 @@ void FObjectImport::Serialize(FArchive& Ar)
 	Package loading (creation) / unloading
 -----------------------------------------------------------------------------*/
 
-UnPackage::UnPackage(const char *filename, const CGameFileInfo* fileInfo, bool silent)
+UnPackage::UnPackage(const char *filename, const CGameFileInfo* fileInfo, bool silent, bool bRegister)
 :	Loader(NULL)
 #if UNREAL4
 ,	ExportIndices_IOS(NULL)
 #endif
+,	DataFileInfo(NULL)
+,	DataReader(NULL)
+,	SavedDataReader(NULL)
 {
 	guard(UnPackage::UnPackage);
 
@@ -307,6 +313,7 @@ UnPackage::UnPackage(const char *filename, const CGameFileInfo* fileInfo, bool s
 		// and circular dependencies are possible
 		RegisterPackage(filename);
 		LoadPackageIoStore();
+		SetupDataReader(baseLoader, FileInfo);
 		// Release package file handle
 		CloseReader();
 		if (!IsValid())
@@ -390,6 +397,9 @@ UnPackage::UnPackage(const char *filename, const CGameFileInfo* fileInfo, bool s
 	LoadImportTable();
 	LoadExportTable();
 
+	FArchive* DataBaseReader = baseLoader;
+	const CGameFileInfo* DataBaseFileInfo = FileInfo;
+
 #if UNREAL4
 	// Process Event Driven Loader packages: such packages are split into 2 pieces: .uasset with headers
 	// and .uexp with object's data. At this moment we already have FPackageFileSummary fully loaded,
@@ -414,6 +424,8 @@ UnPackage::UnPackage(const char *filename, const CGameFileInfo* fileInfo, bool s
 			// Replace loader with this file, but add offset so it will work like it is part of original uasset
 			delete Loader;
 			Loader = new FReaderWrapper(expLoader, -Summary.HeadersSize);
+			DataBaseReader = expLoader;
+			DataBaseFileInfo = expInfo;
 		}
 		else
 		{
@@ -423,7 +435,12 @@ UnPackage::UnPackage(const char *filename, const CGameFileInfo* fileInfo, bool s
 	}
 #endif // UNREAL4
 
-	RegisterPackage(filename);
+	SetupDataReader(DataBaseReader, DataBaseFileInfo);
+
+	if (bRegister)
+	{
+		RegisterPackage(filename);
+	}
 
 	// Release package file handle
 	CloseReader();
@@ -601,6 +618,7 @@ UnPackage::~UnPackage()
 
 	UnregisterPackage();
 
+	if (SavedDataReader) AttachPrefetchedData(NULL);
 	if (Loader) delete Loader;
 
 	if (!IsValid())
@@ -649,11 +667,14 @@ static FFileArchive* FindFileArchive(FArchive* Ar)
 
 static TArray<UnPackage*> OpenReaders;
 
+thread_local const UnPackage* UnPackage::ThreadLoaderPackage = NULL;
+thread_local FArchive* UnPackage::ThreadLoader = NULL;
+
 void UnPackage::SetupReader(int ExportIndex)
 {
 	guard(UnPackage::SetupReader);
-	// open loader if it is closed
-	if (!IsOpen())
+	// open loader if it is closed; thread loaders are always open
+	if (ThreadLoaderPackage != this && !IsOpen())
 	{
 		Open();
 		if (OpenReaders.Num() == 0)
@@ -668,7 +689,7 @@ void UnPackage::SetupReader(int ExportIndex)
 #if UNREAL4
 	if (Exp.RealSerialOffset)
 	{
-		FReaderWrapper* Wrapper = Loader->CastTo<FReaderWrapper>();
+		FReaderWrapper* Wrapper = GetLoader()->CastTo<FReaderWrapper>();
 		Wrapper->ArPosOffset = Exp.RealSerialOffset - Exp.SerialOffset;
 	}
 #endif // UNREAL4
@@ -706,6 +727,149 @@ void UnPackage::CloseAllReaders()
 }
 
 
+/*-----------------------------------------------------------------------------
+	Export data prefetching
+-----------------------------------------------------------------------------*/
+
+// Don't prefetch huge files, this will take too much memory
+#define MAX_PREFETCH_SIZE		(256<<20)
+
+class FPrefetchedReader : public FMemReader
+{
+	DECLARE_ARCHIVE(FPrefetchedReader, FMemReader);
+public:
+	FPrefetchedReader(byte* InData, int InSize)
+	:	FMemReader(InData, InSize)
+	,	Data(InData)
+	{}
+	virtual ~FPrefetchedReader()
+	{
+		appFree(Data);
+	}
+protected:
+	byte*		Data;
+};
+
+void UnPackage::SetupDataReader(FArchive* BaseReader, const CGameFileInfo* BaseFileInfo)
+{
+	// Export data is read either by BaseReader directly, or through FReaderWrapper which only adjusts
+	// the position. Derived classes of FReaderWrapper are used for decryption, so check the exact class.
+	if (!BaseReader || !BaseFileInfo) return;
+	// Prefetching is performed in a worker thread
+	if (BaseFileInfo->FileSystem && !BaseFileInfo->FileSystem->AllowsConcurrentReads()) return;
+	if (Loader == BaseReader ||
+		(!strcmp(Loader->GetName(), FReaderWrapper::StaticGetName()) && static_cast<FReaderWrapper*>(Loader)->Reader == BaseReader))
+	{
+		DataReader = BaseReader;
+		DataFileInfo = BaseFileInfo;
+	}
+}
+
+FArchive* UnPackage::PrefetchExportData() const
+{
+	guard(UnPackage::PrefetchExportData);
+
+	if (!DataFileInfo || DataFileInfo->Size > MAX_PREFETCH_SIZE)
+		return NULL;
+
+	FArchive* File = DataFileInfo->CreateReader(true);
+	if (!File) return NULL;
+
+	int Size = File->GetFileSize();
+	byte* Data = (byte*)appMallocNoInit(max(Size, 1));
+	File->Serialize(Data, Size);
+	delete File;
+
+	return new FPrefetchedReader(Data, Size);
+
+	unguardf("%s", *GetFilename());
+}
+
+void UnPackage::AttachPrefetchedData(FArchive* Reader)
+{
+	guard(UnPackage::AttachPrefetchedData);
+
+	// Find the place where DataReader is stored
+	FArchive** Slot = &Loader;
+	if (Loader != DataReader)
+	{
+		FReaderWrapper* Wrapper = Loader->CastTo<FReaderWrapper>();
+		assert(Wrapper);
+		Slot = &Wrapper->Reader;
+	}
+	assert(*Slot == DataReader);
+
+	if (Reader)
+	{
+		assert(!SavedDataReader);
+		Reader->SetupFrom(*DataReader);
+		SavedDataReader = DataReader;
+		DataReader = Reader;
+	}
+	else
+	{
+		assert(SavedDataReader);
+		delete DataReader;
+		DataReader = SavedDataReader;
+		SavedDataReader = NULL;
+	}
+	*Slot = DataReader;
+
+	unguardf("%s", *GetFilename());
+}
+
+
+bool UnPackage::SupportsThreadLoader() const
+{
+	if (!DataReader) return false;
+	// These packages modify archive state during serialization
+	if (ReverseBytes) return false;
+#if MOH2010
+	if (Game == GAME_MOH2010) return false;
+#endif
+	return true;
+}
+
+FArchive* UnPackage::CreateThreadLoader() const
+{
+	guard(UnPackage::CreateThreadLoader);
+
+	if (!SupportsThreadLoader()) return NULL;
+
+	FArchive* Reader;
+	if (SavedDataReader)
+	{
+		// Prefetched data is attached, share it between threads
+		int Size = DataReader->GetFileSize();
+		Reader = new FMemReader(DataReader->GetDirectPointer(0, Size), Size);
+	}
+	else
+	{
+		Reader = DataFileInfo->CreateReader(true);
+		if (!Reader) return NULL;
+	}
+	Reader->SetupFrom(*DataReader);
+
+	if (Loader != DataReader)
+	{
+		// Apply the same position adjustment as the package's own loader
+		const FReaderWrapper* Wrapper = static_cast<const FReaderWrapper*>(Loader);
+		FReaderWrapper* NewWrapper = new FReaderWrapper(Reader, Wrapper->ArPosOffset);
+		NewWrapper->SetupFrom(*Wrapper);
+		Reader = NewWrapper;
+	}
+	return Reader;
+
+	unguardf("%s", *GetFilename());
+}
+
+void UnPackage::SetThreadLoader(FArchive* Reader) const
+{
+	ThreadLoaderPackage = Reader ? this : NULL;
+	ThreadLoader = Reader;
+}
+
+
 /*-----------------------------------------------------------------------------
 	UObject* and FName serializers
 -----------------------------------------------------------------------------*/
@@ -959,10 +1123,20 @@ UObject* UnPackage::CreateExport(int index)
 {
 	guard(UnPackage::CreateExport);
 
+#if THREADING
+	// Objects could be serialized in parallel, see UObject::EndLoad()
+	CMutex::ScopedLock Lock(GObjectLoadMutex);
+#endif
+
 	// Get previously created object if any
 	FObjectExport& Exp = GetExport(index);
 	if (Exp.Object)
+	{
+#if THREADING
+		CObjectRefRecorder::Add(Exp.Object);
+#endif
 		return Exp.Object;
+	}
 
 
 	// Check if this object just contains default properties
@@ -1009,6 +1183,11 @@ UObject* UnPackage::CreateExport(int index)
 		return NULL;
 	}
 
+#if THREADING
+	// Objects referenced from here, e.g. the outer object, are created by this object
+	CObjectRefRecorder Recorder(Obj);
+#endif
+
 #if UNREAL3
 	// For UE3 we may require finding object in another package
 	if (Game >= GAME_UE3 && (Exp.ExportFlags & EF_ForcedExport)) // ExportFlags appeared in ArVer=247
@@ -1054,6 +1233,10 @@ UObject* UnPackage::CreateExport(int index)
 		{
 			const FObjectExport &OuterExp = GetExport(Exp.PackageIndex - 1);
 			Outer = OuterExp.Object;
+#if THREADING
+			if (Outer)
+				CObjectRefRecorder::Add(Outer);
+#endif
 			if (!Outer)
 			{
 				const char* OuterClassName = GetClassNameFor(OuterExp);
@@ -1081,7 +1264,12 @@ UObject* UnPackage::CreateImport(int index)
 	guard(UnPackage::CreateImport);
 
 	FObjectImport &Imp = GetImport(index);
-	if (Imp.Missing) return NULL;	// error message already displayed for this entry
+	{
+#if THREADING
+		CMutex::ScopedLock Lock(GObjectLoadMutex);
+#endif
+		if (Imp.Missing) return NULL;	// error message already displayed for this entry
+	}
 
 	// load package
 	const char* PackageName = GetObjectPackageName(Imp.PackageIndex);
@@ -1092,7 +1280,19 @@ UObject* UnPackage::CreateImport(int index)
 		return NULL;
 	}
 #endif
+	// Packages are loaded without holding the lock, LoadPackage() is thread-safe itself
 	UnPackage *Package = LoadPackage(PackageName);
+#if UNREAL3
+	UnPackage *StartupPackage = NULL;
+	if (!Package && Engine() >= GAME_UE3 && Engine() < GAME_UE4_BASE)
+		StartupPackage = LoadPackage(GStartupPackage);
+#endif
+
+#if THREADING
+	// Objects could be serialized in parallel, see UObject::EndLoad()
+	CMutex::ScopedLock Lock(GObjectLoadMutex);
+#endif
+
 	int ObjIndex = INDEX_NONE;
 
 	if (Package)
@@ -1111,7 +1311,7 @@ UObject* UnPackage::CreateImport(int index)
 	else if (Engine() >= GAME_UE3 && Engine() < GAME_UE4_BASE)
 	{
 		// check startup package
-		Package = LoadPackage(GStartupPackage);
+		Package = StartupPackage;
 		if (Package)
 			ObjIndex = Package->FindExportForImport(Imp.ObjectName, Imp.ClassName, this, index);
 		// look in other loaded packages
@@ -1307,30 +1507,50 @@ TArray<char*>		MissingPackages;
 		// was specified fully qualified, with full path name, outside of root game path.
 		// This is rare situation, so we can allow a bit unoptimized code here - linear search
 		// for package inside a PackageMap array.
-
-		// Check in missing package names. This check will allow to print "missing package"
-		// warning only once.
-		for (i = 0; i < MissingPackages.Num(); i++)
-			if (!stricmp(LocalName, MissingPackages[i]))
-				return NULL;
-		// Check in loaded packages list. This is done to prevent loading the same package
-		// twice when this function is called with a different filename qualifiers:
-		// "path/package.ext", "package.ext", "package"
-		for (i = 0; i < PackageMap.Num(); i++)
-			if (!stricmp(LocalName, *PackageMap[i]->GetFilename()))
-				return PackageMap[i];
+		{
+#if THREADING
+			CMutex::ScopedLock Lock(GObjectLoadMutex);
+#endif
+			// Check in missing package names. This check will allow to print "missing package"
+			// warning only once.
+			for (i = 0; i < MissingPackages.Num(); i++)
+				if (!stricmp(LocalName, MissingPackages[i]))
+					return NULL;
+			// Check in loaded packages list. This is done to prevent loading the same package
+			// twice when this function is called with a different filename qualifiers:
+			// "path/package.ext", "package.ext", "package"
+			for (i = 0; i < PackageMap.Num(); i++)
+				if (!stricmp(LocalName, *PackageMap[i]->GetFilename()))
+					return PackageMap[i];
+		}
 
 		// Try to load package using file name.
 		if (appFileExists(Name))
 		{
-			UnPackage* package = new UnPackage(Name, NULL, silent);
+			UnPackage* package = new UnPackage(Name, NULL, silent, /*bRegister=*/ false);
+#if THREADING
+			CMutex::ScopedLock Lock(GObjectLoadMutex);
+#endif
 			if (!package->IsValid())
 			{
 				delete package;
 				return NULL;
 			}
+			// The package could be loaded by another thread meanwhile
+			for (i = 0; i < PackageMap.Num(); i++)
+			{
+				if (!stricmp(LocalName, *PackageMap[i]->GetFilename()))
+				{
+					delete package;
+					return PackageMap[i];
+				}
+			}
+			package->RegisterPackage(Name);
 			return package;
 		}
+#if THREADING
+		CMutex::ScopedLock Lock(GObjectLoadMutex);
+#endif
 		MissingPackages.Add(appStrdup(LocalName));
 	}
 
@@ -1345,23 +1565,145 @@ TArray<char*>		MissingPackages;
 /*static*/ UnPackage *UnPackage::LoadPackage(const CGameFileInfo* File, bool silent)
 {
 	guard(UnPackage::LoadPackage(info));
+
 	PROFILE_LABEL(*File->GetRelativeName());
 
-	if (File->IsPackage())
+	if (!File->IsPackage())
+		return NULL;
+
 	{
+#if THREADING
+		CMutex::ScopedLock Lock(GObjectLoadMutex);
+#endif
 		// Check if package was already loaded.
 		if (File->Package)
 			return File->Package;
-		// Load the package with providing 'File' to constructor.
-		UnPackage* package = new UnPackage(*File->GetRelativeName(), File, silent);
-		if (!package->IsValid())
+
+		if (File->IsIOStoreFile())
 		{
-			delete package;
-			return NULL;
+			// IOStore package registers itself before loading of imported packages, because circular
+			// dependencies are possible. Create it while holding the lock.
+			UnPackage* package = new UnPackage(*File->GetRelativeName(), File, silent);
+			if (!package->IsValid())
+			{
+				delete package;
+				return NULL;
+			}
+			return package;
 		}
-		return package;
 	}
-	return NULL;
+
+	// Load the package with providing 'File' to constructor. The lock is not held here, so other threads
+	// could serialize objects or load other packages meanwhile.
+	UnPackage* package = new UnPackage(*File->GetRelativeName(), File, silent, /*bRegister=*/ false);
+	return RegisterLoadedPackage(package, File);
 
 	unguardf("%s", *File->GetRelativeName());
 }
+
+/*static*/ UnPackage* UnPackage::RegisterLoadedPackage(UnPackage* package, const CGameFileInfo* File)
+{
+#if THREADING
+	CMutex::ScopedLock Lock(GObjectLoadMutex);
+#endif
+	if (!package->IsValid() || File->Package)
+	{
+		// Bad package, or the same file was loaded by another thread. Package was never registered,
+		// so don't let the destructor unlink it from CGameFileInfo.
+		package->FileInfo = NULL;
+		delete package;
+		return File->Package;
+	}
+	package->RegisterPackage(*File->GetRelativeName());
+	return package;
+}
+
+#if THREADING
+
+/*static*/ UnPackage* UnPackage::CreateUnregisteredPackage(const CGameFileInfo* File, bool silent)
+{
+	return new UnPackage(*File->GetRelativeName(), File, silent, /*bRegister=*/ false);
+}
+
+/*static*/ bool UnPackage::TryCreatePackage(const CGameFileInfo* File, bool silent, UnPackage*& Package)
+{
+	TRY {
+		Package = CreateUnregisteredPackage(File, silent);
+		return true;
+	} CATCH {
+		return false;
+	}
+}
+
+/*static*/ UnPackage* UnPackage::CreatePackageInThread(const CGameFileInfo* File, bool silent, FString& ErrorMessage)
+{
+	UnPackage* Package = NULL;
+	if (TryCreatePackage(File, silent, Package))
+		return Package;
+
+	// Take the error from GError, so errors of other packages could be recorded too. The message could
+	// be unavailable when another thread has failed at the same time.
+	CErrorContext Error;
+	if (GError.DetachThreadError(Error))
+		ErrorMessage = Error.History;
+	else
+		ErrorMessage = "unknown error";
+	return NULL;
+}
+
+#endif // THREADING
+
+/*static*/ void UnPackage::LoadPackages(const TArray<const CGameFileInfo*>& Files, bool silent)
+{
+	guard(UnPackage::LoadPackages);
+
+	// Create packages without registering them. IOStore packages are skipped here: they're loading
+	// imported packages while being constructed, so these are loaded in the calling thread.
+	TArray<UnPackage*> Packages;
+	Packages.AddZeroed(Files.Num());
+#if THREADING
+	// Errors are printed when packages are registered, so the output doesn't depend on thread timings
+	TArray<FString> Errors;
+	Errors.Empty(Files.Num());
+	for (int i = 0; i < Files.Num(); i++)
+		new (Errors) FString;
+#endif
+	ParallelFor(Files.Num(), [&](int Index)
+		{
+			const CGameFileInfo* File = Files[Index];
+			if (File->IsPackage() && !File->Package && !File->IsIOStoreFile())
+			{
+			#if THREADING
+				Packages[Index] = CreatePackageInThread(File, silent, Errors[Index]);
+			#else
+				Packages[Index] = new UnPackage(*File->GetRelativeName(), File, silent, /*bRegister=*/ false);
+			#endif
+			}
+		});
+
+	// Register packages in PackageMap, keeping the order of Files
+	for (int Index = 0; Index < Files.Num(); Index++)
+	{
+		const CGameFileInfo* File = Files[Index];
+		UnPackage* Package = Packages[Index];
+		if (!Package)
+		{
+		#if THREADING
+			if (!Errors[Index].IsEmpty())
+			{
+				appPrintf("ERROR: unable to load package %s: %s\n", *File->GetRelativeName(), *Errors[Index]);
+				continue;
+			}
+		#endif
+			// Already loaded, not a package, or IOStore package
+			LoadPackage(File, silent);
+		}
+		else
+		{
+			// Could be a bad package, or the same file could appear in the list twice
+			RegisterLoadedPackage(Package, File);
+		}
+	}
+
+	unguard;
+}
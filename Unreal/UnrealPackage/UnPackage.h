@@ -255,7 +255,18 @@ public:
 #endif
 
 protected:
-	UnPackage(const char *filename, const CGameFileInfo* fileInfo = NULL, bool silent = false);
+	// File with export data and its reader, set only when the reader is not wrapped with decrypting or
+	// decompressing archives, so the data could be read from a file directly
+	const CGameFileInfo*	DataFileInfo;
+	FArchive*				DataReader;
+	// Original DataReader while prefetched data is attached
+	FArchive*				SavedDataReader;
+
+	void SetupDataReader(FArchive* BaseReader, const CGameFileInfo* BaseFileInfo);
+
+	// When 'bRegister' is false, the package is not added to PackageMap, and RegisterPackage() should be
+	// called later. This allows creating packages from multiple threads.
+	UnPackage(const char *filename, const CGameFileInfo* fileInfo = NULL, bool silent = false, bool bRegister = true);
 	~UnPackage();
 
 public:
@@ -273,6 +284,9 @@ public:
 	static UnPackage* LoadPackage(const char* Name, bool silent = false);
 	// Load package using existing CGameFileInfo
 	static UnPackage* LoadPackage(const CGameFileInfo* File, bool silent = false);
+	// Load multiple packages at once. Package tables are loaded using all available threads, then packages
+	// are registered in the order of 'Files' array. Use CGameFileInfo::Package to get loaded packages.
+	static void LoadPackages(const TArray<const CGameFileInfo*>& Files, bool silent = false);
 	// We've protected UnPackage's destructor, however it is possible to use UnloadPackage to fully destroy it.
 	// This call is just more noticeable in code than use of 'operator delete'.
 	static void UnloadPackage(UnPackage* package);
@@ -307,6 +321,21 @@ public:
 
 	static void CloseAllReaders();
 
+	// Read the file with export data into memory. The package's reader is not used, so this function could be
+	// called from any thread. Returns NULL when prefetching is not possible.
+	FArchive* PrefetchExportData() const;
+	// Serialize exports from the reader returned by PrefetchExportData(). The package takes ownership of the
+	// reader. Passing NULL releases prefetched data and returns back to file reading.
+	void AttachPrefetchedData(FArchive* Reader);
+
+	// Create a separate reader for export data, so objects of this package could be serialized from multiple
+	// threads at the same time. Returns NULL when the package data can't be read concurrently.
+	bool SupportsThreadLoader() const;
+	FArchive* CreateThreadLoader() const;
+	// Use the reader created with CreateThreadLoader() for serialization performed by the current thread.
+	// Passing NULL returns back to the package's own Loader.
+	void SetThreadLoader(FArchive* Reader) const;
+
 	const char* GetName(int index)
 	{
 		if (unsigned(index) >= Summary.NameCount)
@@ -384,13 +413,19 @@ public:
 	void GetFullExportName(const FObjectExport &Exp, char *buf, int bufSize, bool IncludeObjectName = true, bool IncludeCookedPackageName = true) const;
 	const char *GetUncookedPackageName(int PackageIndex) const;
 
+	// Reader used for export serialization in the current thread
+	FORCEINLINE FArchive* GetLoader() const
+	{
+		return (ThreadLoaderPackage == this) ? ThreadLoader : Loader;
+	}
+
 	// FArchive interface
 	virtual FArchive& operator<<(FName &N);
 	virtual FArchive& operator<<(UObject *&Obj);
 
 	virtual bool IsCompressed() const
 	{
-		return Loader->IsCompressed();
+		return GetLoader()->IsCompressed();
 	}
 #if UNREAL4
 	virtual bool ContainsEditorData() const
@@ -403,44 +438,59 @@ public:
 #endif // UNREAL4
 	virtual void Serialize(void *data, int size)
 	{
-		Loader->Serialize(data, size);
+		GetLoader()->Serialize(data, size);
 	}
 	virtual void Seek(int Pos)
 	{
-		Loader->Seek(Pos);
+		GetLoader()->Seek(Pos);
 	}
 	virtual int Tell() const
 	{
-		return Loader->Tell();
+		return GetLoader()->Tell();
 	}
 	virtual void SetStopper(int Pos)
 	{
-		Loader->SetStopper(Pos);
+		GetLoader()->SetStopper(Pos);
 	}
 	virtual int GetStopper() const
 	{
-		return Loader->GetStopper();
+		return GetLoader()->GetStopper();
 	}
 	virtual int GetFileSize() const
 	{
-		return Loader->GetFileSize();
+		return GetLoader()->GetFileSize();
 	}
 	virtual bool IsOpen() const
 	{
-		return Loader->IsOpen();
+		return GetLoader()->IsOpen();
 	}
 	virtual bool Open()
 	{
-		return Loader->Open();
+		return GetLoader()->Open();
 	}
 	virtual void Close()
 	{
-		Loader->Close();
+		GetLoader()->Close();
 	}
 
 private:
+	// Reader set with SetThreadLoader()
+	static thread_local const UnPackage* ThreadLoaderPackage;
+	static thread_local FArchive* ThreadLoader;
+
 	void RegisterPackage(const char* filename);
 	void UnregisterPackage();
+	// Register package created with bRegister=false. The package is destroyed when it is not valid, or when
+	// the same file was registered by another thread. Returns the registered package for 'File', or NULL.
+	static UnPackage* RegisterLoadedPackage(UnPackage* package, const CGameFileInfo* File);
+#if THREADING
+	// Create a package with bRegister=false in a pool thread, used by LoadPackages(). When loading fails,
+	// NULL is returned and the error is stored to ErrorMessage, so a bad package doesn't stop loading of
+	// other ones.
+	static UnPackage* CreatePackageInThread(const CGameFileInfo* File, bool silent, FString& ErrorMessage);
+	static bool TryCreatePackage(const CGameFileInfo* File, bool silent, UnPackage*& Package);
+	static UnPackage* CreateUnregisteredPackage(const CGameFileInfo* File, bool silent);
+#endif
 
 	void LoadNameTable();
 	void LoadNameTable2();
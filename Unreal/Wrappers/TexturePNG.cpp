@@ -1,7 +1,24 @@
 #include <png.h>
+#include <zlib.h>
 
 #include "Core.h"
 #include "UnCore.h"
+#include "Parallel.h"
+
+#include "TexturePNG.h"
+
+// Image is compressed in independent segments of this size (in bytes of filtered data). Every segment
+// is a sequence of deflate blocks terminated with a sync flush, so segments could be compressed in
+// parallel and simply concatenated. Segment size doesn't depend on the number of threads, so the
+// output is the same for any thread count.
+#define PNG_SEGMENT_SIZE		(256 << 10)
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#	define PNG_USE_SSE2			1
+#	include <emmintrin.h>
+#else
+#	define PNG_USE_SSE2			0
+#endif
 
 struct PngReadCtx
 {
@@ -10,15 +27,6 @@ struct PngReadCtx
 	int ReadOffset;
 };
 
-struct PngWriteCtx
-{
-	TArray<byte>& CompressedData;
-
-	PngWriteCtx(TArray<byte>& pDst)
-	: CompressedData(pDst)
-	{}
-};
-
 static void user_read_compressed(png_structp png_ptr, png_bytep data, png_size_t length)
 {
 	PngReadCtx* ctx = (PngReadCtx*)png_get_io_ptr(png_ptr);
@@ -30,17 +38,6 @@ static void user_read_compressed(png_structp png_ptr, png_bytep data, png_size_t
 	ctx->ReadOffset += length;
 }
 
-static void user_write_compressed(png_structp png_ptr, png_bytep data, png_size_t length)
-{
-	PngWriteCtx* ctx = (PngWriteCtx*) png_get_io_ptr(png_ptr);
-	int Offset = ctx->CompressedData.AddUninitialized(length);
-	memcpy(ctx->CompressedData.GetData() + Offset, data, length);
-}
-
-static void user_flush_data(png_structp png_ptr)
-{
-}
-
 static void user_error_fn(png_structp png_ptr, png_const_charp error_msg)
 {
 	appError("Error in PNG data: %s", error_msg);
@@ -189,10 +186,297 @@ bool UncompressPNG(const unsigned char* CompressedData, int CompressedSize, int
 	unguard;
 }
 
-void CompressPNG(const unsigned char* pic, int Width, int Height, TArray<byte>& CompressedData)
+/*-----------------------------------------------------------------------------
+	PNG compression
+-----------------------------------------------------------------------------*/
+
+enum
+{
+	ROW_FILTER_NONE,
+	ROW_FILTER_SUB,
+	ROW_FILTER_UP,
+	ROW_FILTER_AVG,
+	ROW_FILTER_PAETH,
+	ROW_FILTER_ADAPTIVE,	// choose filter for every row, as libpng does
+};
+
+struct CPngPreset
+{
+	int		Filter;
+	int		Level;
+	int		Strategy;
+};
+
+static const CPngPreset GPngPresets[] =
+{
+	{ ROW_FILTER_ADAPTIVE, 1, Z_FILTERED         },	// PNG_COMPRESS_DEFAULT
+	{ ROW_FILTER_UP,       1, Z_RLE              },	// PNG_COMPRESS_FAST
+	{ ROW_FILTER_NONE,     0, Z_DEFAULT_STRATEGY },	// PNG_COMPRESS_STORE
+	{ ROW_FILTER_ADAPTIVE, 9, Z_FILTERED         },	// PNG_COMPRESS_BEST
+};
+
+static FORCEINLINE byte PaethPredictor(int a, int b, int c)
+{
+	int p = b - c;
+	int q = a - c;
+	int pa = abs(p);
+	int pb = abs(q);
+	int pc = abs(p + q);
+	if (pa <= pb && pa <= pc) return a;
+	return (pb <= pc) ? b : c;
+}
+
+#if PNG_USE_SSE2
+
+// Paeth predictor for 8 pixel components extended to 16 bits
+static FORCEINLINE __m128i PaethPredictorSSE(__m128i a, __m128i b, __m128i c)
+{
+	__m128i p = _mm_sub_epi16(b, c);
+	__m128i q = _mm_sub_epi16(a, c);
+	__m128i pq = _mm_add_epi16(p, q);
+	__m128i zero = _mm_setzero_si128();
+	__m128i pa = _mm_max_epi16(p, _mm_sub_epi16(zero, p));
+	__m128i pb = _mm_max_epi16(q, _mm_sub_epi16(zero, q));
+	__m128i pc = _mm_max_epi16(pq, _mm_sub_epi16(zero, pq));
+	__m128i NotA = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+	__m128i NotB = _mm_cmpgt_epi16(pb, pc);
+	__m128i BorC = _mm_or_si128(_mm_andnot_si128(NotB, b), _mm_and_si128(NotB, c));
+	return _mm_or_si128(_mm_andnot_si128(NotA, a), _mm_and_si128(NotA, BorC));
+}
+
+#endif // PNG_USE_SSE2
+
+// Apply filter to a single row. Prev is the previous unfiltered row (zeros for the first row). Both Cur and
+// Prev should have at least Bpp zero bytes before the row data, so the leftmost pixel doesn't require
+// special processing.
+static void FilterRow(int Filter, const byte* Cur, const byte* Prev, int RowBytes, int Bpp, byte* Dst)
+{
+	int i = 0;
+
+	if (Filter == ROW_FILTER_NONE)
+	{
+		memcpy(Dst, Cur, RowBytes);
+		return;
+	}
+
+#if PNG_USE_SSE2
+	__m128i zero = _mm_setzero_si128();
+	for ( ; i <= RowBytes - 16; i += 16)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i*)(Cur + i));
+		__m128i a = _mm_loadu_si128((const __m128i*)(Cur + i - Bpp));
+		__m128i b = _mm_loadu_si128((const __m128i*)(Prev + i));
+		__m128i r;
+		switch (Filter)
+		{
+		case ROW_FILTER_SUB:
+			r = _mm_sub_epi8(x, a);
+			break;
+		case ROW_FILTER_UP:
+			r = _mm_sub_epi8(x, b);
+			break;
+		case ROW_FILTER_AVG:
+			// _mm_avg_epu8 rounds up, and PNG requires floor((a+b)/2)
+			r = _mm_sub_epi8(x, _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1))));
+			break;
+		default: // ROW_FILTER_PAETH
+			{
+				__m128i c = _mm_loadu_si128((const __m128i*)(Prev + i - Bpp));
+				__m128i Lo = PaethPredictorSSE(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero));
+				__m128i Hi = PaethPredictorSSE(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero));
+				r = _mm_sub_epi8(x, _mm_packus_epi16(Lo, Hi));
+			}
+		}
+		_mm_storeu_si128((__m128i*)(Dst + i), r);
+	}
+#endif // PNG_USE_SSE2
+
+	// Process remaining bytes
+	switch (Filter)
+	{
+	case ROW_FILTER_SUB:
+		for ( ; i < RowBytes; i++)
+			Dst[i] = Cur[i] - Cur[i - Bpp];
+		break;
+	case ROW_FILTER_UP:
+		for ( ; i < RowBytes; i++)
+			Dst[i] = Cur[i] - Prev[i];
+		break;
+	case ROW_FILTER_AVG:
+		for ( ; i < RowBytes; i++)
+			Dst[i] = Cur[i] - ((Cur[i - Bpp] + Prev[i]) >> 1);
+		break;
+	case ROW_FILTER_PAETH:
+		for ( ; i < RowBytes; i++)
+			Dst[i] = Cur[i] - PaethPredictor(Cur[i - Bpp], Prev[i], Prev[i - Bpp]);
+		break;
+	}
+}
+
+// Score of the filtered row: sum of absolute values of bytes treated as signed, the same heuristic as
+// used by libpng
+static int FilterScore(const byte* Data, int Size)
+{
+	int Sum = 0;
+	int i = 0;
+#if PNG_USE_SSE2
+	__m128i zero = _mm_setzero_si128();
+	__m128i Acc = zero;
+	for ( ; i <= Size - 16; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(Data + i));
+		// abs((signed char)v) == min(v, 256 - v) for unsigned bytes
+		Acc = _mm_add_epi32(Acc, _mm_sad_epu8(_mm_min_epu8(v, _mm_sub_epi8(zero, v)), zero));
+	}
+	Sum = _mm_cvtsi128_si32(Acc) + _mm_cvtsi128_si32(_mm_srli_si128(Acc, 8));
+#endif // PNG_USE_SSE2
+	for ( ; i < Size; i++)
+		Sum += abs((signed char)Data[i]);
+	return Sum;
+}
+
+struct CPngSegment
+{
+	int				FirstRow;
+	int				NumRows;
+	uLong			Adler;
+	TArray<byte>	Data;
+};
+
+static void FilterRows(const byte* pic, int Width, int Channels, int Filter, int FirstRow, int NumRows, byte* Dst)
+{
+	guard(FilterRows);
+
+	// Row buffers are prepended with zero bytes, see FilterRow()
+	int RowBytes = Width * Channels;
+	int RowStride = RowBytes + 16;
+	byte* Rows = (byte*)appMalloc(RowStride * 2);
+	byte* Cur = Rows + 16;
+	byte* Prev = Rows + RowStride + 16;
+	byte* Candidates = NULL;
+	if (Filter == ROW_FILTER_ADAPTIVE)
+		Candidates = (byte*)appMallocNoInit(RowBytes * 2);
+
+	// Convert source RGBA row to the destination pixel format
+	auto GetRow = [pic, Width, Channels](int Row, byte* Out)
+	{
+		const byte* s = pic + Row * Width * 4;
+		if (Channels == 4)
+		{
+			memcpy(Out, s, Width * 4);
+			return;
+		}
+		for (int i = 0; i < Width; i++, s += 4, Out += 3)
+		{
+			Out[0] = s[0];
+			Out[1] = s[1];
+			Out[2] = s[2];
+		}
+	};
+
+	if (FirstRow > 0)
+		GetRow(FirstRow - 1, Prev);
+
+	for (int Row = FirstRow; Row < FirstRow + NumRows; Row++)
+	{
+		GetRow(Row, Cur);
+		if (Filter != ROW_FILTER_ADAPTIVE)
+		{
+			*Dst = Filter;
+			FilterRow(Filter, Cur, Prev, RowBytes, Channels, Dst + 1);
+		}
+		else
+		{
+			// Try all filters, keep the best one in Dst and use 'Candidates' for the others
+			int BestScore = FilterScore(Cur, RowBytes);
+			*Dst = ROW_FILTER_NONE;
+			memcpy(Dst + 1, Cur, RowBytes);
+			byte* Test = Candidates;
+			byte* Best = Candidates + RowBytes;
+			for (int f = ROW_FILTER_SUB; f <= ROW_FILTER_PAETH; f++)
+			{
+				FilterRow(f, Cur, Prev, RowBytes, Channels, Test);
+				int Score = FilterScore(Test, RowBytes);
+				if (Score < BestScore)
+				{
+					BestScore = Score;
+					*Dst = f;
+					Exchange(Test, Best);
+				}
+			}
+			if (*Dst != ROW_FILTER_NONE)
+				memcpy(Dst + 1, Best, RowBytes);
+		}
+		Dst += RowBytes + 1;
+		Exchange(Cur, Prev);
+	}
+
+	appFree(Rows);
+	if (Candidates) appFree(Candidates);
+
+	unguard;
+}
+
+// Compress a segment with raw deflate. The previous 32Kb of filtered data are used as a dictionary,
+// so splitting into segments almost doesn't affect compression ratio.
+static void DeflateSegment(const CPngPreset& Preset, const byte* Filtered, int Offset, int Size, bool bLast, int HeaderSize,
+	int TrailerSize, TArray<byte>& Dst)
+{
+	guard(DeflateSegment);
+
+	z_stream s;
+	memset(&s, 0, sizeof(s));
+	if (deflateInit2(&s, Preset.Level, Z_DEFLATED, -MAX_WBITS, 8, Preset.Strategy) != Z_OK)
+		appError("deflateInit2 failed");
+
+	if (Offset > 0 && Preset.Level > 0)
+	{
+		int DictSize = min(Offset, 1 << MAX_WBITS);
+		deflateSetDictionary(&s, Filtered + Offset - DictSize, DictSize);
+	}
+
+	// Reserve space for the sync flush marker as well
+	int MaxSize = deflateBound(&s, Size) + 16;
+	Dst.Empty(HeaderSize + MaxSize + TrailerSize);
+	Dst.AddUninitialized(HeaderSize + MaxSize);
+
+	s.next_in = const_cast<byte*>(Filtered + Offset);
+	s.avail_in = Size;
+	s.next_out = Dst.GetData() + HeaderSize;
+	s.avail_out = MaxSize;
+	int ret = deflate(&s, bLast ? Z_FINISH : Z_SYNC_FLUSH);
+	if (ret != (bLast ? Z_STREAM_END : Z_OK) || s.avail_in != 0 || s.avail_out == 0)
+		appError("deflate returned %d", ret);
+
+	Dst.RemoveAt(HeaderSize + s.total_out, MaxSize - s.total_out);
+	deflateEnd(&s);
+
+	unguard;
+}
+
+static void PutBE32(byte* Dst, uint32 Value)
+{
+	Dst[0] = Value >> 24;
+	Dst[1] = (Value >> 16) & 0xFF;
+	Dst[2] = (Value >> 8) & 0xFF;
+	Dst[3] = Value & 0xFF;
+}
+
+static void WriteChunk(TArray<byte>& Dst, const char* Type, const byte* Data, int Size)
+{
+	byte* p = Dst.GetData() + Dst.AddUninitialized(Size + 12);
+	PutBE32(p, Size);
+	memcpy(p + 4, Type, 4);
+	if (Size) memcpy(p + 8, Data, Size);
+	PutBE32(p + 8 + Size, crc32(0, p + 4, Size + 4));
+}
+
+void CompressPNG(const unsigned char* pic, int Width, int Height, TArray<byte>& CompressedData, EPngCompression Compression)
 {
 	guard(CompressPNG);
 
+	assert(Width > 0 && Height > 0);
+
 	int PixelChannels = /*(RawFormat == ERGBFormat::Gray) ? 1 :*/ 3;
 
 	// Verify alpha channels of texture, see the possibility to drop one. First pass: check if alpha is fully opaque
@@ -221,58 +505,80 @@ void CompressPNG(const unsigned char* pic, int Width, int Height, TArray<byte>&
 		if (bAllZero) PixelChannels = 3;
 	}
 
-	unsigned char* newPic = NULL;
-	if (PixelChannels == 3)
-	{
-		// Squeeze pixel information if newly allocated memory block
-		newPic = new unsigned char[Width * Height * 3];
-		const unsigned char* s = pic;
-		unsigned char* d = newPic;
-		for (int i = Width * Height; i > 0; i--)
-		{
-			*d++ = *s++;
-			*d++ = *s++;
-			*d++ = *s++;
-			s++;
-		}
-		pic = newPic;
-	}
+	assert(Compression >= 0 && Compression < ARRAY_COUNT(GPngPresets));
+	const CPngPreset& Preset = GPngPresets[Compression];
 
-	PngWriteCtx ctx(CompressedData);
-	ctx.CompressedData.Empty(Width * Height * PixelChannels); // preallocate
+	// Split image into segments
+	int FilteredRowBytes = Width * PixelChannels + 1;
+	int RowsPerSegment = max(PNG_SEGMENT_SIZE / FilteredRowBytes, 1);
+	int NumSegments = (Height + RowsPerSegment - 1) / RowsPerSegment;
+	byte* Filtered = (byte*)appMallocNoInit(FilteredRowBytes * Height);
 
-	png_structp png_ptr	= png_create_write_struct(PNG_LIBPNG_VER_STRING, &ctx, user_error_fn, user_warning_fn);
-	assert(png_ptr);
-
-	png_infop info_ptr = png_create_info_struct(png_ptr);
-	assert(info_ptr);
-
-	png_bytep* row_pointers = (png_bytep*) png_malloc( png_ptr, Height*sizeof(png_bytep) );
-
-	const int RawBitDepth = 8;
-	png_set_compression_level(png_ptr, 1); // zlib compression level: 0 (uncompressed), 1 (fast) - 9 (slow)
-	png_set_IHDR(png_ptr, info_ptr, Width, Height, RawBitDepth, (PixelChannels == 4) ? PNG_COLOR_TYPE_RGBA : PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
-	png_set_write_fn(png_ptr, &ctx, user_write_compressed, user_flush_data);
-
-	const int BytesPerPixel = (RawBitDepth * PixelChannels) / 8;
-	const int BytesPerRow = BytesPerPixel * Width;
-
-	for (int i = 0; i < Height; i++)
+	TArray<CPngSegment> Segments;
+	Segments.Empty(NumSegments);
+	for (int i = 0; i < NumSegments; i++)
 	{
-		row_pointers[i]= (png_bytep)&pic[i * BytesPerRow];
+		CPngSegment* Seg = new (Segments) CPngSegment();
+		Seg->FirstRow = i * RowsPerSegment;
+		Seg->NumRows = min(RowsPerSegment, Height - Seg->FirstRow);
 	}
-	png_set_rows(png_ptr, info_ptr, row_pointers);
-
-	int Transform = PNG_TRANSFORM_IDENTITY;
-	png_write_png(png_ptr, info_ptr, Transform, NULL);
 
-	png_free(png_ptr, row_pointers);
-	png_destroy_write_struct(&png_ptr, &info_ptr);
+	// Filter all rows first, segments are using filtered data of previous segment as a dictionary
+	ParallelFor(NumSegments, [&](int i)
+		{
+			const CPngSegment& Seg = Segments[i];
+			FilterRows(pic, Width, PixelChannels, Preset.Filter, Seg.FirstRow, Seg.NumRows, Filtered + Seg.FirstRow * FilteredRowBytes);
+		});
 
-	if (newPic)
+	// Compress segments. The first one has space for zlib header, the last one - for adler32 checksum.
+	ParallelFor(NumSegments, [&](int i)
+		{
+			CPngSegment& Seg = Segments[i];
+			int Offset = Seg.FirstRow * FilteredRowBytes;
+			int Size = Seg.NumRows * FilteredRowBytes;
+			bool bLast = (i == NumSegments - 1);
+			DeflateSegment(Preset, Filtered, Offset, Size, bLast, (i == 0) ? 2 : 0, bLast ? 4 : 0, Seg.Data);
+			Seg.Adler = adler32(1, Filtered + Offset, Size);
+		});
+
+	appFree(Filtered);
+
+	// zlib header: 32Kb window, compression level hint, no dictionary
+	static const byte LevelFlags[] = { 0x01, 0x01, 0x5E, 0x5E, 0x5E, 0x5E, 0x9C, 0xDA, 0xDA, 0xDA };
+	Segments[0].Data[0] = 0x78;
+	Segments[0].Data[1] = LevelFlags[Preset.Level];
+
+	uLong Adler = Segments[0].Adler;
+	for (int i = 1; i < NumSegments; i++)
 	{
-		delete[] newPic;
+		const CPngSegment& Seg = Segments[i];
+		Adler = adler32_combine(Adler, Seg.Adler, Seg.NumRows * FilteredRowBytes);
 	}
+	TArray<byte>& LastData = Segments[NumSegments - 1].Data;
+	PutBE32(LastData.GetData() + LastData.AddUninitialized(4), Adler);
+
+	// Build PNG file
+	int TotalSize = 8 + 25 + 12;
+	for (const CPngSegment& Seg : Segments)
+		TotalSize += Seg.Data.Num() + 12;
+	CompressedData.Empty(TotalSize);
+
+	static const byte Signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	CompressedData.AddUninitialized(sizeof(Signature));
+	memcpy(CompressedData.GetData(), Signature, sizeof(Signature));
+
+	byte Header[13];
+	PutBE32(Header, Width);
+	PutBE32(Header + 4, Height);
+	Header[8] = 8;											// bit depth
+	Header[9] = (PixelChannels == 4) ? 6 : 2;				// color type: RGBA or RGB
+	Header[10] = Header[11] = Header[12] = 0;				// compression, filter and interlace methods
+	WriteChunk(CompressedData, "IHDR", Header, sizeof(Header));
+
+	for (const CPngSegment& Seg : Segments)
+		WriteChunk(CompressedData, "IDAT", Seg.Data.GetData(), Seg.Data.Num());
+
+	WriteChunk(CompressedData, "IEND", NULL, 0);
 
 	unguard;
 }
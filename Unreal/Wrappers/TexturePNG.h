@@ -1,7 +1,15 @@
 #ifndef __UNTEXTUREPNG_H__
 #define __UNTEXTUREPNG_H__
 
+enum EPngCompression
+{
+	PNG_COMPRESS_DEFAULT,		// adaptive filtering, fast deflate
+	PNG_COMPRESS_FAST,			// fixed "up" filter, fast RLE-only deflate
+	PNG_COMPRESS_STORE,			// no filtering, stored deflate blocks
+	PNG_COMPRESS_BEST,			// adaptive filtering, maximal deflate level
+};
+
 bool UncompressPNG(const unsigned char* CompressedData, int CompressedSize, int Width, int Height, unsigned char* pic, bool bgra);
-void CompressPNG(const unsigned char* pic, int Width, int Height, TArray<byte>& CompressedData);
+void CompressPNG(const unsigned char* pic, int Width, int Height, TArray<byte>& CompressedData, EPngCompression Compression = PNG_COMPRESS_DEFAULT);
 
 #endif // __UNTEXTUREPNG_H__